@@ -0,0 +1,388 @@
+#pragma once
+
+#include "../MLP/MLP.hpp"
+
+// Autoencoder: an encoder MLP (input -> code) and a mirrored decoder
+// (code -> reconstruction), trained with mini-batch SGD on the squared
+// reconstruction error.
+//
+// With tied weights the decoder layers own only their biases: decoder layer j
+// runs encoder layer L-1-j backwards, y = act(W^T x + b), through
+// mat_mul_tn, and its weight gradient x d^T is accumulated by mat_mul_nt
+// straight into the encoder layer's weight_grad. No transpose is ever
+// materialized and the weights exist once.
+//
+// The encoder is a plain MLP, so the encode-only path is mlp_forward_batch
+// on it (autoencoder_encode), and it can be handed to mlp_prepack or an
+// InferServer like any other model.
+
+typedef struct {
+  MLP *encoder;                   // dims[0] -> ... -> dims[L], owns the shared weights
+  Layer *decoder;                 // L layers, dims[L] -> ... -> dims[0]; weights NULL when tied
+  ActivationType *decoder_activations;
+  size_t num_layers;              // L, per side
+  int tied;
+
+  // training buffers, sized on first use (see autoencoder_train_batch)
+  Matrix **acts;                  // 2L + 1 (width x max_batch): input, L codes..., reconstruction
+  Matrix *grad[2];                // ping-pong pre-activation gradients
+  size_t max_batch;
+} Autoencoder;
+
+// Encoder layer mirrored by decoder layer j
+static inline Layer* ae_tied_layer(const Autoencoder* ae, size_t j) {
+  return &ae->encoder->layers[ae->num_layers - 1 - j];
+}
+
+static size_t ae_width(const Autoencoder* ae, size_t act) {
+  size_t L = ae->num_layers;
+  if (act <= L) return act == 0 ? ae->encoder->layers[0].weights->cols : ae->encoder->layers[act - 1].weights->rows;
+  return ae->encoder->layers[2 * L - act].weights->cols;
+}
+
+static void ae_free_buffers(Autoencoder* ae) {
+  if (ae->acts) {
+    for (size_t i = 0; i <= 2 * ae->num_layers; i++) mat_free(ae->acts[i]);
+    free(ae->acts);
+    ae->acts = NULL;
+  }
+  mat_free(ae->grad[0]);
+  mat_free(ae->grad[1]);
+  ae->grad[0] = ae->grad[1] = NULL;
+  ae->max_batch = 0;
+}
+
+void autoencoder_free(Autoencoder* ae) {
+  if (!ae) return;
+
+  ae_free_buffers(ae);
+  if (ae->decoder) {
+    for (size_t j = 0; j < ae->num_layers; j++) {
+      Layer* layer = &ae->decoder[j];
+      if (layer->weights) mat_free(layer->weights);
+      if (layer->bias) mat_free(layer->bias);
+      if (layer->weight_grad) mat_free(layer->weight_grad);
+      if (layer->bias_grad) mat_free(layer->bias_grad);
+    }
+    free(ae->decoder);
+  }
+  free(ae->decoder_activations);
+  mlp_free(ae->encoder);
+  free(ae);
+}
+
+// dims[0..num_dims) is the encoder, input to code; the decoder mirrors it.
+// activations holds 2 * (num_dims - 1) entries, encoder layers then decoder
+// layers. With tied != 0 every decoder layer uses the transposed weights of
+// its mirror encoder layer.
+Autoencoder* create_autoencoder(size_t* dims, size_t num_dims, ActivationType* activations, float learning_rate, int tied) {
+  if (!dims || num_dims < 2 || !activations) return NULL;
+
+  Autoencoder* ae = (Autoencoder*)calloc(1, sizeof(Autoencoder));
+  CHECK_NULL(ae);
+
+  size_t L = num_dims - 1;
+  uint64_t seed = rng_next_model_seed();
+  ae->num_layers = L;
+  ae->tied = tied;
+  ae->encoder = create_mlp_seeded(dims, num_dims, activations, learning_rate, seed);
+  ae->decoder = (Layer*)calloc(L, sizeof(Layer));
+  ae->decoder_activations = (ActivationType*)malloc(sizeof(ActivationType) * L);
+  if (!ae->encoder || !ae->decoder || !ae->decoder_activations || mlp_zero_grads(ae->encoder) != 0) {
+    autoencoder_free(ae);
+    return NULL;
+  }
+
+  for (size_t j = 0; j < L; j++) {
+    size_t in = dims[L - j], out = dims[L - j - 1];
+    Layer* layer = &ae->decoder[j];
+    ae->decoder_activations[j] = activations[L + j];
+    layer->bias = mat_create_with_value(out, 1, 0.0f);
+    layer->bias_grad = mat_create_with_value(out, 1, 0.0f);
+    if (!layer->bias || !layer->bias_grad) {
+      autoencoder_free(ae);
+      return NULL;
+    }
+    if (tied) continue;
+
+    layer->weights = mat_create(out, in);
+    layer->weight_grad = mat_create_with_value(out, in, 0.0f);
+    if (!layer->weights || !layer->weight_grad) {
+      autoencoder_free(ae);
+      return NULL;
+    }
+    init_weights_uniform(layer->weights, seed, L + j, utility::newton_sqrt(2.0f / in));
+  }
+  return ae;
+}
+
+// Weights and biases stored (tied decoders store only biases)
+size_t autoencoder_param_count(const Autoencoder* ae) {
+  if (!ae) return 0;
+
+  size_t count = 0;
+  for (size_t l = 0; l < ae->num_layers; l++) {
+    const Layer* enc = &ae->encoder->layers[l];
+    const Layer* dec = &ae->decoder[l];
+    count += mat_size(enc->weights) + mat_size(enc->bias) + mat_size(dec->bias);
+    if (dec->weights) count += mat_size(dec->weights);
+  }
+  return count;
+}
+
+// Scratch for autoencoder_encode, one per concurrent caller
+MLPBatchScratch* autoencoder_encode_scratch(const Autoencoder* ae, size_t max_batch) {
+  return ae ? mlp_batch_scratch_create(ae->encoder, max_batch) : NULL;
+}
+
+// Codes (code_size x B) for the columns of X, the decoder is not touched.
+// Only reads the model, concurrent calls are safe with separate scratch.
+int autoencoder_encode(const Autoencoder* ae, const Matrix* X, Matrix* codes, MLPBatchScratch* scratch) {
+  if (!ae) return -1;
+  return mlp_forward_batch(ae->encoder, X, codes, scratch);
+}
+
+static void ae_bias_activate(const Matrix* bias, ActivationType activation_type, Matrix* out) {
+  float (*activation_func)(float);
+  float (*derivative_func)(float);
+  get_activation_function(activation_type, &activation_func, &derivative_func);
+
+  for (size_t i = 0; i < out->rows; i++) {
+    float b = bias->data[i * bias->stride];
+    float* row = out->data + i * out->stride;
+    for (size_t j = 0; j < out->cols; j++) {
+      row[j] = activation_func(row[j] + b);
+    }
+  }
+}
+
+// Decoder layer j on a batch: the untied layer is an ordinary Layer, the tied
+// one computes act(W^T in + b) with the mirror encoder layer's W.
+static int ae_decoder_forward(const Autoencoder* ae, size_t j, const Matrix* in, Matrix* out) {
+  const Layer* layer = &ae->decoder[j];
+  if (!ae->tied) return layer_forward_batch(layer, ae->decoder_activations[j], in, out);
+
+  if (mat_mul_tn(ae_tied_layer(ae, j)->weights, in, out, 0) != 0) return -1;
+  ae_bias_activate(layer->bias, ae->decoder_activations[j], out);
+  return 0;
+}
+
+// Backward of tied decoder layer j, mirrors layer_backward_batch: the weight
+// gradient of W^T is (out_grad in^T)^T = in out_grad^T, added to the encoder
+// layer's weight_grad, and the input gradient is W out_grad.
+static int ae_tied_backward(Autoencoder* ae, size_t j, const Matrix* in, const Matrix* out, Matrix* out_grad, Matrix* in_grad) {
+  Layer* layer = &ae->decoder[j];
+  Layer* shared = ae_tied_layer(ae, j);
+
+  float (*activation_func)(float);
+  float (*activation_deriv)(float);
+  get_activation_function(ae->decoder_activations[j], &activation_func, &activation_deriv);
+
+  if (mat_assign(out_grad, mx(out_grad) * mx_map(activation_deriv, mx(out))) != 0) return -1;
+
+  for (size_t i = 0; i < out_grad->rows; i++) {
+    const float* row = out_grad->data + i * out_grad->stride;
+    float sum = 0.0f;
+    for (size_t c = 0; c < out_grad->cols; c++) {
+      sum += row[c];
+    }
+    layer->bias_grad->data[i * layer->bias_grad->stride] += sum;
+  }
+
+  if (mat_mul_nt(in, out_grad, shared->weight_grad, 1) != 0) return -1;
+  return mat_mul(shared->weights, out_grad, in_grad);
+}
+
+static int ae_reserve(Autoencoder* ae, size_t batch) {
+  if (batch <= ae->max_batch) return 0;
+
+  ae_free_buffers(ae);
+  size_t widest = 0;
+  ae->acts = (Matrix**)calloc(2 * ae->num_layers + 1, sizeof(Matrix*));
+  if (!ae->acts) return -1;
+  for (size_t i = 0; i <= 2 * ae->num_layers; i++) {
+    size_t width = ae_width(ae, i);
+    if (width > widest) widest = width;
+    ae->acts[i] = mat_create(width, batch);
+    if (!ae->acts[i]) {
+      ae_free_buffers(ae);
+      return -1;
+    }
+  }
+  ae->grad[0] = mat_create(widest, batch);
+  ae->grad[1] = mat_create(widest, batch);
+  if (!ae->grad[0] || !ae->grad[1]) {
+    ae_free_buffers(ae);
+    return -1;
+  }
+  ae->max_batch = batch;
+  return 0;
+}
+
+// Views of the first `batch` columns of the training buffers
+static int ae_views(Autoencoder* ae, size_t batch, Matrix** acts) {
+  for (size_t i = 0; i <= 2 * ae->num_layers; i++) {
+    acts[i] = mat_view(ae->acts[i], 0, 0, ae->acts[i]->rows, batch);
+    if (!acts[i]) return -1;
+  }
+  return 0;
+}
+
+// Full forward of the columns of X; acts[2L] is the reconstruction
+static int ae_forward(Autoencoder* ae, Matrix** acts) {
+  size_t L = ae->num_layers;
+  for (size_t l = 0; l < L; l++) {
+    if (layer_forward_batch(&ae->encoder->layers[l], ae->encoder->activations[l], acts[l], acts[l + 1]) != 0) return -1;
+  }
+  for (size_t j = 0; j < L; j++) {
+    if (ae_decoder_forward(ae, j, acts[L + j], acts[L + j + 1]) != 0) return -1;
+  }
+  return 0;
+}
+
+// One SGD step on the columns of X (input_size x B), mean gradient of the
+// per-sample MSE. Returns the batch's mean reconstruction loss, -1 on error.
+float autoencoder_train_batch(Autoencoder* ae, const Matrix* X) {
+  if (!ae || !mat_is_valid(X) || X->cols == 0) return -1.0f;
+  if (X->rows != ae_width(ae, 0)) return -1.0f;
+
+  size_t L = ae->num_layers, batch = X->cols;
+  if (ae_reserve(ae, batch) != 0) return -1.0f;
+
+  Matrix** acts = (Matrix**)calloc(2 * L + 1, sizeof(Matrix*));
+  Matrix* grads[2] = {NULL, NULL};
+  float loss = -1.0f;
+  if (!acts || ae_views(ae, batch, acts) != 0) goto done;
+  if (mat_copy_into(X, acts[0]) != 0 || ae_forward(ae, acts) != 0) goto done;
+
+  {
+    const Matrix* y = acts[2 * L];
+    loss = mat_sum(mx_square(mx(y) - mx(X))) / (float)(y->rows * batch);
+
+    grads[0] = mat_view(ae->grad[0], 0, 0, y->rows, batch);
+    if (!grads[0] || mat_assign(grads[0], (mx(y) - mx(X)) * 2.0f) != 0) {
+      loss = -1.0f;
+      goto done;
+    }
+
+    // decoder, last layer first, then the encoder; grads[0] always holds the
+    // gradient w.r.t. the output of the layer being processed
+    for (size_t a = 2 * L; a > 0; a--) {
+      size_t in_width = ae_width(ae, a - 1);
+      Matrix* in_grad = NULL;
+      if (a > 1) {
+        in_grad = mat_view(grads[0]->data == ae->grad[0]->data ? ae->grad[1] : ae->grad[0], 0, 0, in_width, batch);
+        if (!in_grad) {
+          loss = -1.0f;
+          goto done;
+        }
+      }
+
+      int rc;
+      if (a > L) {
+        size_t j = a - L - 1;
+        if (ae->tied) {
+          rc = ae_tied_backward(ae, j, acts[a - 1], acts[a], grads[0], in_grad);
+        } else {
+          Layer* layer = &ae->decoder[j];
+          rc = layer_backward_batch(layer, ae->decoder_activations[j], acts[a - 1], acts[a], grads[0], in_grad,
+                                    layer->weight_grad, layer->bias_grad);
+        }
+      } else {
+        Layer* layer = &ae->encoder->layers[a - 1];
+        rc = layer_backward_batch(layer, ae->encoder->activations[a - 1], acts[a - 1], acts[a], grads[0], in_grad,
+                                  layer->weight_grad, layer->bias_grad);
+      }
+
+      mat_free(grads[0]);
+      grads[0] = in_grad;
+      if (rc != 0) {
+        loss = -1.0f;
+        goto done;
+      }
+    }
+
+    float rate = ae->encoder->learning_rate / batch;
+    for (size_t l = 0; l < L; l++) {
+      layer_apply_grads(&ae->encoder->layers[l], rate);
+      Layer* dec = &ae->decoder[l];
+      if (dec->weights) {
+        layer_apply_grads(dec, rate);
+      } else {
+        mat_assign(dec->bias, mx(dec->bias) - mx(dec->bias_grad) * rate);
+        mat_zero(dec->bias_grad);
+      }
+    }
+    mlp_mark_updated(ae->encoder);
+  }
+
+done:
+  mat_free(grads[0]);
+  if (acts) {
+    for (size_t i = 0; i <= 2 * L; i++) mat_free(acts[i]);
+    free(acts);
+  }
+  return loss;
+}
+
+// Reconstruction (input_size x B) of the columns of X
+int autoencoder_reconstruct(Autoencoder* ae, const Matrix* X, Matrix* Y) {
+  if (!ae || !mat_is_valid(X) || !mat_is_valid(Y) || X->cols == 0) return -1;
+  if (X->rows != ae_width(ae, 0) || Y->rows != X->rows || Y->cols != X->cols) return -1;
+
+  size_t L = ae->num_layers;
+  if (ae_reserve(ae, X->cols) != 0) return -1;
+
+  Matrix** acts = (Matrix**)calloc(2 * L + 1, sizeof(Matrix*));
+  int rc = -1;
+  if (acts && ae_views(ae, X->cols, acts) == 0 && mat_copy_into(X, acts[0]) == 0 && ae_forward(ae, acts) == 0) {
+    rc = mat_copy_into(acts[2 * L], Y);
+  }
+  if (acts) {
+    for (size_t i = 0; i <= 2 * L; i++) mat_free(acts[i]);
+    free(acts);
+  }
+  return rc;
+}
+
+// Mini-batch training on column vectors samples[0..num_samples). Returns the
+// last epoch's mean loss, -1 on error.
+float autoencoder_train(Autoencoder* ae, Matrix** samples, size_t num_samples, size_t epochs, size_t batch_size, float epsilon) {
+  if (!ae || !samples || num_samples == 0 || batch_size == 0) return -1.0f;
+
+  if (batch_size > num_samples) batch_size = num_samples;
+  Matrix* X = mat_create(ae_width(ae, 0), batch_size);
+  if (!X) return -1.0f;
+
+  float avg_loss = 0.0f;
+  for (size_t epoch = 0; epoch < epochs; epoch++) {
+    float epoch_loss = 0.0f;
+
+    for (size_t first = 0; first < num_samples; first += batch_size) {
+      size_t count = num_samples - first < batch_size ? num_samples - first : batch_size;
+      Matrix* batch = mat_view(X, 0, 0, X->rows, count);
+      if (!batch) {
+        mat_free(X);
+        return -1.0f;
+      }
+      mlp_gather_columns(samples, first, count, batch);
+      float loss = autoencoder_train_batch(ae, batch);
+      mat_free(batch);
+      if (loss < 0.0f) {
+        mat_free(X);
+        return -1.0f;
+      }
+      epoch_loss += loss * count;
+    }
+
+    avg_loss = epoch_loss / num_samples;
+    if (epoch % 10 == 0 || epoch == epochs - 1)
+      printf("Epoch %zu/%zu = Loss: %.4f\n", epoch + 1, epochs, avg_loss);
+
+    ae->encoder->epoch++;
+    if (avg_loss < epsilon) break;
+  }
+
+  mat_free(X);
+  return avg_loss;
+}
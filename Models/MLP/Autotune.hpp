@@ -0,0 +1,471 @@
+#pragma once
+
+#include "MLP.hpp"
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+
+// Startup autotuner for mat_mul.
+//
+// mlp_autotune() collects the distinct (M x K) * (K x N) products of a batched
+// forward pass (M = layer outputs, K = layer inputs, N = batch size) and, for
+// each one, times candidate MatGemmConfigs on the layer's own weights:
+//   1. kernel (4x8 vector micro-kernel / per-row axpy) x loop order,
+//   2. K and N block sizes for the winner,
+//   3. M block size,
+//   4. thread count, doubling up to the number of cores.
+// Each stage keeps the fastest config so far; a tuned config replaces the
+// default only if it is at least AUTOTUNE_MIN_GAIN faster.
+//
+// Best-of timings of single products are noisy, so the per-shape winners are
+// then checked on the whole batched forward pass: AUTOTUNE_VERIFY_ROUNDS
+// interleaved timings with the default and with the tuned configs installed.
+// The tuned set is kept only if its median beats the default's by
+// AUTOTUNE_MIN_GAIN and it wins nearly every round; otherwise every tuned
+// shape falls back to the default config. The result is installed with
+// mat_gemm_set_config, so every later mat_mul of that shape uses it.
+//
+// With a profile path the choices are persisted as one text line per shape,
+// keyed by the CPU model and core count. A later run on the same machine
+// reads them back and installs them without timing anything. Lines for other
+// CPUs are kept when the file is rewritten.
+//
+// The config table mat_mul reads is not synchronized, and the verify step
+// rewrites it repeatedly while timing. Run mlp_autotune once at startup,
+// before any other thread calls mat_mul (or anything built on it: training,
+// inference servers, data-parallel workers), and not concurrently with itself.
+
+#define AUTOTUNE_PROFILE_HEADER "# nn gemm profile 1: cpu<TAB>M N K kc nc mc kernel order threads default_ms tuned_ms"
+#define AUTOTUNE_KEY_LEN 160
+#define AUTOTUNE_LINE_LEN 512
+#define AUTOTUNE_MIN_MS 5.0       // one timing repeats the product for at least this long
+#define AUTOTUNE_REPEATS 3        // best of
+#define AUTOTUNE_MIN_GAIN 1.03    // a config must beat the default by 3% to be installed
+#define AUTOTUNE_VERIFY_ROUNDS 7  // interleaved default / tuned forward timings
+
+typedef struct {
+  size_t M, N, K;
+  MatGemmConfig config;     // installed for the shape
+  double default_ms;        // one product with mat_gemm_default_config
+  double tuned_ms;          // one product with config
+  int from_profile;         // read back instead of timed
+  int installed;            // 0 if mat_gemm_set_config failed (the table is full), mat_mul keeps the default
+} AutotuneShape;
+
+typedef struct {
+  char cpu_key[AUTOTUNE_KEY_LEN];
+  AutotuneShape *shapes;
+  size_t num_shapes;
+  size_t candidates;        // configs timed, 0 when the profile covered every shape
+  double elapsed_ms;
+  int profile_written;
+  int verified;             // 1 tuned forward kept, 0 fell back to the default, -1 not checked
+  double forward_default_ms;  // medians of the forward check
+  double forward_tuned_ms;
+} AutotuneReport;
+
+static const size_t autotune_kc[] = {0, 64, 128, 256, 512};
+static const size_t autotune_nc[] = {0, 64, 256, 1024};
+static const size_t autotune_mc[] = {16, 64, 256};
+
+static inline double autotune_now_ms() {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// "<model name> x<cores>" from /proc/cpuinfo, tabs and newlines removed
+static void autotune_cpu_key(char* key, size_t len) {
+  char model[AUTOTUNE_KEY_LEN] = "unknown cpu";
+  FILE* file = fopen("/proc/cpuinfo", "r");
+  if (file) {
+    char line[AUTOTUNE_LINE_LEN];
+    while (fgets(line, sizeof(line), file)) {
+      if (strncmp(line, "model name", 10) != 0) continue;
+      const char* value = strchr(line, ':');
+      if (!value) continue;
+      value++;
+      while (*value == ' ') value++;
+      snprintf(model, sizeof(model), "%s", value);
+      size_t end = strlen(model);
+      while (end > 0 && (model[end - 1] == '\n' || model[end - 1] == ' ')) model[--end] = '\0';
+      break;
+    }
+    fclose(file);
+  }
+
+  snprintf(key, len, "%s x%u", model, std::thread::hardware_concurrency());
+  for (char* c = key; *c; c++) {
+    if (*c == '\t' || *c == '\n' || *c == '\r') *c = ' ';
+  }
+}
+
+static const char* autotune_kernel_name(MatGemmKernel kernel) {
+  return kernel == MAT_GEMM_KERNEL_ROWS ? "rows" : "vec4x8";
+}
+
+static const char* autotune_order_name(MatGemmOrder order) {
+  return order == MAT_GEMM_ORDER_NKM ? "nkm" : "mnk";
+}
+
+// milliseconds per product, best of AUTOTUNE_REPEATS runs of AUTOTUNE_MIN_MS
+static double autotune_time(const Matrix* a, const Matrix* b, Matrix* c, const MatGemmConfig* config) {
+  double start = autotune_now_ms();
+  mat_mul_config(a, b, c, config);
+  double first = autotune_now_ms() - start;
+
+  size_t reps = first > 0.0 ? (size_t)(AUTOTUNE_MIN_MS / first) + 1 : 1;
+  double best = first;
+  for (int r = 0; r < AUTOTUNE_REPEATS; r++) {
+    start = autotune_now_ms();
+    for (size_t i = 0; i < reps; i++) mat_mul_config(a, b, c, config);
+    double ms = (autotune_now_ms() - start) / reps;
+    if (ms < best) best = ms;
+  }
+  return best;
+}
+
+// keeps candidate in *best when it is faster
+static void autotune_try(const Matrix* a, const Matrix* b, Matrix* c, const MatGemmConfig* candidate,
+                         MatGemmConfig* best, double* best_ms, size_t* candidates) {
+  double ms = autotune_time(a, b, c, candidate);
+  (*candidates)++;
+  if (ms < *best_ms) {
+    *best_ms = ms;
+    *best = *candidate;
+  }
+}
+
+// staged search for one shape, a is the layer's weights (M x K)
+static int autotune_search(const Matrix* a, AutotuneShape* shape, size_t* candidates) {
+  Matrix* b = mat_create(shape->K, shape->N);
+  Matrix* c = mat_create(shape->M, shape->N);
+  if (!b || !c) {
+    mat_free(b);
+    mat_free(c);
+    return -1;
+  }
+  RngStream s = rng_stream(0x6175746f74756e65ull, 0);
+  for (size_t r = 0; r < b->rows; r++) {
+    rng_fill_uniform(s, r * b->cols, b->data + r * b->stride, b->cols, -1.0f, 1.0f);
+  }
+
+  MatGemmConfig best = mat_gemm_default_config;
+  double best_ms = autotune_time(a, b, c, &best);
+  shape->default_ms = best_ms;
+  (*candidates)++;
+
+  for (int kernel = 0; kernel < 2; kernel++) {
+    for (int order = 0; order < 2; order++) {
+      if (kernel == 0 && order == 0) continue;
+      MatGemmConfig candidate = mat_gemm_default_config;
+      candidate.kernel = (MatGemmKernel)kernel;
+      candidate.order = (MatGemmOrder)order;
+      autotune_try(a, b, c, &candidate, &best, &best_ms, candidates);
+    }
+  }
+
+  MatGemmConfig base = best;
+  for (size_t i = 0; i < sizeof(autotune_kc) / sizeof(autotune_kc[0]); i++) {
+    for (size_t j = 0; j < sizeof(autotune_nc) / sizeof(autotune_nc[0]); j++) {
+      size_t kc = autotune_kc[i], nc = autotune_nc[j];
+      if ((kc == 0 && nc == 0) || kc >= shape->K || nc >= shape->N) continue;
+      MatGemmConfig candidate = base;
+      candidate.kc = kc;
+      candidate.nc = nc;
+      autotune_try(a, b, c, &candidate, &best, &best_ms, candidates);
+    }
+  }
+
+  base = best;
+  for (size_t i = 0; i < sizeof(autotune_mc) / sizeof(autotune_mc[0]); i++) {
+    if (autotune_mc[i] >= shape->M) continue;
+    MatGemmConfig candidate = base;
+    candidate.mc = autotune_mc[i];
+    autotune_try(a, b, c, &candidate, &best, &best_ms, candidates);
+  }
+
+  base = best;
+  size_t cores = std::thread::hardware_concurrency();
+  for (size_t threads = 2; threads <= cores && threads * MAT_GEMM_MR <= shape->M; threads *= 2) {
+    MatGemmConfig candidate = base;
+    candidate.threads = threads;
+    autotune_try(a, b, c, &candidate, &best, &best_ms, candidates);
+  }
+
+  if (shape->default_ms < best_ms * AUTOTUNE_MIN_GAIN) {
+    best = mat_gemm_default_config;
+    best_ms = shape->default_ms;
+  }
+  shape->config = best;
+  shape->tuned_ms = best_ms;
+  mat_free(b);
+  mat_free(c);
+  return 0;
+}
+
+static inline int autotune_is_default(const MatGemmConfig* c) {
+  const MatGemmConfig* d = &mat_gemm_default_config;
+  return c->kc == d->kc && c->nc == d->nc && c->mc == d->mc && c->kernel == d->kernel && c->order == d->order &&
+         c->threads == d->threads;
+}
+
+// Installs every shape's config, or the default for the shapes tuned in this
+// run when tuned is 0. Returns -1 if the config table refused a shape.
+static int autotune_install(AutotuneReport* report, int tuned) {
+  int rc = 0;
+  for (size_t i = 0; i < report->num_shapes; i++) {
+    AutotuneShape* shape = &report->shapes[i];
+    const MatGemmConfig* config = tuned || shape->from_profile ? &shape->config : &mat_gemm_default_config;
+    shape->installed = mat_gemm_set_config(shape->M, shape->N, shape->K, config) == 0;
+    if (!shape->installed) rc = -1;
+  }
+  return rc;
+}
+
+static int autotune_compare_ms(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Times the batched forward with the default and with the tuned configs in
+// alternating rounds and keeps the tuned ones only if they clearly win.
+// Leaves the chosen set installed. -1 on error. Swaps table entries under
+// any concurrent mat_mul, hence the single-threaded rule above.
+static int autotune_verify(const MLP* mlp, size_t batch_size, AutotuneReport* report) {
+  Matrix* X = mat_create(mlp->layers[0].weights->cols, batch_size);
+  Matrix* Y = mat_create(mlp->layers[mlp->num_layers - 1].weights->rows, batch_size);
+  MLPBatchScratch* scratch = mlp_batch_scratch_create(mlp, batch_size);
+  int rc = -1;
+  if (!X || !Y || !scratch) goto done;
+
+  {
+    RngStream s = rng_stream(0x6175746f74756e65ull, 1);
+    for (size_t r = 0; r < X->rows; r++) {
+      rng_fill_uniform(s, r * X->cols, X->data + r * X->stride, X->cols, -1.0f, 1.0f);
+    }
+
+    // one round is at least AUTOTUNE_MIN_MS of forwards, sized on the default
+    if (autotune_install(report, 0) != 0) goto done;
+    double start = autotune_now_ms();
+    if (mlp_forward_batch(mlp, X, Y, scratch) != 0) goto done;
+    double first = autotune_now_ms() - start;
+    size_t reps = first > 0.0 ? (size_t)(AUTOTUNE_MIN_MS / first) + 1 : 1;
+
+    double ms[2][AUTOTUNE_VERIFY_ROUNDS];
+    size_t wins = 0;
+    for (int r = 0; r < AUTOTUNE_VERIFY_ROUNDS; r++) {
+      // alternate which side goes first so drift in clock speed hits both
+      for (int k = 0; k < 2; k++) {
+        int tuned = (r + k) & 1;
+        if (autotune_install(report, tuned) != 0) goto done;
+        start = autotune_now_ms();
+        for (size_t i = 0; i < reps; i++) mlp_forward_batch(mlp, X, Y, scratch);
+        ms[tuned][r] = (autotune_now_ms() - start) / reps;
+      }
+      if (ms[1][r] < ms[0][r]) wins++;
+    }
+    qsort(ms[0], AUTOTUNE_VERIFY_ROUNDS, sizeof(double), autotune_compare_ms);
+    qsort(ms[1], AUTOTUNE_VERIFY_ROUNDS, sizeof(double), autotune_compare_ms);
+    report->forward_default_ms = ms[0][AUTOTUNE_VERIFY_ROUNDS / 2];
+    report->forward_tuned_ms = ms[1][AUTOTUNE_VERIFY_ROUNDS / 2];
+
+    report->verified = report->forward_default_ms >= report->forward_tuned_ms * AUTOTUNE_MIN_GAIN &&
+                       wins + 1 >= AUTOTUNE_VERIFY_ROUNDS;
+    if (!report->verified) {
+      for (size_t i = 0; i < report->num_shapes; i++) {
+        AutotuneShape* shape = &report->shapes[i];
+        if (shape->from_profile) continue;
+        shape->config = mat_gemm_default_config;
+        shape->tuned_ms = shape->default_ms;
+      }
+    }
+    rc = autotune_install(report, 1);
+  }
+
+done:
+  mat_free(X);
+  mat_free(Y);
+  mlp_batch_scratch_free(scratch);
+  return rc;
+}
+
+// Parses "<key>\t<fields>". Returns 1 and fills *shape for a well-formed line.
+static int autotune_parse_line(const char* line, char* key, size_t key_len, AutotuneShape* shape) {
+  const char* tab = strchr(line, '\t');
+  if (!tab || (size_t)(tab - line) >= key_len) return 0;
+  memcpy(key, line, tab - line);
+  key[tab - line] = '\0';
+
+  unsigned long v[9];
+  double default_ms, tuned_ms;
+  if (sscanf(tab + 1, "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lf %lf", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+             &v[6], &v[7], &v[8], &default_ms, &tuned_ms) != 11) {
+    return 0;
+  }
+  if (v[6] > MAT_GEMM_KERNEL_ROWS || v[7] > MAT_GEMM_ORDER_NKM || v[8] == 0) return 0;
+
+  shape->M = v[0];
+  shape->N = v[1];
+  shape->K = v[2];
+  shape->config.kc = v[3];
+  shape->config.nc = v[4];
+  shape->config.mc = v[5];
+  shape->config.kernel = (MatGemmKernel)v[6];
+  shape->config.order = (MatGemmOrder)v[7];
+  shape->config.threads = v[8];
+  shape->default_ms = default_ms;
+  shape->tuned_ms = tuned_ms;
+  return 1;
+}
+
+// fills shape->config from the profile, 1 if found
+static int autotune_profile_lookup(const char* path, const char* cpu_key, AutotuneShape* shape) {
+  FILE* file = fopen(path, "r");
+  if (!file) return 0;
+
+  char line[AUTOTUNE_LINE_LEN], key[AUTOTUNE_KEY_LEN];
+  AutotuneShape entry;
+  int found = 0;
+  while (!found && fgets(line, sizeof(line), file)) {
+    if (!autotune_parse_line(line, key, sizeof(key), &entry)) continue;
+    if (strcmp(key, cpu_key) != 0 || entry.M != shape->M || entry.N != shape->N || entry.K != shape->K) continue;
+    *shape = entry;
+    found = 1;
+  }
+  fclose(file);
+  return found;
+}
+
+// Rewrites the profile with the report's shapes, keeping every other line,
+// through "<path>.tmp" and a rename so readers never see half a file.
+static int autotune_profile_save(const char* path, const AutotuneReport* report) {
+  size_t len = strlen(path);
+  char* tmp_path = (char*)malloc(len + 5);
+  if (!tmp_path) return -1;
+  snprintf(tmp_path, len + 5, "%s.tmp", path);
+
+  FILE* out = fopen(tmp_path, "w");
+  if (!out) {
+    free(tmp_path);
+    return -1;
+  }
+  fprintf(out, "%s\n", AUTOTUNE_PROFILE_HEADER);
+
+  FILE* in = fopen(path, "r");
+  if (in) {
+    char line[AUTOTUNE_LINE_LEN], key[AUTOTUNE_KEY_LEN];
+    AutotuneShape entry;
+    while (fgets(line, sizeof(line), in)) {
+      if (!autotune_parse_line(line, key, sizeof(key), &entry)) continue;
+      int replaced = 0;
+      for (size_t i = 0; i < report->num_shapes && !replaced; i++) {
+        const AutotuneShape* s = &report->shapes[i];
+        replaced = strcmp(key, report->cpu_key) == 0 && entry.M == s->M && entry.N == s->N && entry.K == s->K;
+      }
+      if (!replaced) fputs(line, out);
+    }
+    fclose(in);
+  }
+
+  for (size_t i = 0; i < report->num_shapes; i++) {
+    const AutotuneShape* s = &report->shapes[i];
+    fprintf(out, "%s\t%zu %zu %zu %zu %zu %zu %d %d %zu %.6f %.6f\n", report->cpu_key, s->M, s->N, s->K,
+            s->config.kc, s->config.nc, s->config.mc, (int)s->config.kernel, (int)s->config.order,
+            s->config.threads, s->default_ms, s->tuned_ms);
+  }
+
+  int rc = fclose(out) == 0 && rename(tmp_path, path) == 0 ? 0 : -1;
+  if (rc != 0) remove(tmp_path);
+  free(tmp_path);
+  return rc;
+}
+
+void autotune_report_free(AutotuneReport* report) {
+  if (!report) return;
+  free(report->shapes);
+  free(report);
+}
+
+// Tunes mat_mul for the batched forward pass of mlp at batch_size and installs
+// the result. profile_path may be NULL to skip persistence. Returns a report
+// (free with autotune_report_free) or NULL on error. Must not overlap with
+// mat_mul on other threads, see the top of this file.
+AutotuneReport* mlp_autotune(const MLP* mlp, size_t batch_size, const char* profile_path) {
+  if (!mlp || mlp->num_layers == 0 || batch_size == 0) return NULL;
+
+  AutotuneReport* report = (AutotuneReport*)calloc(1, sizeof(AutotuneReport));
+  CHECK_NULL(report);
+  report->shapes = (AutotuneShape*)calloc(mlp->num_layers, sizeof(AutotuneShape));
+  if (!report->shapes) {
+    free(report);
+    return NULL;
+  }
+  autotune_cpu_key(report->cpu_key, sizeof(report->cpu_key));
+  report->verified = -1;
+  double start = autotune_now_ms();
+
+  // batch 1 goes through the matrix-vector path, which has nothing to tune
+  if (batch_size == 1) return report;
+
+  size_t tuned = 0, changed = 0;
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    const Matrix* w = mlp->layers[l].weights;
+    int seen = 0;
+    for (size_t i = 0; i < report->num_shapes && !seen; i++) {
+      seen = report->shapes[i].M == w->rows && report->shapes[i].K == w->cols;
+    }
+    if (seen) continue;
+
+    AutotuneShape* shape = &report->shapes[report->num_shapes++];
+    shape->M = w->rows;
+    shape->N = batch_size;
+    shape->K = w->cols;
+    if (profile_path && autotune_profile_lookup(profile_path, report->cpu_key, shape)) {
+      shape->from_profile = 1;
+    } else {
+      if (autotune_search(w, shape, &report->candidates) != 0) {
+        autotune_report_free(report);
+        return NULL;
+      }
+      tuned++;
+      if (!autotune_is_default(&shape->config)) changed++;
+    }
+  }
+
+  // a full config table leaves shapes on the default, the check would compare nothing
+  if (autotune_install(report, 1) == 0 && changed > 0 && autotune_verify(mlp, batch_size, report) != 0) {
+    autotune_report_free(report);
+    return NULL;
+  }
+
+  if (profile_path && tuned > 0) {
+    report->profile_written = autotune_profile_save(profile_path, report) == 0;
+  }
+  report->elapsed_ms = autotune_now_ms() - start;
+  return report;
+}
+
+void autotune_report_print(const AutotuneReport* report) {
+  if (!report) return;
+  printf("GEMM autotune for %s: %zu shape(s), %zu config(s) timed in %.0f ms%s\n", report->cpu_key,
+         report->num_shapes, report->candidates, report->elapsed_ms,
+         report->profile_written ? ", profile written" : "");
+  if (report->verified >= 0) {
+    printf("  forward check, median of %d: default %.3f ms, tuned %.3f ms (%.2fx), %s\n", AUTOTUNE_VERIFY_ROUNDS,
+           report->forward_default_ms, report->forward_tuned_ms,
+           report->forward_tuned_ms > 0.0 ? report->forward_default_ms / report->forward_tuned_ms : 1.0,
+           report->verified ? "tuned configs kept" : "not clearly faster, default kept");
+  }
+  printf("  %-18s %-7s %-5s %5s %5s %5s %4s %11s %11s %8s\n", "shape (MxNxK)", "kernel", "order", "kc", "nc", "mc",
+         "thr", "default ms", "tuned ms", "speedup");
+  for (size_t i = 0; i < report->num_shapes; i++) {
+    const AutotuneShape* s = &report->shapes[i];
+    char dims[32];
+    snprintf(dims, sizeof(dims), "%zux%zux%zu", s->M, s->N, s->K);
+    printf("  %-18s %-7s %-5s %5zu %5zu %5zu %4zu %11.3f %11.3f %7.2fx%s%s\n", dims,
+           autotune_kernel_name(s->config.kernel), autotune_order_name(s->config.order), s->config.kc,
+           s->config.nc, s->config.mc, s->config.threads, s->default_ms, s->tuned_ms,
+           s->tuned_ms > 0.0 ? s->default_ms / s->tuned_ms : 1.0, s->from_profile ? " (profile)" : "",
+           s->installed ? "" : " (not installed, config table full)");
+  }
+}
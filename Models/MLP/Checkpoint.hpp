@@ -0,0 +1,394 @@
+#pragma once
+
+#include "MLP.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <errno.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// Asynchronous training checkpoints.
+//
+// checkpoint_request() copies every weight and bias, plus the epoch count,
+// learning rate, RNG state and shuffle setting, into a staging buffer in one pass and returns.
+// A background thread writes the buffer to "<path>.tmp", fsyncs it, renames
+// it over <path> and fsyncs the directory. The file on disk is therefore
+// always either the previous complete checkpoint or the new one. If the
+// writer is still busy with the previous checkpoint, the request is
+// skipped rather than stalling training.
+//
+// checkpoint_attach() hooks a Checkpointer into mlp_train (and the pipeline
+// trainer) every `every` epochs; checkpoint_load() restores a model, and
+// mlp->epoch tells the caller how many epochs are already done.
+
+#define CHECKPOINT_MAGIC "NNCKPT01"
+#define CHECKPOINT_FORMAT 2          // 1 had no flags, its files still load
+#define CHECKPOINT_FLAG_SHUFFLE 1u
+
+typedef struct {
+  char magic[8];
+  uint32_t format;
+  uint32_t num_layers;
+  uint64_t epoch;
+  uint64_t rng_state;       // mlp->seed, the shuffle order of later epochs derives from it
+  float learning_rate;
+  uint32_t flags;           // CHECKPOINT_FLAG_*
+  uint64_t param_floats;
+  uint64_t checksum;        // FNV-1a over the header fields above and everything after the header
+} CheckpointHeader;         // followed by num_layers x {rows, cols, activation} (uint32), then the parameters
+
+typedef struct {
+  char *path;
+  char *tmp_path;
+  MLP *attached;            // model whose epoch hook points here, see checkpoint_attach
+  size_t every;             // epochs between checkpoints when attached
+
+  char *staging;            // header + topology + parameters, handed to the writer
+  size_t staging_bytes;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  bool pending;             // staging holds a checkpoint not written yet
+  bool stopping;
+  std::thread writer;
+
+  size_t requested;
+  size_t written;
+  size_t skipped;           // writer was still busy
+  size_t failed;
+  double last_copy_ms;      // time checkpoint_request held training up
+  double last_write_ms;
+} Checkpointer;
+
+typedef struct {
+  size_t requested;
+  size_t written;
+  size_t skipped;
+  size_t failed;
+  double last_copy_ms;
+  double last_write_ms;
+} CheckpointStats;
+
+static inline uint64_t checkpoint_fnv1a(const void* data, size_t bytes, uint64_t hash) {
+  const unsigned char* p = (const unsigned char*)data;
+  for (size_t i = 0; i < bytes; i++) {
+    hash ^= p[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Format 1 only covered what follows the header, so a flipped epoch or seed went unnoticed
+static uint64_t checkpoint_checksum(const char* buf, size_t bytes, uint32_t format) {
+  uint64_t hash = 14695981039346656037ull;
+  if (format >= 2) hash = checkpoint_fnv1a(buf, offsetof(CheckpointHeader, checksum), hash);
+  return checkpoint_fnv1a(buf + sizeof(CheckpointHeader), bytes - sizeof(CheckpointHeader), hash);
+}
+
+static inline double checkpoint_now_ms() {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static size_t checkpoint_bytes_for(const MLP* mlp) {
+  size_t floats = 0;
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    floats += mat_size(mlp->layers[i].weights) + mat_size(mlp->layers[i].bias);
+  }
+  return sizeof(CheckpointHeader) + mlp->num_layers * 3 * sizeof(uint32_t) + floats * sizeof(float);
+}
+
+// Serializes mlp into buf (checkpoint_bytes_for(mlp) bytes). The checksum is left to the writer.
+static void checkpoint_serialize(const MLP* mlp, char* buf) {
+  CheckpointHeader* header = (CheckpointHeader*)buf;
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+  header->format = CHECKPOINT_FORMAT;
+  header->num_layers = (uint32_t)mlp->num_layers;
+  header->epoch = mlp->epoch;
+  header->rng_state = mlp->seed;
+  header->learning_rate = mlp->learning_rate;
+  header->flags = mlp->shuffle ? CHECKPOINT_FLAG_SHUFFLE : 0;
+
+  uint32_t* topo = (uint32_t*)(header + 1);
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    topo[3 * i] = (uint32_t)mlp->layers[i].weights->rows;
+    topo[3 * i + 1] = (uint32_t)mlp->layers[i].weights->cols;
+    topo[3 * i + 2] = (uint32_t)mlp->activations[i];
+  }
+
+  float* dst = (float*)(topo + 3 * mlp->num_layers);
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    const Matrix* mats[2] = {mlp->layers[i].weights, mlp->layers[i].bias};
+    for (size_t k = 0; k < 2; k++) {
+      for (size_t r = 0; r < mats[k]->rows; r++) {
+        memcpy(dst, mats[k]->data + r * mats[k]->stride, mats[k]->cols * sizeof(float));
+        dst += mats[k]->cols;
+      }
+    }
+  }
+  header->param_floats = (uint64_t)(dst - (float*)(topo + 3 * mlp->num_layers));
+}
+
+static int checkpoint_fsync_dir(const char* path) {
+  const char* slash = strrchr(path, '/');
+  char dir[4096];
+  if (!slash) {
+    strcpy(dir, ".");
+  } else if (slash == path) {
+    strcpy(dir, "/");
+  } else {
+    size_t len = (size_t)(slash - path);
+    if (len >= sizeof(dir)) return -1;
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+  }
+
+  int fd = open(dir, O_RDONLY);
+  if (fd < 0) return -1;
+  int rc = fsync(fd);
+  close(fd);
+  return rc;
+}
+
+// tmp file, fsync, rename over the target, fsync the directory
+static int checkpoint_write_file(const char* path, const char* tmp_path, char* buf, size_t bytes) {
+  CheckpointHeader* header = (CheckpointHeader*)buf;
+  header->checksum = checkpoint_checksum(buf, bytes, header->format);
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return -1;
+
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t n = write(fd, buf + done, bytes - done);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      close(fd);
+      unlink(tmp_path);
+      return -1;
+    }
+    done += (size_t)n;
+  }
+
+  if (fsync(fd) != 0) {
+    close(fd);
+    unlink(tmp_path);
+    return -1;
+  }
+  close(fd);
+
+  if (rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    return -1;
+  }
+  checkpoint_fsync_dir(path);  // best effort, the data itself is already durable
+  return 0;
+}
+
+static void checkpoint_writer_loop(Checkpointer* ckpt) {
+  std::unique_lock<std::mutex> guard(ckpt->lock);
+  for (;;) {
+    ckpt->wake.wait(guard, [ckpt] { return ckpt->pending || ckpt->stopping; });
+    if (!ckpt->pending) break;  // stopping with nothing left to write
+
+    // staging is not touched by checkpoint_request while pending is set
+    guard.unlock();
+    double t0 = checkpoint_now_ms();
+    int rc = checkpoint_write_file(ckpt->path, ckpt->tmp_path, ckpt->staging, ckpt->staging_bytes);
+    double elapsed = checkpoint_now_ms() - t0;
+    guard.lock();
+
+    ckpt->last_write_ms = elapsed;
+    if (rc == 0) ckpt->written++;
+    else ckpt->failed++;
+    ckpt->pending = false;
+    ckpt->wake.notify_all();
+  }
+}
+
+Checkpointer* checkpoint_create(const char* path) {
+  if (!path || !*path) return NULL;
+
+  Checkpointer* ckpt = new Checkpointer();
+  size_t len = strlen(path);
+  ckpt->path = (char*)malloc(len + 1);
+  ckpt->tmp_path = (char*)malloc(len + 5);
+  if (!ckpt->path || !ckpt->tmp_path) {
+    free(ckpt->path);
+    free(ckpt->tmp_path);
+    delete ckpt;
+    return NULL;
+  }
+  memcpy(ckpt->path, path, len + 1);
+  snprintf(ckpt->tmp_path, len + 5, "%s.tmp", path);
+
+  ckpt->attached = NULL;
+  ckpt->every = 1;
+  ckpt->staging = NULL;
+  ckpt->staging_bytes = 0;
+  ckpt->pending = false;
+  ckpt->stopping = false;
+  ckpt->requested = ckpt->written = ckpt->skipped = ckpt->failed = 0;
+  ckpt->last_copy_ms = ckpt->last_write_ms = 0.0;
+  ckpt->writer = std::thread(checkpoint_writer_loop, ckpt);
+  return ckpt;
+}
+
+// Stage a checkpoint of mlp and return without waiting for the disk.
+// Returns 0 if staged, 1 if skipped because the previous one is still being written, -1 on error.
+int checkpoint_request(Checkpointer* ckpt, const MLP* mlp) {
+  if (!ckpt || !mlp) return -1;
+
+  std::lock_guard<std::mutex> guard(ckpt->lock);
+  ckpt->requested++;
+  if (ckpt->pending) {
+    ckpt->skipped++;
+    return 1;
+  }
+
+  double t0 = checkpoint_now_ms();
+  size_t bytes = checkpoint_bytes_for(mlp);
+  if (bytes != ckpt->staging_bytes) {
+    char* grown = (char*)realloc(ckpt->staging, bytes);
+    if (!grown) {
+      ckpt->failed++;
+      return -1;
+    }
+    ckpt->staging = grown;
+    ckpt->staging_bytes = bytes;
+  }
+  checkpoint_serialize(mlp, ckpt->staging);
+  ckpt->last_copy_ms = checkpoint_now_ms() - t0;
+
+  ckpt->pending = true;
+  ckpt->wake.notify_all();
+  return 0;
+}
+
+// Blocks until the staged checkpoint (if any) is on disk
+void checkpoint_wait(Checkpointer* ckpt) {
+  if (!ckpt) return;
+  std::unique_lock<std::mutex> guard(ckpt->lock);
+  ckpt->wake.wait(guard, [ckpt] { return !ckpt->pending; });
+}
+
+static void checkpoint_epoch_hook(void* ctx, size_t epoch, float) {
+  Checkpointer* ckpt = (Checkpointer*)ctx;
+  if (ckpt->attached && epoch % ckpt->every == 0) {
+    checkpoint_request(ckpt, ckpt->attached);
+  }
+}
+
+// Checkpoint mlp after every `every` training epochs (replaces any other epoch hook)
+int checkpoint_attach(Checkpointer* ckpt, MLP* mlp, size_t every) {
+  if (!ckpt || !mlp || every == 0) return -1;
+
+  ckpt->attached = mlp;
+  ckpt->every = every;
+  mlp->epoch_hook = checkpoint_epoch_hook;
+  mlp->epoch_hook_ctx = ckpt;
+  return 0;
+}
+
+void checkpoint_detach(Checkpointer* ckpt) {
+  if (!ckpt || !ckpt->attached) return;
+
+  if (ckpt->attached->epoch_hook_ctx == ckpt) {
+    ckpt->attached->epoch_hook = NULL;
+    ckpt->attached->epoch_hook_ctx = NULL;
+  }
+  ckpt->attached = NULL;
+}
+
+// Finishes the pending write, then stops the writer. The attached MLP, if
+// any, must still be alive.
+void checkpoint_free(Checkpointer* ckpt) {
+  if (!ckpt) return;
+
+  checkpoint_detach(ckpt);
+  {
+    std::lock_guard<std::mutex> guard(ckpt->lock);
+    ckpt->stopping = true;
+  }
+  ckpt->wake.notify_all();
+  ckpt->writer.join();
+
+  free(ckpt->staging);
+  free(ckpt->path);
+  free(ckpt->tmp_path);
+  delete ckpt;
+}
+
+CheckpointStats checkpoint_stats(Checkpointer* ckpt) {
+  CheckpointStats stats = {0, 0, 0, 0, 0.0, 0.0};
+  if (!ckpt) return stats;
+
+  std::lock_guard<std::mutex> guard(ckpt->lock);
+  stats.requested = ckpt->requested;
+  stats.written = ckpt->written;
+  stats.skipped = ckpt->skipped;
+  stats.failed = ckpt->failed;
+  stats.last_copy_ms = ckpt->last_copy_ms;
+  stats.last_write_ms = ckpt->last_write_ms;
+  return stats;
+}
+
+// Restores parameters, epoch count, seed, learning rate and shuffle from a checkpoint of
+// the same topology. 0 on success, -1 if the file is missing, torn or for a
+// different network (mlp is untouched then).
+int checkpoint_load(const char* path, MLP* mlp) {
+  if (!path || !mlp) return -1;
+
+  FILE* file = fopen(path, "rb");
+  if (!file) return -1;
+
+  size_t bytes = checkpoint_bytes_for(mlp);
+  char* buf = (char*)malloc(bytes + 1);
+  size_t got = buf ? fread(buf, 1, bytes + 1, file) : 0;
+  fclose(file);
+  if (!buf || got != bytes) {
+    free(buf);
+    return -1;
+  }
+
+  const CheckpointHeader* header = (const CheckpointHeader*)buf;
+  int ok = memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) == 0 &&
+           (header->format == CHECKPOINT_FORMAT || header->format == 1) &&
+           header->num_layers == mlp->num_layers &&
+           header->checksum == checkpoint_checksum(buf, bytes, header->format);
+
+  const uint32_t* topo = (const uint32_t*)(header + 1);
+  for (size_t i = 0; ok && i < mlp->num_layers; i++) {
+    ok = topo[3 * i] == mlp->layers[i].weights->rows &&
+         topo[3 * i + 1] == mlp->layers[i].weights->cols &&
+         topo[3 * i + 2] == (uint32_t)mlp->activations[i];
+  }
+  if (!ok) {
+    free(buf);
+    return -1;
+  }
+
+  const float* src = (const float*)(topo + 3 * mlp->num_layers);
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    Matrix* mats[2] = {mlp->layers[i].weights, mlp->layers[i].bias};
+    for (size_t k = 0; k < 2; k++) {
+      for (size_t r = 0; r < mats[k]->rows; r++) {
+        memcpy(mats[k]->data + r * mats[k]->stride, src, mats[k]->cols * sizeof(float));
+        src += mats[k]->cols;
+      }
+    }
+  }
+  mlp->epoch = header->epoch;
+  mlp->seed = header->rng_state;
+  mlp->learning_rate = header->learning_rate;
+  if (header->format >= 2) mlp->shuffle = (header->flags & CHECKPOINT_FLAG_SHUFFLE) != 0;
+  mlp_mark_updated(mlp);
+
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,349 @@
+#pragma once
+
+#include "MLP.hpp"
+#include "../../Utils/SPSCQueue.hpp"
+#include "../../Utils/ShmTransport.hpp"
+#include <atomic>
+#include <thread>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Multi-process data-parallel training.
+//
+// mlp_train_data_parallel() forks num_workers processes. Each one starts from
+// a copy of the MLP and trains on its own contiguous shard of the samples,
+// batch_size samples per step. After every step the summed gradients of all
+// layers are all-reduced over a Transport, so every rank applies the same
+// mean-gradient update and the replicas never diverge.
+//
+// The all-reduce runs on a communication thread. Backward hands each layer
+// over as soon as its gradients are final, so the last layers are being
+// reduced while the earlier ones are still computing. When training ends,
+// rank 0 copies the weights into the shared segment and the launcher loads
+// them back into the caller's MLP.
+//
+// dp_worker_train() only needs a Transport, so it runs unchanged on any
+// backend; the launcher is the only part tied to shared memory and fork().
+
+#define DP_STOP_ITEM ((void*)~(uintptr_t)0)
+
+typedef struct {
+  Matrix **inputs;
+  Matrix **targets;
+  size_t num_samples;
+  size_t epochs;
+  LossFunction loss_func;
+  float epsilon;
+  size_t batch_size;        // per rank and step
+} DPConfig;
+
+typedef struct {
+  float loss;               // last epoch's average loss, written by rank 0
+  int done;                 // set by rank 0 once the weights below are complete
+  size_t epochs;            // epochs run (training may stop early at epsilon)
+} DPResult;                 // followed by the parameters at DP_RESULT_OFFSET
+
+#define DP_RESULT_OFFSET 64
+
+static inline size_t dp_shard_begin(size_t num_samples, int rank, int world) {
+  return num_samples * (size_t)rank / (size_t)world;
+}
+
+// Samples rank contributes to step `step`
+static inline size_t dp_step_count(const DPConfig* cfg, int rank, int world, size_t step) {
+  size_t shard = dp_shard_begin(cfg->num_samples, rank + 1, world) - dp_shard_begin(cfg->num_samples, rank, world);
+  size_t done = step * cfg->batch_size;
+  if (done >= shard) return 0;
+  return shard - done < cfg->batch_size ? shard - done : cfg->batch_size;
+}
+
+// The padding of a padded matrix is zero, so reducing rows * stride floats is exact
+static inline int dp_allreduce_matrix(Transport* t, Matrix* m) {
+  return transport_allreduce_sum(t, m->data, m->rows * m->stride);
+}
+
+typedef struct {
+  MLP *mlp;
+  Transport *transport;
+  SPSCQueue *todo;              // layers whose gradients are ready, as (void*)(layer + 1)
+  std::atomic<size_t> reduced;  // layers reduced in the current step
+  std::atomic<int> failed;
+} DPComm;
+
+static void dp_comm_loop(DPComm* comm) {
+  for (;;) {
+    void* item = spsc_pop(comm->todo);
+    if (item == DP_STOP_ITEM) break;
+
+    Layer* layer = &comm->mlp->layers[(uintptr_t)item - 1];
+    if (dp_allreduce_matrix(comm->transport, layer->weight_grad) != 0 ||
+        dp_allreduce_matrix(comm->transport, layer->bias_grad) != 0) {
+      comm->failed = 1;
+    }
+    comm->reduced.fetch_add(1, std::memory_order_release);
+  }
+}
+
+// One rank's training loop. All ranks must pass the same MLP topology and
+// config. Returns the last epoch's average loss (over all ranks), -1 on error.
+float dp_worker_train(MLP* mlp, Transport* t, const DPConfig* cfg) {
+  if (!mlp || !t || !cfg || cfg->batch_size == 0) return -1.0f;
+  if (mlp_zero_grads(mlp) != 0) return -1.0f;
+
+  int rank = t->rank, world = t->world;
+  size_t L = mlp->num_layers;
+  size_t B = cfg->batch_size;
+  size_t shard_first = dp_shard_begin(cfg->num_samples, rank, world);
+  size_t largest_shard = (cfg->num_samples + world - 1) / world;
+  size_t steps = (largest_shard + B - 1) / B;
+
+  // per layer activations plus ping-pong gradients for one local batch
+  size_t max_rows = mlp->layers[0].weights->cols;
+  Matrix** acts = (Matrix**)calloc(L, sizeof(Matrix*));
+  Matrix* in = mat_create(mlp->layers[0].weights->cols, B);
+  Matrix* target = mat_create(mlp->layers[L - 1].weights->rows, B);
+  Matrix* grad[2] = {NULL, NULL};
+  int ok = acts && in && target;
+  for (size_t l = 0; ok && l < L; l++) {
+    if (mlp->layers[l].weights->rows > max_rows) max_rows = mlp->layers[l].weights->rows;
+    acts[l] = mat_create(mlp->layers[l].weights->rows, B);
+    ok = acts[l] != NULL;
+  }
+  if (ok) {
+    grad[0] = mat_create(max_rows, B);
+    grad[1] = mat_create(max_rows, B);
+    ok = grad[0] && grad[1];
+  }
+
+  DPComm comm;
+  comm.mlp = mlp;
+  comm.transport = t;
+  comm.todo = ok ? spsc_create(L + 1) : NULL;
+  comm.reduced = 0;
+  comm.failed = 0;
+  ok = ok && comm.todo;
+
+  float avg_loss = -1.0f;
+  if (ok) {
+    std::thread comm_thread(dp_comm_loop, &comm);
+
+    for (size_t epoch = 0; epoch < cfg->epochs; epoch++) {
+      float epoch_loss = 0.0f;
+
+      for (size_t step = 0; step < steps; step++) {
+        size_t count = dp_step_count(cfg, rank, world, step);
+        size_t global = 0;
+        for (int r = 0; r < world; r++) {
+          global += dp_step_count(cfg, r, world, step);
+        }
+
+        if (count == 0) {
+          // nothing local this step, contribute zero gradients
+          for (size_t l = L; l-- > 0;) {
+            spsc_push(comm.todo, (void*)(uintptr_t)(l + 1));
+          }
+        } else {
+          size_t first = shard_first + step * B;
+          mlp_gather_columns(cfg->inputs, first, count, in);
+          mlp_gather_columns(cfg->targets, first, count, target);
+
+          Matrix* x = mat_view_cols(in, 0, count);
+          for (size_t l = 0; l < L; l++) {
+            Matrix* y = mat_view_cols(acts[l], 0, count);
+            if (layer_forward_batch(&mlp->layers[l], mlp->activations[l], x, y) != 0) comm.failed = 1;
+            mat_free(x);
+            x = y;
+          }
+
+          Matrix* y_true = mat_view_cols(target, 0, count);
+          Matrix* out_grad = mat_view(grad[0], 0, 0, x->rows, count);
+          epoch_loss += compute_loss(cfg->loss_func, x, y_true) * count;
+          compute_loss_derivative(cfg->loss_func, x, y_true, out_grad);
+          mat_free(y_true);
+          mat_free(x);
+
+          int next = 1;
+          for (size_t l = L; l-- > 0;) {
+            Layer* layer = &mlp->layers[l];
+            Matrix* out = mat_view_cols(acts[l], 0, count);
+            Matrix* layer_in = l > 0 ? mat_view_cols(acts[l - 1], 0, count) : mat_view_cols(in, 0, count);
+            Matrix* in_grad = NULL;
+            if (l > 0) {
+              in_grad = mat_view(grad[next], 0, 0, layer->weights->cols, count);
+              next ^= 1;
+            }
+
+            if (layer_backward_batch(layer, mlp->activations[l], layer_in, out, out_grad, in_grad,
+                                     layer->weight_grad, layer->bias_grad) != 0) {
+              comm.failed = 1;
+            }
+            // this layer's gradients are final, reduce them while the next one computes
+            spsc_push(comm.todo, (void*)(uintptr_t)(l + 1));
+
+            mat_free(out);
+            mat_free(layer_in);
+            mat_free(out_grad);
+            out_grad = in_grad;
+          }
+        }
+
+        for (size_t spins = 0; comm.reduced.load(std::memory_order_acquire) < L; spins++) {
+          if (spins >= SPSC_SPIN_LIMIT) std::this_thread::yield();
+        }
+        comm.reduced.store(0, std::memory_order_relaxed);
+
+        float rate = mlp->learning_rate / global;
+        for (size_t l = 0; l < L; l++) {
+          layer_apply_grads(&mlp->layers[l], rate);
+        }
+        mlp_mark_updated(mlp);
+      }
+
+      // the comm thread is idle between steps, so the main thread can use the transport
+      if (transport_allreduce_sum(t, &epoch_loss, 1) != 0) comm.failed = 1;
+      avg_loss = epoch_loss / cfg->num_samples;
+      if (rank == 0 && (epoch % 10 == 0 || epoch == cfg->epochs - 1))
+        printf("Epoch %zu/%zu = Loss: %.4f\n", epoch + 1, cfg->epochs, avg_loss);
+
+      mlp->epoch++;
+      if (avg_loss < cfg->epsilon || comm.failed) break;
+    }
+
+    spsc_push(comm.todo, DP_STOP_ITEM);
+    comm_thread.join();
+  }
+
+  if (acts) {
+    for (size_t l = 0; l < L; l++) {
+      mat_free(acts[l]);
+    }
+    free(acts);
+  }
+  mat_free(in);
+  mat_free(target);
+  mat_free(grad[0]);
+  mat_free(grad[1]);
+  spsc_free(comm.todo);
+
+  return (!ok || comm.failed) ? -1.0f : avg_loss;
+}
+
+static size_t dp_param_floats(const MLP* mlp) {
+  size_t total = 0;
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    total += mat_size(mlp->layers[l].weights) + mat_size(mlp->layers[l].bias);
+  }
+  return total;
+}
+
+// Copies every weight and bias into / out of a flat array (dense row-major order)
+static void dp_store_params(const MLP* mlp, float* dst) {
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    const Matrix* mats[2] = {mlp->layers[l].weights, mlp->layers[l].bias};
+    for (size_t k = 0; k < 2; k++) {
+      for (size_t i = 0; i < mats[k]->rows; i++) {
+        memcpy(dst, mats[k]->data + i * mats[k]->stride, mats[k]->cols * sizeof(float));
+        dst += mats[k]->cols;
+      }
+    }
+  }
+}
+
+static void dp_load_params(MLP* mlp, const float* src) {
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    Matrix* mats[2] = {mlp->layers[l].weights, mlp->layers[l].bias};
+    for (size_t k = 0; k < 2; k++) {
+      for (size_t i = 0; i < mats[k]->rows; i++) {
+        memcpy(mats[k]->data + i * mats[k]->stride, src, mats[k]->cols * sizeof(float));
+        src += mats[k]->cols;
+      }
+    }
+  }
+}
+
+// Trains mlp with num_workers forked processes over POSIX shared memory.
+// The global batch of a step is num_workers * batch_size samples. Returns the
+// last epoch's average loss, -1 on error (mlp is left untouched then).
+float mlp_train_data_parallel(MLP* mlp, Matrix** inputs, Matrix** targets, size_t num_samples, size_t epochs,
+                              LossFunction loss_func, float epsilon, int num_workers, size_t batch_size) {
+  if (!mlp || !inputs || !targets || num_samples == 0) return -1.0f;
+  if (num_workers < 1 || batch_size == 0) return -1.0f;
+  if ((size_t)num_workers > num_samples) num_workers = (int)num_samples;
+
+  size_t in_size = mlp->layers[0].weights->cols;
+  size_t out_size = mlp->layers[mlp->num_layers - 1].weights->rows;
+  for (size_t i = 0; i < num_samples; i++) {
+    if (!mat_is_valid(inputs[i]) || inputs[i]->rows != in_size || inputs[i]->cols != 1) return -1.0f;
+    if (!mat_is_valid(targets[i]) || targets[i]->rows != out_size || targets[i]->cols != 1) return -1.0f;
+  }
+
+  size_t param_bytes = dp_param_floats(mlp) * sizeof(float);
+  ShmWorld* world = shm_world_create(num_workers, SHM_DEFAULT_CHANNEL_BYTES, DP_RESULT_OFFSET + param_bytes);
+  if (!world) return -1.0f;
+  DPResult* result = (DPResult*)shm_world_user(world);
+
+  DPConfig cfg = {inputs, targets, num_samples, epochs, loss_func, epsilon, batch_size};
+
+  fflush(stdout);  // or every child flushes its own copy of the buffer
+  pid_t* pids = (pid_t*)calloc(num_workers, sizeof(pid_t));
+  int failed = pids == NULL;
+  int started = 0;
+  for (; !failed && started < num_workers; started++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      failed = 1;
+      break;
+    }
+    if (pid == 0) {
+      // threads do not survive fork(), a hook that talks to one (a Checkpointer) would hang
+      mlp->epoch_hook = NULL;
+      Transport* t = shm_transport_open(world, started);
+      float loss = t ? dp_worker_train(mlp, t, &cfg) : -1.0f;
+      if (loss >= 0.0f && started == 0) {
+        dp_store_params(mlp, (float*)((char*)result + DP_RESULT_OFFSET));
+        result->loss = loss;
+        result->epochs = mlp->epoch;
+        result->done = 1;
+      }
+      transport_close(t);
+      fflush(stdout);
+      _exit(loss >= 0.0f ? 0 : 1);
+    }
+    pids[started] = pid;
+  }
+
+  // reap the workers, a rank that dies would leave the others waiting on it forever
+  int remaining = started;
+  while (remaining > 0) {
+    int progressed = 0;
+    for (int r = 0; r < started; r++) {
+      if (pids[r] <= 0) continue;
+      int status = 0;
+      pid_t done = failed ? waitpid(pids[r], &status, 0) : waitpid(pids[r], &status, WNOHANG);
+      if (done == 0) continue;
+      if (done < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) failed = 1;
+      pids[r] = 0;
+      remaining--;
+      progressed = 1;
+    }
+    if (failed) {
+      for (int r = 0; r < started; r++) {
+        if (pids[r] > 0) kill(pids[r], SIGKILL);
+      }
+    } else if (!progressed) {
+      usleep(1000);
+    }
+  }
+  free(pids);
+
+  float loss = -1.0f;
+  if (!failed && result->done) {
+    dp_load_params(mlp, (const float*)((const char*)result + DP_RESULT_OFFSET));
+    mlp->epoch = result->epochs;
+    loss = result->loss;
+  }
+  shm_world_free(world);
+  return loss;
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "MLP.hpp"
+
+// Batch-1 inference path.
+//
+// mlp_prepack() copies every layer's weights once into row panels of
+// INFER_PANEL_ROWS output rows, stored column-interleaved:
+//
+//   panel p, column k: W[p*R + 0][k], W[p*R + 1][k], ..., W[p*R + R-1][k]
+//
+// so a matrix-vector product walks each panel linearly and updates R output
+// rows per input element with one SIMD multiply-add. Bias and activation are
+// applied while the accumulators are still in registers, and the activation
+// vector ping-pongs between two small buffers that stay in L1.
+//
+// The prepacked copy is read-only after mlp_prepack(), so several threads can
+// share it as long as each passes its own scratch to infer_forward().
+
+#define INFER_PANEL_ROWS 16   // = MAT_SIMD_FLOATS, the kernel below is written for 4 x 4 lanes
+
+typedef struct {
+  Matrix *panels;       // (num_panels x in * INFER_PANEL_ROWS)
+  Matrix *bias;         // (num_panels * INFER_PANEL_ROWS x 1), zero past `out`
+  size_t in;
+  size_t out;
+  size_t num_panels;
+  ActivationType activation;
+} InferLayer;
+
+typedef struct {
+  InferLayer *layers;
+  size_t num_layers;
+  size_t input_size;
+  size_t output_size;
+  size_t max_width;     // widest padded activation vector
+  Matrix *scratch;      // (2 x max_width), used by infer_forward_mat
+} InferMLP;
+
+static inline size_t infer_round_panels(size_t rows) {
+  return (rows + INFER_PANEL_ROWS - 1) / INFER_PANEL_ROWS;
+}
+
+void infer_free(InferMLP* net) {
+  if (!net) return;
+
+  if (net->layers) {
+    for (size_t i = 0; i < net->num_layers; i++) {
+      if (net->layers[i].panels) mat_free(net->layers[i].panels);
+      if (net->layers[i].bias) mat_free(net->layers[i].bias);
+    }
+    free(net->layers);
+  }
+  if (net->scratch) mat_free(net->scratch);
+
+  free(net);
+}
+
+// Re-pack weights and biases of an existing InferMLP (same topology) from mlp.
+int infer_repack(InferMLP* net, const MLP* mlp) {
+  if (!net || !mlp || net->num_layers != mlp->num_layers) return -1;
+
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    const Layer* layer = &mlp->layers[l];
+    InferLayer* il = &net->layers[l];
+    if (layer->weights->rows != il->out || layer->weights->cols != il->in) return -1;
+
+    for (size_t p = 0; p < il->num_panels; p++) {
+      float* panel = il->panels->data + p * il->panels->stride;
+      for (size_t k = 0; k < il->in; k++) {
+        for (size_t r = 0; r < INFER_PANEL_ROWS; r++) {
+          size_t row = p * INFER_PANEL_ROWS + r;
+          panel[k * INFER_PANEL_ROWS + r] = row < il->out ? mat_get_unsafe(layer->weights, row, k) : 0.0f;
+        }
+      }
+    }
+
+    for (size_t r = 0; r < il->out; r++) {
+      il->bias->data[r] = mat_get_unsafe(layer->bias, r, 0);
+    }
+    il->activation = mlp->activations[l];
+  }
+
+  return 0;
+}
+
+InferMLP* mlp_prepack(const MLP* mlp) {
+  if (!mlp || mlp->num_layers == 0) return NULL;
+
+  InferMLP* net = (InferMLP*)calloc(1, sizeof(InferMLP));
+  CHECK_NULL(net);
+
+  net->layers = (InferLayer*)calloc(mlp->num_layers, sizeof(InferLayer));
+  if (!net->layers) {
+    free(net);
+    return NULL;
+  }
+  net->num_layers = mlp->num_layers;
+  net->input_size = mlp->layers[0].weights->cols;
+  net->output_size = mlp->layers[mlp->num_layers - 1].weights->rows;
+  net->max_width = infer_round_panels(net->input_size) * INFER_PANEL_ROWS;
+
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    InferLayer* il = &net->layers[l];
+    il->in = mlp->layers[l].weights->cols;
+    il->out = mlp->layers[l].weights->rows;
+    il->num_panels = infer_round_panels(il->out);
+    il->panels = mat_create_ex(il->num_panels, il->in * INFER_PANEL_ROWS, MAT_LAYOUT_DENSE);
+    il->bias = mat_create_ex(il->num_panels * INFER_PANEL_ROWS, 1, MAT_LAYOUT_DENSE);
+    if (!il->panels || !il->bias) {
+      infer_free(net);
+      return NULL;
+    }
+
+    size_t width = il->num_panels * INFER_PANEL_ROWS;
+    if (width > net->max_width) net->max_width = width;
+  }
+
+  net->scratch = mat_create_ex(2, net->max_width, MAT_LAYOUT_DENSE);
+  if (!net->scratch || infer_repack(net, mlp) != 0) {
+    infer_free(net);
+    return NULL;
+  }
+
+  return net;
+}
+
+// Floats of scratch infer_forward needs (two 64-byte aligned vectors)
+size_t infer_scratch_floats(const InferMLP* net) {
+  return net ? 2 * net->max_width : 0;
+}
+
+static inline float infer_activate(ActivationType type, float x) {
+  switch (type) {
+    case ACTIVATION_RELU:
+      return relu(x);
+    case ACTIVATION_TANH:
+      return tanh_act(x);
+    case ACTIVATION_SIGMOID:
+    default:
+      return sigmoid(x);
+  }
+}
+
+// 4-float GCC/Clang vector: a panel row is INFER_PANEL_ROWS / 4 of them, each
+// kept in its own register (a single 64-byte vector would spill on SSE).
+typedef float infer_v4 __attribute__((vector_size(4 * sizeof(float))));
+
+static inline void infer_store_panel(ActivationType activation, float* out,
+                                     infer_v4 a0, infer_v4 a1, infer_v4 a2, infer_v4 a3) {
+  for (size_t r = 0; r < 4; r++) {
+    out[r] = infer_activate(activation, a0[r]);
+    out[r + 4] = infer_activate(activation, a1[r]);
+    out[r + 8] = infer_activate(activation, a2[r]);
+    out[r + 12] = infer_activate(activation, a3[r]);
+  }
+}
+
+// y = act(W x + b) for one layer, y has num_panels * INFER_PANEL_ROWS slots.
+// Panels go two at a time so 8 independent accumulators hide the add latency.
+static inline void infer_layer_gemv(const InferLayer* il, const float* x, float* y) {
+  const float* bias = il->bias->data;
+  size_t p = 0;
+
+  for (; p + 2 <= il->num_panels; p += 2) {
+    const infer_v4* pa = (const infer_v4*)(il->panels->data + p * il->panels->stride);
+    const infer_v4* pb = (const infer_v4*)(il->panels->data + (p + 1) * il->panels->stride);
+    const infer_v4* b = (const infer_v4*)(bias + p * INFER_PANEL_ROWS);
+    infer_v4 a0 = b[0], a1 = b[1], a2 = b[2], a3 = b[3];
+    infer_v4 b0 = b[4], b1 = b[5], b2 = b[6], b3 = b[7];
+
+    for (size_t k = 0; k < il->in; k++, pa += 4, pb += 4) {
+      float xk = x[k];
+      a0 += pa[0] * xk;
+      a1 += pa[1] * xk;
+      a2 += pa[2] * xk;
+      a3 += pa[3] * xk;
+      b0 += pb[0] * xk;
+      b1 += pb[1] * xk;
+      b2 += pb[2] * xk;
+      b3 += pb[3] * xk;
+    }
+
+    infer_store_panel(il->activation, y + p * INFER_PANEL_ROWS, a0, a1, a2, a3);
+    infer_store_panel(il->activation, y + (p + 1) * INFER_PANEL_ROWS, b0, b1, b2, b3);
+  }
+
+  for (; p < il->num_panels; p++) {
+    const infer_v4* pa = (const infer_v4*)(il->panels->data + p * il->panels->stride);
+    const infer_v4* b = (const infer_v4*)(bias + p * INFER_PANEL_ROWS);
+    infer_v4 a0 = b[0], a1 = b[1], a2 = b[2], a3 = b[3];
+
+    for (size_t k = 0; k < il->in; k++, pa += 4) {
+      float xk = x[k];
+      a0 += pa[0] * xk;
+      a1 += pa[1] * xk;
+      a2 += pa[2] * xk;
+      a3 += pa[3] * xk;
+    }
+
+    infer_store_panel(il->activation, y + p * INFER_PANEL_ROWS, a0, a1, a2, a3);
+  }
+}
+
+// Runs every layer, returns the buffer holding the final activations.
+// x may live in the second half of scratch (layer 0 writes the first half).
+static inline const float* infer_run(const InferMLP* net, const float* x, float* scratch) {
+  float* bufs[2] = {scratch, scratch + net->max_width};
+  const float* in = x;
+
+  for (size_t l = 0; l < net->num_layers; l++) {
+    float* out = bufs[l & 1];
+    infer_layer_gemv(&net->layers[l], in, out);
+    in = out;
+  }
+  return in;
+}
+
+// Single-sample forward. x has input_size floats, y receives output_size
+// floats, scratch must hold infer_scratch_floats(net) floats (64-byte aligned
+// for best results). Safe to call concurrently with distinct scratch buffers.
+int infer_forward(const InferMLP* net, const float* x, float* y, float* scratch) {
+  if (!net || !x || !y || !scratch) return -1;
+
+  const float* result = infer_run(net, x, scratch);
+  memcpy(y, result, net->output_size * sizeof(float));
+  return 0;
+}
+
+// Matrix wrapper around infer_forward using the net's own scratch (not thread-safe).
+int infer_forward_mat(InferMLP* net, const Matrix* input, Matrix* output) {
+  if (!net || !mat_is_valid(input) || !mat_is_valid(output)) return -1;
+  if (input->rows != net->input_size || input->cols != 1) return -1;
+  if (output->rows != net->output_size || output->cols != 1) return -1;
+
+  float* scratch = net->scratch->data;
+  const float* x = input->data;
+  if (input->stride != 1) {
+    // strided column view, gather it once
+    float* staged = scratch + net->max_width;
+    for (size_t i = 0; i < input->rows; i++) {
+      staged[i] = input->data[i * input->stride];
+    }
+    x = staged;
+  }
+
+  const float* result = infer_run(net, x, scratch);
+  for (size_t i = 0; i < net->output_size; i++) {
+    output->data[i * output->stride] = result[i];
+  }
+  return 0;
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+#include "MLP.hpp"
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+
+// Result cache for repeated single-sample inference.
+//
+// mlp_forward_cached() hashes the input vector, looks it up and, on a hit,
+// copies the stored output instead of running the network. A hit needs the
+// same hash, bit-identical input (compared in full, hashes only pick the
+// bucket) and the model's current parameter version (mlp_version): every
+// update to the weights makes older entries misses, which then get
+// overwritten or age out. Nothing has to be flushed by hand.
+//
+// The cache holds at most `capacity` entries split over independent shards,
+// each a hash table plus an LRU list under its own mutex, so concurrent
+// callers only contend when their inputs land in the same shard. All entry
+// storage is allocated up front; a full shard evicts its least recently used
+// entry. The forward pass itself runs outside the lock.
+
+#define INFER_CACHE_DEFAULT_SHARDS 16
+
+typedef struct InferCacheEntry {
+  uint64_t hash;
+  uint64_t version;           // mlp_version when the output was computed
+  float *input;               // input_size floats
+  float *output;              // output_size floats
+  struct InferCacheEntry *chain;              // next in the hash bucket
+  struct InferCacheEntry *prev, *next;        // LRU list, most recent first
+} InferCacheEntry;
+
+typedef struct {
+  std::mutex lock;
+  InferCacheEntry **buckets;  // num_buckets heads, a power of two
+  size_t num_buckets;
+  InferCacheEntry *entries;   // capacity slots, the first `used` are in the table
+  size_t capacity;
+  size_t used;
+  InferCacheEntry *head, *tail;
+  size_t hits, misses, evictions, stale;
+  char pad[64];               // keeps neighbouring shards' hot fields apart
+} InferCacheShard;
+
+typedef struct {
+  size_t hits;
+  size_t misses;              // includes stale
+  size_t evictions;           // entries dropped to make room
+  size_t stale;               // input found, but computed with older weights
+  size_t entries;
+  size_t capacity;            // slots over all shards, the capacity asked for
+  double hit_rate;
+} InferCacheStats;
+
+typedef struct {
+  InferCacheShard *shards;
+  size_t num_shards;
+  size_t input_size;
+  size_t output_size;
+  float *storage;             // every entry's input and output
+} InferCache;
+
+static inline uint64_t infer_cache_word(const float* x, size_t i, size_t s) {
+  uint32_t lo, hi;
+  memcpy(&lo, x + i * s, sizeof(lo));
+  memcpy(&hi, x + (i + 1) * s, sizeof(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+// 64-bit hash of a column vector's values (as bits). Four independent
+// multiply-xorshift lanes over two floats each, so the multiplies overlap.
+static uint64_t infer_cache_hash(const Matrix* input) {
+  const uint64_t m = 0x9E3779B97F4A7C15ull;
+  uint64_t h[4] = {0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull};
+  size_t n = input->rows, s = input->stride;
+  const float* x = input->data;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    for (int l = 0; l < 4; l++) {
+      h[l] = (h[l] ^ infer_cache_word(x, i + 2 * l, s)) * m;
+      h[l] ^= h[l] >> 29;
+    }
+  }
+  for (; i + 2 <= n; i += 2) {
+    h[0] = (h[0] ^ infer_cache_word(x, i, s)) * m;
+    h[0] ^= h[0] >> 29;
+  }
+  if (i < n) {
+    uint32_t lo;
+    memcpy(&lo, x + i * s, sizeof(lo));
+    h[1] = (h[1] ^ lo) * m;
+  }
+
+  // fold the lanes and the length, then the splitmix64 finalizer: high bits
+  // pick the shard, low bits the bucket
+  uint64_t r = n * m;
+  for (int l = 0; l < 4; l++) r = (r ^ h[l]) * 0xFF51AFD7ED558CCDull + (r >> 32);
+  r ^= r >> 30;
+  r *= 0xBF58476D1CE4E5B9ull;
+  r ^= r >> 27;
+  r *= 0x94D049BB133111EBull;
+  r ^= r >> 31;
+  return r;
+}
+
+static inline int infer_cache_same_input(const InferCacheEntry* e, const Matrix* input) {
+  if (input->stride == 1) return memcmp(e->input, input->data, input->rows * sizeof(float)) == 0;
+  for (size_t i = 0; i < input->rows; i++) {
+    if (memcmp(e->input + i, input->data + i * input->stride, sizeof(float)) != 0) return 0;
+  }
+  return 1;
+}
+
+static inline InferCacheShard* infer_cache_shard(InferCache* cache, uint64_t hash) {
+  return &cache->shards[(hash >> 32) % cache->num_shards];
+}
+
+static inline InferCacheEntry** infer_cache_bucket(InferCacheShard* shard, uint64_t hash) {
+  return &shard->buckets[hash & (shard->num_buckets - 1)];
+}
+
+static void infer_cache_lru_unlink(InferCacheShard* shard, InferCacheEntry* e) {
+  if (e->prev) e->prev->next = e->next; else shard->head = e->next;
+  if (e->next) e->next->prev = e->prev; else shard->tail = e->prev;
+  e->prev = e->next = NULL;
+}
+
+static void infer_cache_lru_push_front(InferCacheShard* shard, InferCacheEntry* e) {
+  e->prev = NULL;
+  e->next = shard->head;
+  if (shard->head) shard->head->prev = e;
+  shard->head = e;
+  if (!shard->tail) shard->tail = e;
+}
+
+static void infer_cache_chain_remove(InferCacheShard* shard, InferCacheEntry* e) {
+  InferCacheEntry** link = infer_cache_bucket(shard, e->hash);
+  while (*link != e) link = &(*link)->chain;
+  *link = e->chain;
+}
+
+// entry holding this input, NULL if none (shard lock held)
+static InferCacheEntry* infer_cache_find(InferCacheShard* shard, uint64_t hash, const Matrix* input) {
+  for (InferCacheEntry* e = *infer_cache_bucket(shard, hash); e; e = e->chain) {
+    if (e->hash == hash && infer_cache_same_input(e, input)) return e;
+  }
+  return NULL;
+}
+
+// capacity entries over num_shards shards (0 = INFER_CACHE_DEFAULT_SHARDS)
+InferCache* infer_cache_create(const MLP* mlp, size_t capacity, size_t num_shards) {
+  if (!mlp || mlp->num_layers == 0 || capacity == 0) return NULL;
+  if (num_shards == 0) num_shards = INFER_CACHE_DEFAULT_SHARDS;
+  if (num_shards > capacity) num_shards = capacity;
+
+  InferCache* cache = (InferCache*)calloc(1, sizeof(InferCache));
+  CHECK_NULL(cache);
+  cache->num_shards = num_shards;
+  cache->input_size = mlp->layers[0].weights->cols;
+  cache->output_size = mlp->layers[mlp->num_layers - 1].weights->rows;
+
+  size_t floats = cache->input_size + cache->output_size;
+  cache->storage = (float*)malloc(sizeof(float) * floats * capacity);
+  cache->shards = new (std::nothrow) InferCacheShard[num_shards];
+  if (!cache->storage || !cache->shards) {
+    delete[] cache->shards;
+    free(cache->storage);
+    free(cache);
+    return NULL;
+  }
+
+  // the first capacity % num_shards shards take one extra slot, so the sizes sum to capacity
+  int ok = 1;
+  size_t first = 0;
+  for (size_t s = 0; s < num_shards; s++) {
+    InferCacheShard* shard = &cache->shards[s];
+    size_t per_shard = capacity / num_shards + (s < capacity % num_shards ? 1 : 0);
+    shard->num_buckets = 1;
+    while (shard->num_buckets < 2 * per_shard) shard->num_buckets <<= 1;
+    shard->buckets = (InferCacheEntry**)calloc(shard->num_buckets, sizeof(InferCacheEntry*));
+    shard->entries = (InferCacheEntry*)calloc(per_shard, sizeof(InferCacheEntry));
+    shard->capacity = per_shard;
+    shard->used = 0;
+    shard->head = shard->tail = NULL;
+    shard->hits = shard->misses = shard->evictions = shard->stale = 0;
+    if (!shard->buckets || !shard->entries) {
+      ok = 0;
+      continue;
+    }
+    for (size_t i = 0; i < per_shard; i++) {
+      float* slot = cache->storage + (first + i) * floats;
+      shard->entries[i].input = slot;
+      shard->entries[i].output = slot + cache->input_size;
+    }
+    first += per_shard;
+  }
+  if (!ok) {
+    for (size_t s = 0; s < num_shards; s++) {
+      free(cache->shards[s].buckets);
+      free(cache->shards[s].entries);
+    }
+    delete[] cache->shards;
+    free(cache->storage);
+    free(cache);
+    return NULL;
+  }
+  return cache;
+}
+
+void infer_cache_free(InferCache* cache) {
+  if (!cache) return;
+  for (size_t s = 0; s < cache->num_shards; s++) {
+    free(cache->shards[s].buckets);
+    free(cache->shards[s].entries);
+  }
+  delete[] cache->shards;
+  free(cache->storage);
+  free(cache);
+}
+
+// Copies the cached output for input into output if there is one computed
+// with parameters `version`. 1 on a hit, 0 on a miss.
+int infer_cache_lookup(InferCache* cache, uint64_t version, const Matrix* input, uint64_t hash, Matrix* output) {
+  InferCacheShard* shard = infer_cache_shard(cache, hash);
+  std::lock_guard<std::mutex> guard(shard->lock);
+
+  InferCacheEntry* e = infer_cache_find(shard, hash, input);
+  if (!e || e->version != version) {
+    if (e) shard->stale++;
+    shard->misses++;
+    return 0;
+  }
+
+  for (size_t i = 0; i < cache->output_size; i++) output->data[i * output->stride] = e->output[i];
+  if (shard->head != e) {
+    infer_cache_lru_unlink(shard, e);
+    infer_cache_lru_push_front(shard, e);
+  }
+  shard->hits++;
+  return 1;
+}
+
+// Stores output for input under version, replacing an entry for the same
+// input or else taking a free slot or the least recently used one.
+void infer_cache_insert(InferCache* cache, uint64_t version, const Matrix* input, uint64_t hash, const Matrix* output) {
+  InferCacheShard* shard = infer_cache_shard(cache, hash);
+  std::lock_guard<std::mutex> guard(shard->lock);
+
+  InferCacheEntry* e = infer_cache_find(shard, hash, input);
+  if (e) {
+    // a concurrent miss may have stored a result of newer weights already
+    if ((int64_t)(version - e->version) < 0) return;
+    infer_cache_lru_unlink(shard, e);
+  } else {
+    if (shard->used < shard->capacity) {
+      e = &shard->entries[shard->used++];
+    } else {
+      e = shard->tail;
+      infer_cache_lru_unlink(shard, e);
+      infer_cache_chain_remove(shard, e);
+      shard->evictions++;
+    }
+    e->hash = hash;
+    InferCacheEntry** bucket = infer_cache_bucket(shard, hash);
+    e->chain = *bucket;
+    *bucket = e;
+    for (size_t i = 0; i < cache->input_size; i++) e->input[i] = input->data[i * input->stride];
+  }
+
+  e->version = version;
+  for (size_t i = 0; i < cache->output_size; i++) e->output[i] = output->data[i * output->stride];
+  infer_cache_lru_push_front(shard, e);
+}
+
+// Forward for one (input_size x 1) sample through the cache. With scratch the
+// miss path runs mlp_forward_batch, which only reads the MLP and is safe from
+// many threads (one scratch each); without it, mlp_forward, which is not.
+// 1 if served from the cache, 0 if computed, -1 on error.
+int mlp_forward_cached(InferCache* cache, MLP* mlp, Matrix* input, Matrix* output, MLPBatchScratch* scratch) {
+  if (!cache || !mlp || !mat_is_valid(input) || !mat_is_valid(output)) return -1;
+  if (input->rows != cache->input_size || input->cols != 1) return -1;
+  if (output->rows != cache->output_size || output->cols != 1) return -1;
+
+  // read before computing: if the weights change mid-pass the result is
+  // stored under the old version and no later lookup accepts it
+  uint64_t version = mlp_version(mlp);
+  uint64_t hash = infer_cache_hash(input);
+  if (infer_cache_lookup(cache, version, input, hash, output)) return 1;
+
+  int rc = scratch ? mlp_forward_batch(mlp, input, output, scratch) : mlp_forward(mlp, input, output);
+  if (rc != 0) return -1;
+  infer_cache_insert(cache, version, input, hash, output);
+  return 0;
+}
+
+InferCacheStats infer_cache_stats(InferCache* cache) {
+  InferCacheStats stats;
+  memset(&stats, 0, sizeof(stats));
+  if (!cache) return stats;
+
+  for (size_t s = 0; s < cache->num_shards; s++) {
+    InferCacheShard* shard = &cache->shards[s];
+    std::lock_guard<std::mutex> guard(shard->lock);
+    stats.hits += shard->hits;
+    stats.misses += shard->misses;
+    stats.evictions += shard->evictions;
+    stats.stale += shard->stale;
+    stats.entries += shard->used;
+    stats.capacity += shard->capacity;
+  }
+  size_t lookups = stats.hits + stats.misses;
+  stats.hit_rate = lookups ? (double)stats.hits / lookups : 0.0;
+  return stats;
+}
+
+// Drops every entry and resets the counters
+void infer_cache_clear(InferCache* cache) {
+  if (!cache) return;
+  for (size_t s = 0; s < cache->num_shards; s++) {
+    InferCacheShard* shard = &cache->shards[s];
+    std::lock_guard<std::mutex> guard(shard->lock);
+    memset(shard->buckets, 0, shard->num_buckets * sizeof(InferCacheEntry*));
+    shard->used = 0;
+    shard->head = shard->tail = NULL;
+    shard->hits = shard->misses = shard->evictions = shard->stale = 0;
+  }
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include "MLP.hpp"
+#include "Snapshot.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// In-process micro-batching inference server.
+//
+// Callers submit single samples from any thread and get a std::future. One
+// scheduler thread collects pending requests until it has max_batch of them
+// or the oldest one has waited max_delay_us, copies them into the columns of
+// one input matrix, runs a single mlp_forward_batch() over the shared MLP and
+// scatters the result columns back. The MLP is only read, never modified, so
+// it must not be trained while the server is running. To serve a model that
+// keeps training, create the server from a SnapshotStore instead: every
+// batch then runs on the snapshot that was current when it started.
+
+typedef struct {
+  const Matrix *input;    // (input_size x 1), must stay valid until the future is ready
+  Matrix *output;         // (output_size x 1), written by the scheduler
+  std::promise<int> done; // 0 on success, -1 on error
+  std::chrono::steady_clock::time_point submitted;
+} InferRequest;
+
+typedef struct {
+  size_t requests;
+  size_t batches;
+  size_t full_batches;    // flushed because max_batch was reached
+  double avg_batch;
+} InferServerStats;
+
+typedef struct {
+  const MLP *mlp;
+  SnapshotStore *store;   // when set, mlp is ignored and each batch pins a snapshot
+  int reader_slot;
+  size_t max_batch;
+  std::chrono::microseconds max_delay;
+
+  std::mutex lock;
+  std::condition_variable wake;
+  std::deque<InferRequest*> queue;
+  bool stopping;
+
+  MLPBatchScratch *scratch;
+  Matrix *batch_in;       // (input_size x max_batch)
+  Matrix *batch_out;      // (output_size x max_batch)
+  std::thread scheduler;
+
+  std::atomic<size_t> requests, batches, full_batches;
+} InferServer;
+
+// True if request fits the server's (input_size x 1) -> (output_size x 1) shape
+static inline bool infer_server_shape_ok(const InferServer* server, const InferRequest* request) {
+  return request->input->rows == server->batch_in->rows && request->input->cols == 1 &&
+         request->output->rows == server->batch_out->rows && request->output->cols == 1;
+}
+
+static void infer_server_run_batch(InferServer* server, InferRequest** batch, size_t count) {
+  size_t in_rows = server->batch_in->rows;
+  size_t out_rows = server->batch_out->rows;
+  int rc = 0;
+
+  // submit already refuses bad shapes, a request failing here only fails itself
+  size_t kept = 0;
+  for (size_t c = 0; c < count; c++) {
+    if (infer_server_shape_ok(server, batch[c])) {
+      batch[kept++] = batch[c];
+    } else {
+      batch[c]->done.set_value(-1);
+      delete batch[c];
+    }
+  }
+  count = kept;
+  if (count == 0) return;
+
+  for (size_t c = 0; c < count; c++) {
+    const Matrix* x = batch[c]->input;
+    for (size_t r = 0; r < in_rows; r++) {
+      server->batch_in->data[r * server->batch_in->stride + c] = x->data[r * x->stride];
+    }
+  }
+
+  Matrix* in_view = mat_view_cols(server->batch_in, 0, count);
+  Matrix* out_view = mat_view_cols(server->batch_out, 0, count);
+  if (rc == 0 && in_view && out_view) {
+    if (server->store) {
+      const ModelSnapshot* snap = snapshot_pin(server->store, server->reader_slot);
+      rc = mlp_forward_batch(snap->mlp, in_view, out_view, server->scratch);
+      snapshot_unpin(server->store, server->reader_slot);
+    } else {
+      rc = mlp_forward_batch(server->mlp, in_view, out_view, server->scratch);
+    }
+  } else {
+    rc = -1;
+  }
+  mat_free(in_view);
+  mat_free(out_view);
+
+  for (size_t c = 0; c < count; c++) {
+    Matrix* y = batch[c]->output;
+    if (rc == 0) {
+      for (size_t r = 0; r < out_rows; r++) {
+        y->data[r * y->stride] = server->batch_out->data[r * server->batch_out->stride + c];
+      }
+    }
+    batch[c]->done.set_value(rc);
+    delete batch[c];
+  }
+}
+
+static void infer_server_loop(InferServer* server) {
+  InferRequest** batch = (InferRequest**)malloc(sizeof(InferRequest*) * server->max_batch);
+  if (!batch) {
+    // cannot batch anything: refuse new requests and fail the ones already queued
+    std::lock_guard<std::mutex> guard(server->lock);
+    server->stopping = true;
+    while (!server->queue.empty()) {
+      server->queue.front()->done.set_value(-1);
+      delete server->queue.front();
+      server->queue.pop_front();
+    }
+    return;
+  }
+
+  for (;;) {
+    size_t count = 0;
+    {
+      std::unique_lock<std::mutex> guard(server->lock);
+      server->wake.wait(guard, [server] { return server->stopping || !server->queue.empty(); });
+      if (server->queue.empty()) break;  // stopping and drained
+
+      // hold the batch open until it is full or the oldest request hits its deadline
+      std::chrono::steady_clock::time_point deadline = server->queue.front()->submitted + server->max_delay;
+      server->wake.wait_until(guard, deadline, [server] {
+        return server->stopping || server->queue.size() >= server->max_batch;
+      });
+
+      while (count < server->max_batch && !server->queue.empty()) {
+        batch[count++] = server->queue.front();
+        server->queue.pop_front();
+      }
+    }
+
+    if (count == server->max_batch) server->full_batches++;
+    server->requests += count;
+    server->batches++;
+    infer_server_run_batch(server, batch, count);
+  }
+
+  free(batch);
+}
+
+static InferServer* infer_server_start(const MLP* mlp, SnapshotStore* store, size_t max_batch, unsigned max_delay_us) {
+  InferServer* server = new InferServer();
+  server->mlp = store ? NULL : mlp;  // a snapshot may be recycled, only the store is safe to keep
+  server->store = store;
+  server->reader_slot = -1;
+  server->max_batch = max_batch;
+  server->max_delay = std::chrono::microseconds(max_delay_us);
+  server->stopping = false;
+  server->requests = server->batches = server->full_batches = 0;
+
+  if (store) {
+    server->reader_slot = snapshot_reader_register(store);
+    if (server->reader_slot < 0) {
+      delete server;
+      return NULL;
+    }
+  }
+
+  server->scratch = mlp_batch_scratch_create(mlp, max_batch);
+  server->batch_in = mat_create(mlp->layers[0].weights->cols, max_batch);
+  server->batch_out = mat_create(mlp->layers[mlp->num_layers - 1].weights->rows, max_batch);
+  if (!server->scratch || !server->batch_in || !server->batch_out) {
+    mlp_batch_scratch_free(server->scratch);
+    mat_free(server->batch_in);
+    mat_free(server->batch_out);
+    snapshot_reader_unregister(store, server->reader_slot);
+    delete server;
+    return NULL;
+  }
+
+  server->scheduler = std::thread(infer_server_loop, server);
+  return server;
+}
+
+InferServer* infer_server_create(const MLP* mlp, size_t max_batch, unsigned max_delay_us) {
+  if (!mlp || max_batch == 0) return NULL;
+  return infer_server_start(mlp, NULL, max_batch, max_delay_us);
+}
+
+// Serves whatever snapshot is current, the store must outlive the server
+InferServer* infer_server_create_live(SnapshotStore* store, size_t max_batch, unsigned max_delay_us) {
+  if (!store || max_batch == 0) return NULL;
+  // every snapshot has the initial topology, so size the buffers from the current one
+  return infer_server_start(store->current.load()->mlp, store, max_batch, max_delay_us);
+}
+
+// Queue one sample. input and output must stay valid until the future is ready.
+std::future<int> infer_server_submit(InferServer* server, const Matrix* input, Matrix* output) {
+  InferRequest* request = new InferRequest();
+  request->input = input;
+  request->output = output;
+  request->submitted = std::chrono::steady_clock::now();
+  std::future<int> result = request->done.get_future();
+
+  // a bad shape fails only this request, it never reaches a batch
+  if (!server || !mat_is_valid(input) || !mat_is_valid(output) || !infer_server_shape_ok(server, request)) {
+    request->done.set_value(-1);
+    delete request;
+    return result;
+  }
+
+  bool notify;
+  {
+    std::lock_guard<std::mutex> guard(server->lock);
+    if (server->stopping) {
+      notify = false;
+      request->done.set_value(-1);
+      delete request;
+    } else {
+      server->queue.push_back(request);
+      // wake the scheduler for the first request and when a batch fills up
+      notify = server->queue.size() == 1 || server->queue.size() >= server->max_batch;
+    }
+  }
+  if (notify) server->wake.notify_one();
+
+  return result;
+}
+
+// Blocking convenience wrapper
+int infer_server_forward(InferServer* server, const Matrix* input, Matrix* output) {
+  return infer_server_submit(server, input, output).get();
+}
+
+// Stops after serving everything already queued
+void infer_server_destroy(InferServer* server) {
+  if (!server) return;
+
+  {
+    std::lock_guard<std::mutex> guard(server->lock);
+    server->stopping = true;
+  }
+  server->wake.notify_one();
+  server->scheduler.join();
+
+  mlp_batch_scratch_free(server->scratch);
+  mat_free(server->batch_in);
+  mat_free(server->batch_out);
+  snapshot_reader_unregister(server->store, server->reader_slot);
+  delete server;
+}
+
+InferServerStats infer_server_stats(const InferServer* server) {
+  InferServerStats stats = {0, 0, 0, 0.0};
+  if (!server) return stats;
+
+  stats.requests = server->requests;
+  stats.batches = server->batches;
+  stats.full_batches = server->full_batches;
+  stats.avg_batch = stats.batches ? (double)stats.requests / stats.batches : 0.0;
+  return stats;
+}
@@ -0,0 +1,569 @@
+#pragma once
+
+#include "MLP.hpp"
+#include <math.h>
+
+// Low-rank factorized layers for cheaper inference.
+//
+// lowrank_factorize() computes a rank-r truncated SVD of a weight matrix with
+// the randomized range finder of Halko, Martinsson and Tropp: sketch
+// Y = W Omega with a Gaussian Omega of r + LOWRANK_OVERSAMPLE columns, sharpen
+// it with a few power iterations Y = W (W^T Y), orthonormalize it into Q, and
+// take the exact SVD of the small B = Q^T W through the eigendecomposition of
+// B B^T (cyclic Jacobi). The result is W ~ U V with U = Q E_r (out x r) and
+// V = E_r^T B (r x in), where E_r holds the top r eigenvectors.
+//
+// mlp_lowrank_compress() factorizes the layers it is asked to whenever
+// r (out + in) < out * in, so the two products U (V x) cost fewer FLOPs than
+// W x, and copies the rest unchanged. The compressed network can be fine-tuned
+// with lowrank_finetune(), which trains U and V directly.
+
+#define LOWRANK_OVERSAMPLE 8
+#define LOWRANK_JACOBI_SWEEPS 50
+
+typedef struct {
+  Matrix *weights;          // dense (out x in), NULL when factorized
+  Matrix *U;                // (out x rank)
+  Matrix *V;                // (rank x in)
+  Matrix *bias;
+  size_t rank;              // 0 when dense
+  ActivationType activation;
+  Matrix *grad_w, *grad_u, *grad_v, *grad_b;  // fine-tuning, created on first use
+} LowRankLayer;
+
+typedef struct {
+  LowRankLayer *layers;
+  size_t num_layers;
+  float learning_rate;
+} LowRankMLP;
+
+typedef struct {
+  Matrix *bufs[2];          // (max_width x max_batch)
+  Matrix *mid;              // (max_rank x max_batch), V x of a factorized layer
+  size_t max_batch;
+} LowRankScratch;
+
+// Orthonormalizes the columns of Y in place (modified Gram-Schmidt, each
+// column projected twice for stability). Columns that vanish are zeroed.
+// Works on a transposed copy so every column is contiguous. -1 on OOM.
+static int lowrank_orthonormalize(Matrix* Y) {
+  size_t m = Y->rows, k = Y->cols;
+  float* cols = (float*)malloc(sizeof(float) * m * k);
+  if (!cols) return -1;
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < k; j++) cols[j * m + i] = Y->data[i * Y->stride + j];
+  }
+
+  for (size_t j = 0; j < k; j++) {
+    float* y = cols + j * m;
+    for (int pass = 0; pass < 2; pass++) {
+      for (size_t p = 0; p < j; p++) {
+        const float* q = cols + p * m;
+        double dot = 0.0;
+        for (size_t i = 0; i < m; i++) dot += (double)q[i] * y[i];
+        for (size_t i = 0; i < m; i++) y[i] -= (float)dot * q[i];
+      }
+    }
+    double norm = 0.0;
+    for (size_t i = 0; i < m; i++) norm += (double)y[i] * y[i];
+    float scale = norm > 1e-20 ? (float)(1.0 / sqrt(norm)) : 0.0f;
+    for (size_t i = 0; i < m; i++) y[i] *= scale;
+  }
+
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < k; j++) Y->data[i * Y->stride + j] = cols[j * m + i];
+  }
+  free(cols);
+  return 0;
+}
+
+// Eigendecomposition of the symmetric k x k matrix A (row-major, destroyed)
+// by cyclic Jacobi rotations. Eigenvalues go to evals in descending order,
+// the matching eigenvectors to the columns of evecs (k x k, row-major).
+static void lowrank_jacobi_eigen(double* A, size_t k, double* evals, double* evecs) {
+  for (size_t i = 0; i < k * k; i++) evecs[i] = 0.0;
+  for (size_t i = 0; i < k; i++) evecs[i * k + i] = 1.0;
+
+  for (int sweep = 0; sweep < LOWRANK_JACOBI_SWEEPS; sweep++) {
+    double off = 0.0, diag = 0.0;
+    for (size_t p = 0; p < k; p++) {
+      diag += A[p * k + p] * A[p * k + p];
+      for (size_t q = p + 1; q < k; q++) off += A[p * k + q] * A[p * k + q];
+    }
+    if (off <= 1e-24 * diag) break;
+
+    for (size_t p = 0; p < k; p++) {
+      for (size_t q = p + 1; q < k; q++) {
+        double apq = A[p * k + q];
+        if (fabs(apq) < 1e-300) continue;
+
+        double theta = (A[q * k + q] - A[p * k + p]) / (2.0 * apq);
+        double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+        double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+
+        // A = J^T A J, columns then rows
+        for (size_t r = 0; r < k; r++) {
+          double arp = A[r * k + p], arq = A[r * k + q];
+          A[r * k + p] = c * arp - s * arq;
+          A[r * k + q] = s * arp + c * arq;
+        }
+        for (size_t r = 0; r < k; r++) {
+          double apr = A[p * k + r], aqr = A[q * k + r];
+          A[p * k + r] = c * apr - s * aqr;
+          A[q * k + r] = s * apr + c * aqr;
+        }
+        for (size_t r = 0; r < k; r++) {
+          double vrp = evecs[r * k + p], vrq = evecs[r * k + q];
+          evecs[r * k + p] = c * vrp - s * vrq;
+          evecs[r * k + q] = s * vrp + c * vrq;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < k; i++) evals[i] = A[i * k + i];
+
+  // selection sort, k is small
+  for (size_t i = 0; i < k; i++) {
+    size_t best = i;
+    for (size_t j = i + 1; j < k; j++) {
+      if (evals[j] > evals[best]) best = j;
+    }
+    if (best == i) continue;
+    double tmp = evals[i];
+    evals[i] = evals[best];
+    evals[best] = tmp;
+    for (size_t r = 0; r < k; r++) {
+      tmp = evecs[r * k + i];
+      evecs[r * k + i] = evecs[r * k + best];
+      evecs[r * k + best] = tmp;
+    }
+  }
+}
+
+// Rank-`rank` truncated SVD W ~ U V (U out x rank, V rank x in). U has
+// orthonormal columns, V carries the singular values. If singular_values is
+// not NULL it receives the top `rank` of them. 0 on success, -1 on error.
+int lowrank_factorize(const Matrix* W, size_t rank, size_t power_iters, uint64_t seed,
+                      Matrix** U, Matrix** V, float* singular_values) {
+  if (!mat_is_valid(W) || !U || !V) return -1;
+
+  size_t m = W->rows, n = W->cols;
+  size_t limit = m < n ? m : n;
+  if (rank == 0 || rank > limit) return -1;
+  size_t k = rank + LOWRANK_OVERSAMPLE < limit ? rank + LOWRANK_OVERSAMPLE : limit;
+
+  Matrix* omega = mat_create(n, k);
+  Matrix* Y = mat_create(m, k);
+  Matrix* Z = mat_create(n, k);
+  Matrix* B = mat_create(k, n);
+  Matrix* G = mat_create(k, k);
+  Matrix* E = mat_create(k, rank);
+  double* a = (double*)malloc(sizeof(double) * k * k * 2 + sizeof(double) * k);
+  int rc = -1;
+  *U = *V = NULL;
+  if (!omega || !Y || !Z || !B || !G || !E || !a) goto done;
+
+  {
+    RngStream stream = rng_stream(seed, 0);
+    for (size_t r = 0; r < n; r++) {
+      rng_fill_normal(stream, r * k, omega->data + r * omega->stride, k, 0.0f, 1.0f);
+    }
+
+    // range finder with power iterations, re-orthonormalized at every step
+    if (mat_mul(W, omega, Y) != 0 || lowrank_orthonormalize(Y) != 0) goto done;
+    for (size_t q = 0; q < power_iters; q++) {
+      if (mat_mul_tn(W, Y, Z, 0) != 0 || lowrank_orthonormalize(Z) != 0) goto done;
+      if (mat_mul(W, Z, Y) != 0 || lowrank_orthonormalize(Y) != 0) goto done;
+    }
+
+    // B = Q^T W, then the left singular vectors of B from B B^T
+    if (mat_mul_tn(Y, W, B, 0) != 0) goto done;
+    if (mat_mul_nt(B, B, G, 0) != 0) goto done;
+
+    double* evecs = a + k * k;
+    double* evals = a + 2 * k * k;
+    for (size_t i = 0; i < k; i++) {
+      for (size_t j = 0; j < k; j++) a[i * k + j] = mat_get(G, i, j);
+    }
+    lowrank_jacobi_eigen(a, k, evals, evecs);
+
+    for (size_t i = 0; i < k; i++) {
+      for (size_t j = 0; j < rank; j++) mat_set_unsafe(E, i, j, (float)evecs[i * k + j]);
+    }
+    if (singular_values) {
+      for (size_t j = 0; j < rank; j++) singular_values[j] = evals[j] > 0.0 ? (float)sqrt(evals[j]) : 0.0f;
+    }
+
+    *U = mat_create(m, rank);
+    *V = mat_create(rank, n);
+    if (!*U || !*V) goto done;
+    if (mat_mul(Y, E, *U) != 0) goto done;
+    if (mat_mul_tn(E, B, *V, 0) != 0) goto done;
+    rc = 0;
+  }
+
+done:
+  if (rc != 0) {
+    mat_free(*U);
+    mat_free(*V);
+    *U = *V = NULL;
+  }
+  mat_free(omega);
+  mat_free(Y);
+  mat_free(Z);
+  mat_free(B);
+  mat_free(G);
+  mat_free(E);
+  free(a);
+  return rc;
+}
+
+// True if a rank-r factorization of an (out x in) matrix costs fewer FLOPs
+static inline int lowrank_pays_off(size_t out, size_t in, size_t rank) {
+  return rank > 0 && rank * (out + in) < out * in;
+}
+
+void lowrank_free(LowRankMLP* net) {
+  if (!net) return;
+
+  if (net->layers) {
+    for (size_t l = 0; l < net->num_layers; l++) {
+      LowRankLayer* layer = &net->layers[l];
+      mat_free(layer->weights);
+      mat_free(layer->U);
+      mat_free(layer->V);
+      mat_free(layer->bias);
+      mat_free(layer->grad_w);
+      mat_free(layer->grad_u);
+      mat_free(layer->grad_v);
+      mat_free(layer->grad_b);
+    }
+    free(net->layers);
+  }
+  free(net);
+}
+
+// Compressed copy of mlp. ranks[l] is the target rank of layer l, 0 keeps it
+// dense; layers whose factorization would not cut FLOPs are kept dense too.
+// power_iters of 1 or 2 is plenty for weights with a decaying spectrum.
+LowRankMLP* mlp_lowrank_compress(const MLP* mlp, const size_t* ranks, size_t power_iters) {
+  if (!mlp || !ranks) return NULL;
+
+  LowRankMLP* net = (LowRankMLP*)calloc(1, sizeof(LowRankMLP));
+  CHECK_NULL(net);
+  net->layers = (LowRankLayer*)calloc(mlp->num_layers, sizeof(LowRankLayer));
+  if (!net->layers) {
+    free(net);
+    return NULL;
+  }
+  net->num_layers = mlp->num_layers;
+  net->learning_rate = mlp->learning_rate;
+
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    const Layer* src = &mlp->layers[l];
+    LowRankLayer* layer = &net->layers[l];
+    size_t out = src->weights->rows, in = src->weights->cols;
+
+    layer->activation = mlp->activations[l];
+    layer->bias = mat_copy(src->bias);
+    if (!layer->bias) {
+      lowrank_free(net);
+      return NULL;
+    }
+
+    if (lowrank_pays_off(out, in, ranks[l]) &&
+        lowrank_factorize(src->weights, ranks[l], power_iters, mlp->seed + l, &layer->U, &layer->V, NULL) == 0) {
+      layer->rank = ranks[l];
+      continue;
+    }
+    layer->weights = mat_copy(src->weights);
+    if (!layer->weights) {
+      lowrank_free(net);
+      return NULL;
+    }
+  }
+  return net;
+}
+
+static inline size_t lowrank_out(const LowRankLayer* layer) {
+  return layer->rank ? layer->U->rows : layer->weights->rows;
+}
+
+static inline size_t lowrank_in(const LowRankLayer* layer) {
+  return layer->rank ? layer->V->cols : layer->weights->cols;
+}
+
+// Parameters stored (U and V for factorized layers, W otherwise, biases)
+size_t lowrank_param_count(const LowRankMLP* net) {
+  if (!net) return 0;
+
+  size_t count = 0;
+  for (size_t l = 0; l < net->num_layers; l++) {
+    const LowRankLayer* layer = &net->layers[l];
+    count += mat_size(layer->bias);
+    count += layer->rank ? mat_size(layer->U) + mat_size(layer->V) : mat_size(layer->weights);
+  }
+  return count;
+}
+
+LowRankScratch* lowrank_scratch_create(const LowRankMLP* net, size_t max_batch) {
+  if (!net || max_batch == 0) return NULL;
+
+  size_t width = 1, rank = 1;
+  for (size_t l = 0; l < net->num_layers; l++) {
+    if (lowrank_out(&net->layers[l]) > width) width = lowrank_out(&net->layers[l]);
+    if (net->layers[l].rank > rank) rank = net->layers[l].rank;
+  }
+
+  LowRankScratch* scratch = (LowRankScratch*)malloc(sizeof(LowRankScratch));
+  CHECK_NULL(scratch);
+  scratch->max_batch = max_batch;
+  scratch->bufs[0] = mat_create(width, max_batch);
+  scratch->bufs[1] = mat_create(width, max_batch);
+  scratch->mid = mat_create(rank, max_batch);
+  if (!scratch->bufs[0] || !scratch->bufs[1] || !scratch->mid) {
+    mat_free(scratch->bufs[0]);
+    mat_free(scratch->bufs[1]);
+    mat_free(scratch->mid);
+    free(scratch);
+    return NULL;
+  }
+  return scratch;
+}
+
+void lowrank_scratch_free(LowRankScratch* scratch) {
+  if (!scratch) return;
+  mat_free(scratch->bufs[0]);
+  mat_free(scratch->bufs[1]);
+  mat_free(scratch->mid);
+  free(scratch);
+}
+
+static void lowrank_bias_activate(const Matrix* bias, ActivationType activation_type, Matrix* out) {
+  float (*activation_func)(float);
+  float (*derivative_func)(float);
+  get_activation_function(activation_type, &activation_func, &derivative_func);
+
+  for (size_t i = 0; i < out->rows; i++) {
+    float b = bias->data[i * bias->stride];
+    float* row = out->data + i * out->stride;
+    for (size_t j = 0; j < out->cols; j++) {
+      row[j] = activation_func(row[j] + b);
+    }
+  }
+}
+
+// out = act(U (V in) + b) or act(W in + b); mid receives V in
+static int lowrank_layer_forward(const LowRankLayer* layer, const Matrix* in, Matrix* mid, Matrix* out) {
+  if (layer->rank) {
+    if (mat_mul(layer->V, in, mid) != 0) return -1;
+    if (mat_mul(layer->U, mid, out) != 0) return -1;
+  } else if (mat_mul(layer->weights, in, out) != 0) {
+    return -1;
+  }
+  lowrank_bias_activate(layer->bias, layer->activation, out);
+  return 0;
+}
+
+// Forward for the columns of X into Y, like mlp_forward_batch. Only reads
+// the network, concurrent calls are safe with separate scratch.
+int lowrank_forward_batch(const LowRankMLP* net, const Matrix* X, Matrix* Y, LowRankScratch* scratch) {
+  if (!net || !mat_is_valid(X) || !mat_is_valid(Y) || !scratch) return -1;
+
+  size_t batch = X->cols, L = net->num_layers;
+  if (batch > scratch->max_batch || Y->cols != batch) return -1;
+  if (X->rows != lowrank_in(&net->layers[0]) || Y->rows != lowrank_out(&net->layers[L - 1])) return -1;
+
+  const Matrix* in = X;
+  Matrix* views[2] = {NULL, NULL};
+  Matrix* mid = NULL;
+  int rc = 0;
+
+  for (size_t l = 0; l < L && rc == 0; l++) {
+    const LowRankLayer* layer = &net->layers[l];
+    Matrix* out = Y;
+    if (l + 1 < L) {
+      mat_free(views[l & 1]);
+      views[l & 1] = mat_view(scratch->bufs[l & 1], 0, 0, lowrank_out(layer), batch);
+      out = views[l & 1];
+    }
+    mat_free(mid);
+    mid = layer->rank ? mat_view(scratch->mid, 0, 0, layer->rank, batch) : NULL;
+    if (!out || (layer->rank && !mid)) {
+      rc = -1;
+      break;
+    }
+    rc = lowrank_layer_forward(layer, in, mid, out);
+    in = out;
+  }
+
+  mat_free(mid);
+  mat_free(views[0]);
+  mat_free(views[1]);
+  return rc;
+}
+
+static int lowrank_create_grads(LowRankMLP* net) {
+  for (size_t l = 0; l < net->num_layers; l++) {
+    LowRankLayer* layer = &net->layers[l];
+    if (layer->grad_b) continue;
+    layer->grad_b = mat_create_with_value(layer->bias->rows, 1, 0.0f);
+    if (layer->rank) {
+      layer->grad_u = mat_create_with_value(layer->U->rows, layer->U->cols, 0.0f);
+      layer->grad_v = mat_create_with_value(layer->V->rows, layer->V->cols, 0.0f);
+      if (!layer->grad_u || !layer->grad_v) return -1;
+    } else {
+      layer->grad_w = mat_create_with_value(layer->weights->rows, layer->weights->cols, 0.0f);
+      if (!layer->grad_w) return -1;
+    }
+    if (!layer->grad_b) return -1;
+  }
+  return 0;
+}
+
+// Backward of one layer on a batch, gradients accumulated. g holds the
+// gradient w.r.t. the activated output and is overwritten. in_grad may be NULL.
+static int lowrank_layer_backward(LowRankLayer* layer, const Matrix* in, const Matrix* mid, const Matrix* out,
+                                  Matrix* g, Matrix* mid_grad, Matrix* in_grad) {
+  float (*activation_func)(float);
+  float (*activation_deriv)(float);
+  get_activation_function(layer->activation, &activation_func, &activation_deriv);
+
+  if (mat_assign(g, mx(g) * mx_map(activation_deriv, mx(out))) != 0) return -1;
+
+  for (size_t i = 0; i < g->rows; i++) {
+    const float* row = g->data + i * g->stride;
+    float sum = 0.0f;
+    for (size_t j = 0; j < g->cols; j++) sum += row[j];
+    layer->grad_b->data[i * layer->grad_b->stride] += sum;
+  }
+
+  if (!layer->rank) {
+    if (mat_mul_nt(g, in, layer->grad_w, 1) != 0) return -1;
+    return in_grad ? mat_mul_tn(layer->weights, g, in_grad, 0) : 0;
+  }
+
+  // z = U m, m = V x: dU = g m^T, dm = U^T g, dV = dm x^T, dx = V^T dm
+  if (mat_mul_nt(g, mid, layer->grad_u, 1) != 0) return -1;
+  if (mat_mul_tn(layer->U, g, mid_grad, 0) != 0) return -1;
+  if (mat_mul_nt(mid_grad, in, layer->grad_v, 1) != 0) return -1;
+  return in_grad ? mat_mul_tn(layer->V, mid_grad, in_grad, 0) : 0;
+}
+
+static void lowrank_apply_grads(LowRankMLP* net, float rate) {
+  for (size_t l = 0; l < net->num_layers; l++) {
+    LowRankLayer* layer = &net->layers[l];
+    if (layer->rank) {
+      mat_assign(layer->U, mx(layer->U) - mx(layer->grad_u) * rate);
+      mat_assign(layer->V, mx(layer->V) - mx(layer->grad_v) * rate);
+      mat_zero(layer->grad_u);
+      mat_zero(layer->grad_v);
+    } else {
+      mat_assign(layer->weights, mx(layer->weights) - mx(layer->grad_w) * rate);
+      mat_zero(layer->grad_w);
+    }
+    mat_assign(layer->bias, mx(layer->bias) - mx(layer->grad_b) * rate);
+    mat_zero(layer->grad_b);
+  }
+}
+
+// Mini-batch SGD on the compressed network (U and V trained directly, at
+// net->learning_rate), typically a few epochs on the original training data
+// or on the dense model's outputs. Returns the last epoch's mean loss, -1 on error.
+float lowrank_finetune(LowRankMLP* net, Matrix** inputs, Matrix** targets, size_t num_samples,
+                       size_t epochs, size_t batch_size, LossFunction loss_func) {
+  if (!net || !inputs || !targets || num_samples == 0 || batch_size == 0) return -1.0f;
+  if (lowrank_create_grads(net) != 0) return -1.0f;
+  if (batch_size > num_samples) batch_size = num_samples;
+
+  size_t L = net->num_layers, max_rank = 1;
+  for (size_t l = 0; l < L; l++) {
+    if (net->layers[l].rank > max_rank) max_rank = net->layers[l].rank;
+  }
+
+  // acts[0] input, acts[l + 1] output of layer l; mids[l] the V x of layer l
+  Matrix** acts = (Matrix**)calloc(L + 1, sizeof(Matrix*));
+  Matrix** mids = (Matrix**)calloc(L, sizeof(Matrix*));
+  Matrix* T = mat_create(lowrank_out(&net->layers[L - 1]), batch_size);
+  Matrix* grads[2] = {NULL, NULL};
+  Matrix* mid_grad = mat_create(max_rank, batch_size);
+  Matrix** a = (Matrix**)calloc(2 * L + 1, sizeof(Matrix*));   // per-batch views of acts, then mids
+  Matrix** m = a ? a + L + 1 : NULL;
+  size_t widest = lowrank_in(&net->layers[0]);
+  float avg_loss = -1.0f;
+  int failed = !acts || !mids || !T || !mid_grad || !a;
+
+  for (size_t l = 0; l <= L && !failed; l++) {
+    size_t width = l == 0 ? lowrank_in(&net->layers[0]) : lowrank_out(&net->layers[l - 1]);
+    if (width > widest) widest = width;
+    acts[l] = mat_create(width, batch_size);
+    if (l < L && net->layers[l].rank) mids[l] = mat_create(net->layers[l].rank, batch_size);
+    if (!acts[l] || (l < L && net->layers[l].rank && !mids[l])) failed = 1;
+  }
+  if (!failed) {
+    grads[0] = mat_create(widest, batch_size);
+    grads[1] = mat_create(widest, batch_size);
+    failed = !grads[0] || !grads[1];
+  }
+
+  for (size_t epoch = 0; epoch < epochs && !failed; epoch++) {
+    float epoch_loss = 0.0f;
+
+    for (size_t first = 0; first < num_samples && !failed; first += batch_size) {
+      size_t count = num_samples - first < batch_size ? num_samples - first : batch_size;
+
+      // views of the first `count` columns: acts, mids, target, ping-pong grads
+      for (size_t l = 0; l <= L; l++) a[l] = mat_view(acts[l], 0, 0, acts[l]->rows, count);
+      for (size_t l = 0; l < L; l++) m[l] = mids[l] ? mat_view(mids[l], 0, 0, mids[l]->rows, count) : NULL;
+      Matrix* t = mat_view(T, 0, 0, T->rows, count);
+
+      mlp_gather_columns(inputs, first, count, a[0]);
+      mlp_gather_columns(targets, first, count, t);
+      for (size_t l = 0; l < L && !failed; l++) {
+        failed = lowrank_layer_forward(&net->layers[l], a[l], m[l], a[l + 1]) != 0;
+      }
+
+      Matrix* g = mat_view(grads[0], 0, 0, a[L]->rows, count);
+      if (!failed) {
+        epoch_loss += compute_loss(loss_func, a[L], t) * count;
+        failed = compute_loss_derivative(loss_func, a[L], t, g) != 0;
+      }
+      for (size_t l = L; l-- > 0 && !failed;) {
+        LowRankLayer* layer = &net->layers[l];
+        Matrix* in_grad = l > 0 ? mat_view(g->data == grads[0]->data ? grads[1] : grads[0], 0, 0, a[l]->rows, count) : NULL;
+        Matrix* mg = layer->rank ? mat_view(mid_grad, 0, 0, layer->rank, count) : NULL;
+        failed = lowrank_layer_backward(layer, a[l], m[l], a[l + 1], g, mg, in_grad) != 0;
+        mat_free(mg);
+        mat_free(g);
+        g = in_grad;
+      }
+      mat_free(g);
+      if (!failed) lowrank_apply_grads(net, net->learning_rate / count);
+
+      for (size_t l = 0; l <= L; l++) mat_free(a[l]);
+      for (size_t l = 0; l < L; l++) mat_free(m[l]);
+      mat_free(t);
+    }
+
+    if (failed) break;
+    avg_loss = epoch_loss / num_samples;
+    if (epoch % 10 == 0 || epoch == epochs - 1)
+      printf("Epoch %zu/%zu = Loss: %.4f\n", epoch + 1, epochs, avg_loss);
+  }
+
+  if (acts) {
+    for (size_t l = 0; l <= L; l++) mat_free(acts[l]);
+    free(acts);
+  }
+  if (mids) {
+    for (size_t l = 0; l < L; l++) mat_free(mids[l]);
+    free(mids);
+  }
+  mat_free(T);
+  mat_free(grads[0]);
+  mat_free(grads[1]);
+  mat_free(mid_grad);
+  free(a);
+  return failed ? -1.0f : avg_loss;
+}
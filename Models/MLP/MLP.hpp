@@ -4,6 +4,9 @@
 #include "../../Utils/Activation.hpp"
 #include "../../Utils/Loss.hpp"
 #include "../../Utils/Utils.hpp"
+#include "../../Utils/Packed.hpp"
+#include "../../Utils/Random.hpp"
+#include <atomic>
 #include <cstddef>
 #include <cstdlib>
 
@@ -17,8 +20,49 @@ typedef struct {
   Matrix *weight_grad;
   Matrix *bias_grad;
   Matrix *output_grad;
+  PackedMatrix *saved_input;   // compact copies kept for backward (ACT_STORE_FP16/BF16 only), saved_input
+  PackedMatrix *saved_output;  // on layer 0 only: the others read the previous layer's saved_output
 } Layer;
 
+// How mlp_train keeps the activations that layer_backward needs.
+typedef enum {
+  ACT_STORE_FULL,   // fp32: backward reads Layer::output, Layer::input views the previous one
+  ACT_STORE_FP16,   // one fp16 copy per activation, a final ReLU output as a bitmask
+  ACT_STORE_BF16,   // same with bf16
+} ActivationStorage;
+
+// A hidden output is also the next layer's input, which the weight gradient
+// needs in full. Only the last layer's output is read through the activation
+// derivative alone, so a final ReLU can keep just its sign bit.
+static inline PackFormat act_storage_format(ActivationStorage storage, ActivationType activation, int is_last) {
+  if (is_last && activation == ACTIVATION_RELU) return PACK_MASK;
+  return storage == ACT_STORE_BF16 ? PACK_BF16 : PACK_FP16;
+}
+
+// packed_input is the layer's input in compact form, NULL for ACT_STORE_FULL
+static inline float layer_saved_input(const Layer* layer, const PackedMatrix* packed_input, size_t row) {
+  return packed_input ? packed_get(packed_input, row, 0) : mat_get(layer->input, row, 0);
+}
+
+// threads used to fill weights at construction, 0 = all cores
+static size_t mlp_init_threads = 0;
+
+// He-uniform fill from the Philox stream (seed, stream). Element (r, c) is
+// number r * cols + c of the stream whatever the thread split or padding,
+// so a seed always gives the same weights.
+static void init_weights_uniform(Matrix* weights, uint64_t seed, uint64_t stream, float scale) {
+  RngStream s = rng_stream(seed, stream);
+  size_t cols = weights->cols;
+  rng_parallel_for(weights->rows * cols, mlp_init_threads, [=](size_t begin, size_t end) {
+    while (begin < end) {
+      size_t row = begin / cols, col = begin % cols;
+      size_t len = cols - col < end - begin ? cols - col : end - begin;
+      rng_fill_uniform(s, begin, weights->data + row * weights->stride + col, len, -scale, scale);
+      begin += len;
+    }
+  });
+}
+
 Layer* create_layer(size_t input_size, size_t output_size, ActivationType activations) {
   Layer* layer = (Layer*)malloc(sizeof(Layer));
   CHECK_NULL(layer);
@@ -33,12 +77,7 @@ Layer* create_layer(size_t input_size, size_t output_size, ActivationType activa
   // TODO: might change later
   float scale = utility::newton_sqrt(2.0f / input_size);
 
-  for (size_t row = 0; row < input_size; row++) {
-    for (size_t col = 0; col < output_size; col++) {
-      float rand_val = ((float)rand() / RAND_MAX) * 2.0f * scale - scale;
-      mat_set_unsafe(layer->weights, row, col, rand_val);
-    }
-  }
+  init_weights_uniform(layer->weights, rng_next_model_seed(), 0, scale);
 
   layer->bias = mat_create_with_value(output_size, 1, 0.0f);
   if (!layer->bias) {
@@ -55,6 +94,9 @@ Layer* create_layer(size_t input_size, size_t output_size, ActivationType activa
     return NULL;
   }
 
+  layer->saved_input = NULL;
+  layer->saved_output = NULL;
+
   return layer;
 }
 
@@ -63,6 +105,8 @@ void layer_free(Layer* layer) {
   if (layer->weights) mat_free(layer->weights);
   if (layer->bias) mat_free(layer->bias);
   if (layer->output) mat_free(layer->output);
+  if (layer->saved_input) packed_free(layer->saved_input);
+  if (layer->saved_output) packed_free(layer->saved_output);
   free(layer);
 }
 
@@ -108,19 +152,22 @@ int layer_forward(Matrix* input, Layer* layer, ActivationType activation_type) {
   return 0;
 }
 
-int layer_backward(Matrix* output_grad, Layer* layer, Matrix* input_grad, ActivationType activation_type) {
+// Backward for one sample. packed_input is the compact copy of the layer's
+// input (ACT_STORE_FP16/BF16), NULL to read Layer::input. -1 if neither exists.
+static int layer_backward_saved(Matrix* output_grad, Layer* layer, const PackedMatrix* packed_input, Matrix* input_grad,
+                                ActivationType activation_type) {
   if (!output_grad || !layer || !input_grad) return -1;
+  if (!packed_input && !layer->input) return -1;
 
   float (*activation_deriv)(float);
   float (*activation_func)(float); // TODO: Either I need to comment this out or refactor this, since it won't be used in backwards realistically
   get_activation_function(activation_type, &activation_func, &activation_deriv);
   
   Matrix* activation_grad = mat_create(output_grad->rows, output_grad->cols);
-  for (size_t i = 0; i < layer->output->rows; i++) {
-    float z = mat_get(layer->output, i, 0);
-    float deriv = activation_deriv(z);
-    float grad = mat_get(output_grad, i, 0) * deriv;
-    mat_set_unsafe(activation_grad, i, 0, grad);
+  if (layer->saved_output) {
+    mat_assign(activation_grad, mx(output_grad) * mx_map(activation_deriv, mx(layer->saved_output)));
+  } else {
+    mat_assign(activation_grad, mx(output_grad) * mx_map(activation_deriv, mx(layer->output)));
   }
 
   // bias grad compute
@@ -131,30 +178,60 @@ int layer_backward(Matrix* output_grad, Layer* layer, Matrix* input_grad, Activa
   // compute input grad for next layer
   for (size_t i = 0; i < layer->weights->rows; i++) {
     for (size_t j = 0; j < layer->weights->cols; j++) {
-      float grad = mat_get(activation_grad, i, 0) * mat_get(layer->input, j, 0);
+      float grad = mat_get(activation_grad, i, 0) * layer_saved_input(layer, packed_input, j);
       mat_set_unsafe(layer->weight_grad, i, j, grad);
     }
   }
 
-  Matrix* weight_transpose = mat_create(layer->weights->cols, layer->weights->rows);
-  mat_transpose(layer->weights, weight_transpose);
-  mat_mul(weight_transpose, activation_grad, input_grad);
+  mat_mul_tn(layer->weights, activation_grad, input_grad, 0);
 
   mat_free(activation_grad);
-  mat_free(weight_transpose);
 
   return 0;
 }
 
+// Only sees the layer itself: fine for ACT_STORE_FULL and for layer 0. In the
+// packed modes a deeper layer's input is the previous layer's saved_output,
+// which it cannot reach, so this returns -1 there; use mlp_layer_backward.
+int layer_backward(Matrix* output_grad, Layer* layer, Matrix* input_grad, ActivationType activation_type) {
+  if (!layer) return -1;
+  return layer_backward_saved(output_grad, layer, layer->saved_input, input_grad, activation_type);
+}
+
 typedef struct {
   Layer* layers;
   size_t num_layers;
   ActivationType* activations;
   float learning_rate;
+  ActivationStorage act_storage;
+  size_t epoch;                                   // training epochs completed (restored on resume)
+  void (*epoch_hook)(void* ctx, size_t epoch, float loss);  // after every mlp_train / pipeline epoch
+  void* epoch_hook_ctx;
+  uint64_t seed;                                  // weights were drawn from it, shuffle streams derive from it
+  int shuffle;                                    // mlp_train visits samples in a new order every epoch
+  uint64_t version;                               // changes whenever the parameters do, see mlp_mark_updated
 } MLP;
 
+#define MLP_SHUFFLE_STREAM ((uint64_t)1 << 32)    // + epoch, clear of the per-layer init streams
 
-MLP* create_mlp(size_t* layer_dims, size_t num_layers, ActivationType* activations, float learning_rate) {
+// Parameter versions come from one process-wide counter, so a version names
+// one set of parameters of one model: two MLPs (or a recycled snapshot
+// buffer) never share a version, and results cached under it stay valid
+// exactly until the next update.
+static std::atomic<uint64_t> mlp_version_counter(0);
+
+static inline uint64_t mlp_version(const MLP* mlp) {
+  return __atomic_load_n(&mlp->version, __ATOMIC_ACQUIRE);
+}
+
+// Call after writing weights or biases directly
+static inline void mlp_mark_updated(MLP* mlp) {
+  __atomic_store_n(&mlp->version, mlp_version_counter.fetch_add(1) + 1, __ATOMIC_RELEASE);
+}
+
+
+// Same seed, same topology -> same weights, on any number of threads
+MLP* create_mlp_seeded(size_t* layer_dims, size_t num_layers, ActivationType* activations, float learning_rate, uint64_t seed) {
   if (!layer_dims || num_layers < 2 || !activations) return NULL;
 
   MLP* mlp = (MLP*)malloc(sizeof(MLP));
@@ -162,6 +239,13 @@ MLP* create_mlp(size_t* layer_dims, size_t num_layers, ActivationType* activatio
   
   mlp->num_layers = num_layers - 1;
   mlp->learning_rate = learning_rate;
+  mlp->act_storage = ACT_STORE_FULL;
+  mlp->epoch = 0;
+  mlp->epoch_hook = NULL;
+  mlp->epoch_hook_ctx = NULL;
+  mlp->seed = seed;
+  mlp->shuffle = 0;
+  mlp_mark_updated(mlp);
   mlp->layers = (Layer*)malloc(sizeof(Layer) * mlp->num_layers);
   if (!mlp->layers) {
     free(mlp);
@@ -186,6 +270,8 @@ MLP* create_mlp(size_t* layer_dims, size_t num_layers, ActivationType* activatio
     mlp->layers[i].weight_grad = NULL;
     mlp->layers[i].bias_grad = NULL; 
     mlp->layers[i].output_grad = NULL; 
+    mlp->layers[i].saved_input = NULL;
+    mlp->layers[i].saved_output = NULL;
     
     if (!mlp->layers[i].weights || !mlp->layers[i].bias || !mlp->layers[i].output) {
       for (size_t j = 0; j <= i; j++) {
@@ -200,12 +286,7 @@ MLP* create_mlp(size_t* layer_dims, size_t num_layers, ActivationType* activatio
     }
     
     float scale = utility::newton_sqrt(2.0f / layer_dims[i]);
-    for (size_t row = 0; row < layer_dims[i+1]; row++) {
-      for (size_t col = 0; col < layer_dims[i]; col++) {
-        float rand_val = ((float)rand() / RAND_MAX) * 2.0f * scale - scale;
-        mat_set_unsafe(mlp->layers[i].weights, row, col, rand_val);
-      }
-    }
+    init_weights_uniform(mlp->layers[i].weights, seed, i, scale);
     
     mlp->activations[i] = activations[i];
   }
@@ -213,6 +294,11 @@ MLP* create_mlp(size_t* layer_dims, size_t num_layers, ActivationType* activatio
   return mlp;
 }
 
+// Seeded from the global seed (rng_set_global_seed), a new seed per call
+MLP* create_mlp(size_t* layer_dims, size_t num_layers, ActivationType* activations, float learning_rate) {
+  return create_mlp_seeded(layer_dims, num_layers, activations, learning_rate, rng_next_model_seed());
+}
+
 void mlp_free(MLP* mlp) {
   if (!mlp) return;
 
@@ -225,6 +311,8 @@ void mlp_free(MLP* mlp) {
     if (mlp->layers[i].weight_grad) mat_free(mlp->layers[i].weight_grad);
     if (mlp->layers[i].bias_grad) mat_free(mlp->layers[i].bias_grad);
     if (mlp->layers[i].output_grad) mat_free(mlp->layers[i].output_grad);
+    if (mlp->layers[i].saved_input) packed_free(mlp->layers[i].saved_input);
+    if (mlp->layers[i].saved_output) packed_free(mlp->layers[i].saved_output);
   }
   
   if (mlp->layers) free(mlp->layers);
@@ -233,6 +321,55 @@ void mlp_free(MLP* mlp) {
   free(mlp);
 }
 
+// Copies weights and biases between two MLPs of the same topology
+int mlp_copy_params(MLP* dst, const MLP* src) {
+  if (!dst || !src || dst->num_layers != src->num_layers) return -1;
+
+  for (size_t i = 0; i < src->num_layers; i++) {
+    if (mat_copy_into(src->layers[i].weights, dst->layers[i].weights) != 0) return -1;
+    if (mat_copy_into(src->layers[i].bias, dst->layers[i].bias) != 0) return -1;
+    dst->activations[i] = src->activations[i];
+  }
+  dst->learning_rate = src->learning_rate;
+  mlp_mark_updated(dst);
+  return 0;
+}
+
+// New MLP with the same topology and parameters, no training state
+MLP* mlp_clone(const MLP* src) {
+  if (!src || src->num_layers == 0) return NULL;
+
+  MLP* mlp = (MLP*)calloc(1, sizeof(MLP));
+  CHECK_NULL(mlp);
+
+  mlp->learning_rate = src->learning_rate;
+  mlp->act_storage = src->act_storage;
+  mlp->epoch = src->epoch;
+  mlp->seed = src->seed;
+  mlp->shuffle = src->shuffle;
+  mlp_mark_updated(mlp);
+  mlp->layers = (Layer*)calloc(src->num_layers, sizeof(Layer));
+  mlp->activations = (ActivationType*)malloc(sizeof(ActivationType) * src->num_layers);
+  if (!mlp->layers || !mlp->activations) {
+    mlp_free(mlp);
+    return NULL;
+  }
+  mlp->num_layers = src->num_layers;
+
+  for (size_t i = 0; i < src->num_layers; i++) {
+    Layer* layer = &mlp->layers[i];
+    layer->weights = mat_copy(src->layers[i].weights);
+    layer->bias = mat_copy(src->layers[i].bias);
+    layer->output = mat_create(src->layers[i].output->rows, 1);
+    mlp->activations[i] = src->activations[i];
+    if (!layer->weights || !layer->bias || !layer->output) {
+      mlp_free(mlp);
+      return NULL;
+    }
+  }
+  return mlp;
+}
+
 int mlp_forward(MLP* mlp, Matrix* input, Matrix* output) {
   if (!mlp || !input || !output) return -1;
   
@@ -262,6 +399,171 @@ int mlp_forward(MLP* mlp, Matrix* input, Matrix* output) {
   return 0;
 }
 
+// ============================================================================
+// BATCHED FORWARD (read-only)
+// ============================================================================
+
+// Ping-pong buffers for mlp_forward_batch, one per concurrent caller.
+typedef struct {
+  Matrix *bufs[2];    // (max_width x max_batch)
+  size_t max_batch;
+  size_t max_width;
+} MLPBatchScratch;
+
+MLPBatchScratch* mlp_batch_scratch_create(const MLP* mlp, size_t max_batch) {
+  if (!mlp || max_batch == 0) return NULL;
+
+  MLPBatchScratch* scratch = (MLPBatchScratch*)malloc(sizeof(MLPBatchScratch));
+  CHECK_NULL(scratch);
+
+  scratch->max_batch = max_batch;
+  scratch->max_width = 0;
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    if (mlp->layers[i].weights->rows > scratch->max_width) scratch->max_width = mlp->layers[i].weights->rows;
+  }
+
+  scratch->bufs[0] = mat_create(scratch->max_width, max_batch);
+  scratch->bufs[1] = mat_create(scratch->max_width, max_batch);
+  if (!scratch->bufs[0] || !scratch->bufs[1]) {
+    mat_free(scratch->bufs[0]);
+    mat_free(scratch->bufs[1]);
+    free(scratch);
+    return NULL;
+  }
+
+  return scratch;
+}
+
+void mlp_batch_scratch_free(MLPBatchScratch* scratch) {
+  if (!scratch) return;
+  mat_free(scratch->bufs[0]);
+  mat_free(scratch->bufs[1]);
+  free(scratch);
+}
+
+// out = act(W in + b) for a batch of column vectors
+int layer_forward_batch(const Layer* layer, ActivationType activation_type, const Matrix* in, Matrix* out) {
+  if (!layer || !in || !out) return -1;
+  if (out->rows != layer->weights->rows || out->cols != in->cols) return -1;
+
+  float (*activation_func)(float);
+  float (*derivative_func)(float);
+  get_activation_function(activation_type, &activation_func, &derivative_func);
+
+  if (mat_mul(layer->weights, in, out) != 0) return -1;
+
+  for (size_t i = 0; i < out->rows; i++) {
+    float b = layer->bias->data[i * layer->bias->stride];
+    float* row = out->data + i * out->stride;
+    for (size_t j = 0; j < out->cols; j++) {
+      row[j] = activation_func(row[j] + b);
+    }
+  }
+  return 0;
+}
+
+// Forward for the columns of X (input_size x B) into Y (output_size x B).
+// Only reads the MLP, so concurrent calls are safe with separate scratch.
+int mlp_forward_batch(const MLP* mlp, const Matrix* X, Matrix* Y, MLPBatchScratch* scratch) {
+  if (!mlp || !mat_is_valid(X) || !mat_is_valid(Y) || !scratch) return -1;
+
+  size_t batch = X->cols;
+  if (batch > scratch->max_batch || Y->cols != batch) return -1;
+  if (X->rows != mlp->layers[0].weights->cols) return -1;
+  if (Y->rows != mlp->layers[mlp->num_layers - 1].weights->rows) return -1;
+
+  const Matrix* in = X;
+  Matrix* views[2] = {NULL, NULL};
+  int rc = 0;
+
+  for (size_t i = 0; i < mlp->num_layers && rc == 0; i++) {
+    Matrix* out = Y;
+    if (i + 1 < mlp->num_layers) {
+      mat_free(views[i & 1]);
+      views[i & 1] = mat_view(scratch->bufs[i & 1], 0, 0, mlp->layers[i].weights->rows, batch);
+      out = views[i & 1];
+      if (!out) {
+        rc = -1;
+        break;
+      }
+    }
+    rc = layer_forward_batch(&mlp->layers[i], mlp->activations[i], in, out);
+    in = out;
+  }
+
+  mat_free(views[0]);
+  mat_free(views[1]);
+  return rc;
+}
+
+// Backward for a batch of columns, gradients are accumulated (summed over the
+// batch) into weight_grad / bias_grad. in / out are the layer's input and
+// activated output from the forward pass. out_grad is overwritten with the
+// pre-activation gradient. in_grad may be NULL for the first layer.
+int layer_backward_batch(const Layer* layer, ActivationType activation_type, const Matrix* in, const Matrix* out,
+                         Matrix* out_grad, Matrix* in_grad, Matrix* weight_grad, Matrix* bias_grad) {
+  if (!layer || !in || !out || !out_grad || !weight_grad || !bias_grad) return -1;
+
+  float (*activation_func)(float);
+  float (*activation_deriv)(float);
+  get_activation_function(activation_type, &activation_func, &activation_deriv);
+
+  if (mat_assign(out_grad, mx(out_grad) * mx_map(activation_deriv, mx(out))) != 0) return -1;
+
+  for (size_t i = 0; i < out_grad->rows; i++) {
+    const float* row = out_grad->data + i * out_grad->stride;
+    float sum = 0.0f;
+    for (size_t j = 0; j < out_grad->cols; j++) {
+      sum += row[j];
+    }
+    bias_grad->data[i * bias_grad->stride] += sum;
+  }
+
+  if (mat_mul_nt(out_grad, in, weight_grad, 1) != 0) return -1;
+  if (in_grad && mat_mul_tn(layer->weights, out_grad, in_grad, 0) != 0) return -1;
+  return 0;
+}
+
+// Gather column vectors samples[first..first+count) into the first count columns of dst
+void mlp_gather_columns(Matrix** samples, size_t first, size_t count, Matrix* dst) {
+  for (size_t c = 0; c < count; c++) {
+    const Matrix* x = samples[first + c];
+    for (size_t r = 0; r < dst->rows; r++) {
+      dst->data[r * dst->stride + c] = x->data[r * x->stride];
+    }
+  }
+}
+
+// Creates the gradient buffers of every layer if needed and clears them
+int mlp_zero_grads(MLP* mlp) {
+  if (!mlp) return -1;
+
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    Layer* layer = &mlp->layers[i];
+    if (!layer->weight_grad) {
+      layer->weight_grad = mat_create(layer->weights->rows, layer->weights->cols);
+      layer->bias_grad = mat_create(layer->bias->rows, 1);
+      layer->output_grad = mat_create(layer->output->rows, 1);
+    }
+    if (!layer->weight_grad || !layer->bias_grad) return -1;
+    mat_zero(layer->weight_grad);
+    mat_zero(layer->bias_grad);
+  }
+  return 0;
+}
+
+// W -= rate * dW, b -= rate * db, then clears the accumulated gradients.
+// The caller marks the owning MLP updated (mlp_mark_updated).
+int layer_apply_grads(Layer* layer, float rate) {
+  if (!layer || !layer->weight_grad || !layer->bias_grad) return -1;
+
+  mat_assign(layer->weights, mx(layer->weights) - mx(layer->weight_grad) * rate);
+  mat_assign(layer->bias, mx(layer->bias) - mx(layer->bias_grad) * rate);
+  mat_zero(layer->weight_grad);
+  mat_zero(layer->bias_grad);
+  return 0;
+}
+
 int mlp_update_weights(MLP* mlp) {
   if (!mlp) return -1;
 
@@ -270,99 +572,208 @@ int mlp_update_weights(MLP* mlp) {
     Layer* layer = &mlp->layers[i];
 
     // get the new weights
-    for (size_t row = 0; row < layer->weights->rows; row++) {
-      for (size_t col = 0; col < layer->weights->cols; col++) {
-        float grad = mat_get(layer->weight_grad, row, col);
-        float curr_weight = mat_get(layer->weights, row, col);
-        float new_weight = curr_weight - mlp->learning_rate * grad;
-        mat_set_unsafe(layer->weights, row, col, new_weight);
-      }
-    }
+    mat_assign(layer->weights, mx(layer->weights) - mx(layer->weight_grad) * mlp->learning_rate);
 
-    
     // get the new biases
-    for (size_t row = 0; row < layer->bias->rows; row++) {
-      float grad = mat_get(layer->bias_grad, row, 0);
-      float curr_bias = mat_get(layer->bias, row, 0);
-      float new_bias = curr_bias - mlp->learning_rate * grad;
-      mat_set_unsafe(layer->bias, row, 0, new_bias);
-    }
+    mat_assign(layer->bias, mx(layer->bias) - mx(layer->bias_grad) * mlp->learning_rate);
   }
+  mlp_mark_updated(mlp);
 
   return 0;
 }
 
-float mlp_train(MLP* mlp, Matrix** inputs, Matrix** targets, size_t num_samples, size_t epochs, LossFunction loss_func, float epsilon) {
-  if (!mlp || !inputs || !targets) return -1.0f;
+// Switch how saved activations are kept during training. Buffers of the old
+// mode are released, the new ones are created lazily by mlp_train.
+void mlp_set_activation_storage(MLP* mlp, ActivationStorage storage) {
+  if (!mlp || mlp->act_storage == storage) return;
 
   for (size_t i = 0; i < mlp->num_layers; i++) {
-    if (!mlp->layers[i].input) {
-      size_t input_size = (i == 0) ? mlp->layers[i].weights->cols : mlp->layers[i - 1].output->rows;
-      mlp->layers[i].input = mat_create(input_size, 1);
-      mlp->layers[i].weight_grad = mat_create(mlp->layers[i].weights->rows, mlp->layers[i].weights->cols);
-      mlp->layers[i].bias_grad = mat_create(mlp->layers[i].bias->rows, 1);
-      mlp->layers[i].output_grad = mat_create(mlp->layers[i].output->rows, 1);
-    }
+    Layer* layer = &mlp->layers[i];
+    if (layer->input) { mat_free(layer->input); layer->input = NULL; }
+    if (layer->saved_input) { packed_free(layer->saved_input); layer->saved_input = NULL; }
+    if (layer->saved_output) { packed_free(layer->saved_output); layer->saved_output = NULL; }
   }
 
-  float avg_loss = 0.0;
+  mlp->act_storage = storage;
+}
 
-  for (size_t epoch = 0; epoch < epochs; epoch++) {
-    float epoch_loss = 0.0f;
+// Bytes of activations the MLP holds between forward and backward. FULL keeps
+// every fp32 Layer::output (the inputs are views of them, layer 0's of the
+// caller's sample); the packed modes keep layer 0's input and one compact copy
+// per output, and never write Layer::output while training.
+size_t mlp_saved_activation_bytes(const MLP* mlp) {
+  if (!mlp) return 0;
 
-    for (size_t sample = 0; sample < num_samples; sample++) {
-      Matrix* input = inputs[sample];
-      Matrix* target = targets[sample];
+  size_t total = 0;
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    const Layer* layer = &mlp->layers[i];
+    if (mlp->act_storage == ACT_STORE_FULL) {
+      total += layer->output->rows * sizeof(float);
+    } else {
+      if (layer->saved_input) total += layer->saved_input->bytes;
+      if (layer->saved_output) total += layer->saved_output->bytes;
+    }
+  }
+  return total;
+}
 
-      // store input for first layer 
-      // TODO: do NOT index layers by input row
-      for (size_t r = 0; r < input->rows; r++) {
-        mat_set_unsafe(mlp->layers[0].input, r, 0, mat_get(input, r, 0));
-      }
+// Allocates what mlp_train_sample needs (gradients, saved activations).
+// sample_input is any input of the right shape, layer 0's view starts on it.
+int mlp_train_prepare(MLP* mlp, Matrix* sample_input) {
+  if (!mlp || !sample_input) return -1;
 
-      Matrix* output = mat_create(mlp->layers[mlp->num_layers - 1].output->rows, 1);
-      mlp_forward(mlp, input, output);
+  int packed = mlp->act_storage != ACT_STORE_FULL;
 
-      for (size_t li = 1; li < mlp->num_layers; li++) {
-        Matrix* prev_out = mlp->layers[li - 1].output;
-        Matrix* this_in = mlp->layers[li].input;
-        for (size_t r = 0; r < this_in->rows; r++) {
-          mat_set_unsafe(this_in, r, 0, mat_get(prev_out, r, 0));
-        }
+  for (size_t i = 0; i < mlp->num_layers; i++) {
+    Layer* layer = &mlp->layers[i];
+    size_t input_size = (i == 0) ? layer->weights->cols : mlp->layers[i - 1].output->rows;
+    if (!layer->weight_grad) {
+      layer->weight_grad = mat_create(layer->weights->rows, layer->weights->cols);
+      layer->bias_grad = mat_create(layer->bias->rows, 1);
+      layer->output_grad = mat_create(layer->output->rows, 1);
+    }
+    // inputs are views: layer 0 is re-pointed at every sample, the others see the previous output
+    if (!packed && !layer->input) {
+      layer->input = (i == 0) ? mat_view(sample_input, 0, 0, input_size, 1)
+                              : mat_view(mlp->layers[i - 1].output, 0, 0, input_size, 1);
+      if (!layer->input) return -1;
+    }
+    if (packed && !layer->saved_output) {
+      if (i == 0) {
+        layer->saved_input = packed_create(input_size, 1, act_storage_format(mlp->act_storage, mlp->activations[i], 0));
+        if (!layer->saved_input) return -1;
       }
+      int is_last = i + 1 == mlp->num_layers;
+      layer->saved_output = packed_create(layer->output->rows, 1, act_storage_format(mlp->act_storage, mlp->activations[i], is_last));
+      if (!layer->saved_output) return -1;
+    }
+  }
 
-      float loss = compute_loss(loss_func, output, target);
-      epoch_loss += loss;
+  return 0;
+}
 
-      Matrix* output_grad = mat_create(output->rows, output->cols);
-      compute_loss_derivative(loss_func, output, target, output_grad);
-
-      Matrix* curr_grad = output_grad;
-      for (int i = mlp->num_layers - 1; i >= 0; i--) {
-        Matrix* input_grad = mat_create(mlp->layers[i].input->rows, 1);
-        layer_backward(curr_grad, &mlp->layers[i], input_grad, mlp->activations[i]);
-
-        if (i > 0) {
-          if (curr_grad != output_grad) {
-            mat_free(curr_grad);
-          }
-          curr_grad = input_grad;
-        } else {
-          mat_free(input_grad);
-        }
-      }
-      if (curr_grad != output_grad) mat_free(curr_grad);
+// Backward of layer `index` after a training forward, in any storage mode:
+// the packed modes read the input from the previous layer's compact copy.
+int mlp_layer_backward(MLP* mlp, size_t index, Matrix* output_grad, Matrix* input_grad) {
+  if (!mlp || index >= mlp->num_layers) return -1;
+
+  const PackedMatrix* packed_input = NULL;
+  if (mlp->act_storage != ACT_STORE_FULL) {
+    packed_input = index == 0 ? mlp->layers[0].saved_input : mlp->layers[index - 1].saved_output;
+    if (!packed_input) return -1;
+  }
+  return layer_backward_saved(output_grad, &mlp->layers[index], packed_input, input_grad, mlp->activations[index]);
+}
+
+// One SGD step on a single sample (forward, backward, update). mlp_train_prepare
+// must have been called. Returns the sample's loss, -1 on error.
+float mlp_train_sample(MLP* mlp, Matrix* input, Matrix* target, LossFunction loss_func) {
+  if (!mlp || !input || !target) return -1.0f;
+
+  int packed = mlp->act_storage != ACT_STORE_FULL;
+  Matrix* output = mat_create(mlp->layers[mlp->num_layers - 1].output->rows, 1);
+  if (!output) return -1.0f;
+
+  if (packed) {
+    // each fp32 activation lives only until the next layer has consumed it
+    // and its compact copy is written
+    if (packed_encode(input, mlp->layers[0].saved_input) != 0) {
+      mat_free(output);
+      return -1.0f;
+    }
+    Matrix* in = input;
+    int rc = 0;
+    for (size_t li = 0; li < mlp->num_layers && rc == 0; li++) {
+      Matrix* out = li + 1 == mlp->num_layers ? output : mat_create(mlp->layers[li].weights->rows, 1);
+      rc = out ? layer_forward_batch(&mlp->layers[li], mlp->activations[li], in, out) : -1;
+      if (rc == 0) rc = packed_encode(out, mlp->layers[li].saved_output);
+      if (in != input) mat_free(in);
+      in = out;
+    }
+    if (in != input && in != output) mat_free(in);
+    if (rc != 0) {
+      mat_free(output);
+      return -1.0f;
+    }
+  } else {
+    if (mat_view_reset(mlp->layers[0].input, input, 0, 0) != 0) {
       mat_free(output);
-      mat_free(output_grad);
+      return -1.0f;
+    }
+    mlp_forward(mlp, input, output);
+  }
 
-      mlp_update_weights(mlp);
+  float loss = compute_loss(loss_func, output, target);
+
+  Matrix* output_grad = mat_create(output->rows, output->cols);
+  compute_loss_derivative(loss_func, output, target, output_grad);
+
+  Matrix* curr_grad = output_grad;
+  for (int i = mlp->num_layers - 1; i >= 0; i--) {
+    Matrix* input_grad = mat_create(mlp->layers[i].weights->cols, 1);
+    mlp_layer_backward(mlp, (size_t)i, curr_grad, input_grad);
+
+    if (i > 0) {
+      if (curr_grad != output_grad) {
+        mat_free(curr_grad);
+      }
+      curr_grad = input_grad;
+    } else {
+      mat_free(input_grad);
+    }
+  }
+  if (curr_grad != output_grad) mat_free(curr_grad);
+  mat_free(output);
+  mat_free(output_grad);
+
+  mlp_update_weights(mlp);
+
+  return loss;
+}
+
+float mlp_train(MLP* mlp, Matrix** inputs, Matrix** targets, size_t num_samples, size_t epochs, LossFunction loss_func, float epsilon) {
+  if (!mlp || !inputs || !targets) return -1.0f;
+
+  if (mlp_train_prepare(mlp, inputs[0]) != 0) return -1.0f;
+
+  float avg_loss = 0.0;
+
+  // the order only depends on seed and epoch, so a resumed run replays it
+  size_t* order = NULL;
+  if (mlp->shuffle) {
+    order = (size_t*)malloc(sizeof(size_t) * num_samples);
+    if (!order) return -1.0f;
+  }
+
+  for (size_t epoch = 0; epoch < epochs; epoch++) {
+    float epoch_loss = 0.0f;
+
+    if (order) {
+      Rng rng;
+      rng_init(&rng, mlp->seed, MLP_SHUFFLE_STREAM + mlp->epoch);
+      for (size_t i = 0; i < num_samples; i++) order[i] = i;
+      rng_shuffle(&rng, order, num_samples);
+    }
+
+    for (size_t i = 0; i < num_samples; i++) {
+      size_t sample = order ? order[i] : i;
+      float loss = mlp_train_sample(mlp, inputs[sample], targets[sample], loss_func);
+      if (loss < 0.0f) {
+        free(order);
+        return -1.0f;
+      }
+      epoch_loss += loss;
     }
 
     avg_loss = epoch_loss / num_samples;
     if (epoch % 10 == 0 || epoch == epochs - 1)
       printf("Epoch %zu/%zu = Loss: %.4f\n", epoch + 1, epochs, avg_loss);
 
+    mlp->epoch++;
+    if (mlp->epoch_hook) mlp->epoch_hook(mlp->epoch_hook_ctx, mlp->epoch, avg_loss);
+
     if (avg_loss < epsilon) break;
   }
+  free(order);
   return avg_loss;
 }
@@ -0,0 +1,410 @@
+#pragma once
+
+#include "MLP.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Model-packed training: K MLPs of the same topology trained side by side.
+//
+// A tiny network like {2, 4, 1} spends almost all of mlp_train in per-sample
+// bookkeeping (temporary matrices, expression dispatch) rather than math.
+// MLPPack stores the parameters of all K models interleaved with the model
+// index innermost, weights[l][(o * in + i) * lanes + k], so each step is one
+// batched matrix-vector product per layer whose inner loop runs over the
+// models in contiguous memory and vectorizes. K is padded to a multiple of
+// 4 lanes; padding lanes have learning rate 0 and are never reported.
+// Nothing is allocated per step.
+//
+// Every model sees the same samples in the same order and follows exactly
+// the update rule of mlp_train (per-sample SGD with its own learning rate),
+// so the result matches training each model separately up to rounding
+// (sigmoid and tanh use a float exp here, see pack_exp). A model whose epoch loss drops below epsilon stops updating,
+// like mlp_train breaking out of its loop; the others carry on. Models with
+// MLP::shuffle set are refused, the pack always visits samples in order.
+
+typedef struct {
+  size_t num_models;        // K
+  size_t lanes;             // K rounded up to PACK_LANES, stride of the model index
+  size_t num_layers;
+  size_t *dims;             // num_layers + 1 sizes
+  ActivationType *activations;
+  float **weights;          // [l][(o * dims[l] + i) * lanes + k]
+  float **bias;             // [l][o * lanes + k]
+  float **act;              // [l][i * lanes + k], act[0] is the input broadcast to every model
+  float *grad[2];           // ping-pong gradients w.r.t. a layer's output, [o * lanes + k]
+  float *learning_rates;    // per model, copied from MLP::learning_rate, may be changed
+  float *rates;             // learning rate in effect (lanes), 0 once a model converged
+  char *converged;          // loss went below epsilon during the current mlp_pack_train
+  float *loss;              // per model mean loss of the last epoch
+  float *epoch_loss;        // running sums during an epoch
+  size_t *epochs;           // epochs each model trained, over every mlp_pack_train
+  size_t *base_epochs;      // MLP::epoch of each model when it was packed
+} MLPPack;
+
+#define PACK_LANES 4
+
+typedef float pack_v4 __attribute__((vector_size(PACK_LANES * sizeof(float)), aligned(4)));
+typedef int32_t pack_v4i __attribute__((vector_size(PACK_LANES * sizeof(int32_t))));
+
+void mlp_pack_free(MLPPack* pack) {
+  if (!pack) return;
+
+  for (size_t l = 0; l < pack->num_layers; l++) {
+    if (pack->weights) free(pack->weights[l]);
+    if (pack->bias) free(pack->bias[l]);
+  }
+  for (size_t l = 0; l <= pack->num_layers; l++) {
+    if (pack->act) free(pack->act[l]);
+  }
+  free(pack->weights);
+  free(pack->bias);
+  free(pack->act);
+  free(pack->grad[0]);
+  free(pack->grad[1]);
+  free(pack->dims);
+  free(pack->activations);
+  free(pack->learning_rates);
+  free(pack->rates);
+  free(pack->converged);
+  free(pack->loss);
+  free(pack->epoch_loss);
+  free(pack->epochs);
+  free(pack->base_epochs);
+  free(pack);
+}
+
+// Packs copies of the parameters of num_models MLPs sharing topology and
+// activations. The MLPs are not modified, see mlp_pack_unpack.
+MLPPack* mlp_pack_create(MLP** models, size_t num_models) {
+  if (!models || num_models == 0 || !models[0]) return NULL;
+
+  const MLP* first = models[0];
+  if (first->shuffle) return NULL;
+  for (size_t k = 1; k < num_models; k++) {
+    if (models[k] && models[k]->shuffle) return NULL;
+    if (!models[k] || models[k]->num_layers != first->num_layers) return NULL;
+    for (size_t l = 0; l < first->num_layers; l++) {
+      if (models[k]->layers[l].weights->rows != first->layers[l].weights->rows) return NULL;
+      if (models[k]->layers[l].weights->cols != first->layers[l].weights->cols) return NULL;
+      if (models[k]->activations[l] != first->activations[l]) return NULL;
+    }
+  }
+
+  MLPPack* pack = (MLPPack*)calloc(1, sizeof(MLPPack));
+  CHECK_NULL(pack);
+
+  size_t K = num_models, L = first->num_layers;
+  size_t lanes = (K + PACK_LANES - 1) / PACK_LANES * PACK_LANES;
+  pack->num_models = K;
+  pack->lanes = lanes;
+  pack->num_layers = L;
+  pack->dims = (size_t*)malloc(sizeof(size_t) * (L + 1));
+  pack->activations = (ActivationType*)malloc(sizeof(ActivationType) * L);
+  pack->weights = (float**)calloc(L, sizeof(float*));
+  pack->bias = (float**)calloc(L, sizeof(float*));
+  pack->act = (float**)calloc(L + 1, sizeof(float*));
+  pack->learning_rates = (float*)malloc(sizeof(float) * K);
+  pack->rates = (float*)calloc(lanes, sizeof(float));
+  pack->converged = (char*)malloc(K);
+  pack->loss = (float*)calloc(K, sizeof(float));
+  pack->epoch_loss = (float*)calloc(K, sizeof(float));
+  pack->epochs = (size_t*)calloc(K, sizeof(size_t));
+  pack->base_epochs = (size_t*)malloc(sizeof(size_t) * K);
+  if (!pack->dims || !pack->activations || !pack->weights || !pack->bias || !pack->act ||
+      !pack->learning_rates || !pack->rates || !pack->converged || !pack->loss || !pack->epoch_loss || !pack->epochs ||
+      !pack->base_epochs) {
+    mlp_pack_free(pack);
+    return NULL;
+  }
+
+  size_t widest = 0;
+  pack->dims[0] = first->layers[0].weights->cols;
+  for (size_t l = 0; l < L; l++) {
+    pack->dims[l + 1] = first->layers[l].weights->rows;
+    pack->activations[l] = first->activations[l];
+  }
+  for (size_t l = 0; l <= L; l++) {
+    if (pack->dims[l] > widest) widest = pack->dims[l];
+    pack->act[l] = (float*)calloc(pack->dims[l] * lanes, sizeof(float));
+    if (!pack->act[l]) {
+      mlp_pack_free(pack);
+      return NULL;
+    }
+  }
+  pack->grad[0] = (float*)calloc(widest * lanes, sizeof(float));
+  pack->grad[1] = (float*)calloc(widest * lanes, sizeof(float));
+  if (!pack->grad[0] || !pack->grad[1]) {
+    mlp_pack_free(pack);
+    return NULL;
+  }
+
+  for (size_t l = 0; l < L; l++) {
+    size_t in = pack->dims[l], out = pack->dims[l + 1];
+    pack->weights[l] = (float*)calloc(out * in * lanes, sizeof(float));
+    pack->bias[l] = (float*)calloc(out * lanes, sizeof(float));
+    if (!pack->weights[l] || !pack->bias[l]) {
+      mlp_pack_free(pack);
+      return NULL;
+    }
+    for (size_t k = 0; k < K; k++) {
+      const Layer* layer = &models[k]->layers[l];
+      for (size_t o = 0; o < out; o++) {
+        for (size_t i = 0; i < in; i++) {
+          pack->weights[l][(o * in + i) * lanes + k] = mat_get(layer->weights, o, i);
+        }
+        pack->bias[l][o * lanes + k] = mat_get(layer->bias, o, 0);
+      }
+    }
+  }
+
+  for (size_t k = 0; k < K; k++) {
+    pack->learning_rates[k] = models[k]->learning_rate;
+    pack->base_epochs[k] = models[k]->epoch;
+  }
+  return pack;
+}
+
+// Writes the trained parameters back into the models the pack was made from
+// (same order) and sets their epoch counts to what they were when packed plus
+// the epochs trained since, so unpacking after every mlp_pack_train is safe.
+int mlp_pack_unpack(const MLPPack* pack, MLP** models) {
+  if (!pack || !models) return -1;
+
+  size_t K = pack->num_models, lanes = pack->lanes;
+  for (size_t k = 0; k < K; k++) {
+    if (!models[k] || models[k]->num_layers != pack->num_layers) return -1;
+  }
+  for (size_t k = 0; k < K; k++) {
+    for (size_t l = 0; l < pack->num_layers; l++) {
+      size_t in = pack->dims[l], out = pack->dims[l + 1];
+      Layer* layer = &models[k]->layers[l];
+      for (size_t o = 0; o < out; o++) {
+        for (size_t i = 0; i < in; i++) {
+          mat_set_unsafe(layer->weights, o, i, pack->weights[l][(o * in + i) * lanes + k]);
+        }
+        mat_set_unsafe(layer->bias, o, 0, pack->bias[l][o * lanes + k]);
+      }
+    }
+    models[k]->learning_rate = pack->learning_rates[k];
+    models[k]->epoch = pack->base_epochs[k] + pack->epochs[k];
+    mlp_mark_updated(models[k]);
+  }
+  return 0;
+}
+
+// exp on 4 lanes (Cephes polynomial, ~2 ulp). libm's double exp behind
+// sigmoid() and tanh_act() would otherwise dominate a step of a tiny
+// network, and scalar code with clamps does not auto-vectorize under the
+// default trapping-math rules.
+static inline pack_v4 pack_exp(pack_v4 x) {
+  x = x < 88.0f ? x : 88.0f;
+  x = x > -87.0f ? x : -87.0f;
+  const float round_magic = 12582912.0f;  // 1.5 * 2^23: adding it rounds to an integer
+  pack_v4 t = x * 1.44269504f + round_magic;
+  pack_v4 n = t - round_magic;
+  pack_v4 r = x - n * 0.693359375f + n * 2.12194440e-4f;
+  pack_v4 p = r * 1.9875691500e-4f + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.0f;
+  pack_v4i scale = ((pack_v4i)t - 0x4B400000 + 127) << 23;  // n + bias into the exponent field
+  return p * (pack_v4)scale;
+}
+
+static inline pack_v4 pack_sigmoid(pack_v4 x) {
+  return 1.0f / (1.0f + pack_exp(-x));
+}
+
+static inline pack_v4 pack_tanh(pack_v4 x) {
+  return 1.0f - 2.0f / (1.0f + pack_exp(2.0f * x));
+}
+
+// z = f(z) over n floats (a multiple of PACK_LANES), the functions of layer_forward
+static void pack_activate(ActivationType type, float* z, size_t n) {
+  pack_v4* v = (pack_v4*)z;
+  for (size_t j = 0; j < n / PACK_LANES; j++) {
+    switch (type) {
+      case ACTIVATION_SIGMOID: v[j] = pack_sigmoid(v[j]); break;
+      case ACTIVATION_TANH:    v[j] = pack_tanh(v[j]); break;
+      case ACTIVATION_RELU:    v[j] = v[j] > 0.0f ? v[j] : 0.0f; break;
+    }
+  }
+}
+
+// g *= f'(out), evaluated on the layer output like layer_backward
+static void pack_scale_by_derivative(ActivationType type, float* g, const float* out, size_t n) {
+  pack_v4* vg = (pack_v4*)g;
+  const pack_v4* vo = (const pack_v4*)out;
+  for (size_t j = 0; j < n / PACK_LANES; j++) {
+    switch (type) {
+      case ACTIVATION_SIGMOID: {
+        pack_v4 s = pack_sigmoid(vo[j]);
+        vg[j] *= s * (1.0f - s);
+        break;
+      }
+      case ACTIVATION_TANH: {
+        pack_v4 t = pack_tanh(vo[j]);
+        vg[j] *= 1.0f - t * t;
+        break;
+      }
+      case ACTIVATION_RELU:
+        vg[j] = vo[j] > 0.0f ? vg[j] : 0.0f;
+        break;
+    }
+  }
+}
+
+static void pack_forward(MLPPack* pack) {
+  size_t lanes = pack->lanes;
+  for (size_t l = 0; l < pack->num_layers; l++) {
+    size_t in = pack->dims[l], out = pack->dims[l + 1];
+    const float* x = pack->act[l];
+    float* z = pack->act[l + 1];
+    for (size_t o = 0; o < out; o++) {
+      float* zo = z + o * lanes;
+      const float* w = pack->weights[l] + o * in * lanes;
+      memset(zo, 0, sizeof(float) * lanes);
+      for (size_t i = 0; i < in; i++) {
+        const float* wi = w + i * lanes;
+        const float* xi = x + i * lanes;
+        for (size_t k = 0; k < lanes; k++) zo[k] += wi[k] * xi[k];
+      }
+      const float* b = pack->bias[l] + o * lanes;
+      for (size_t k = 0; k < lanes; k++) zo[k] += b[k];
+    }
+    pack_activate(pack->activations[l], z, out * lanes);
+  }
+}
+
+// Loss of every model on `target` into epoch_loss, its gradient into grad[0]
+static int pack_loss(MLPPack* pack, const Matrix* target, LossFunction loss_func) {
+  size_t K = pack->num_models, lanes = pack->lanes, out = pack->dims[pack->num_layers];
+  const float* pred = pack->act[pack->num_layers];
+  float* g = pack->grad[0];
+  const float epsilon = 1e-15f;
+
+  for (size_t k = 0; k < K; k++) {
+    float sum = 0.0f;
+    for (size_t o = 0; o < out; o++) {
+      float p = pred[o * lanes + k], t = mat_get(target, o, 0);
+      switch (loss_func) {
+        case LOSS_MSE:
+          sum += (p - t) * (p - t);
+          g[o * lanes + k] = (p - t) * 2.0f;
+          break;
+        case LOSS_MAE:
+          sum += fabsf(p - t);
+          g[o * lanes + k] = p - t > 0.0f ? 1.0f : -1.0f;
+          break;
+        case LOSS_CROSS_ENTROPY: {
+          float c = p < epsilon ? epsilon : p;
+          sum += t * logf(c > 1.0f - epsilon ? 1.0f - epsilon : c);
+          g[o * lanes + k] = -t / c;
+          break;
+        }
+        default:
+          return -1;
+      }
+    }
+    if (loss_func == LOSS_CROSS_ENTROPY) sum = -sum;
+    pack->epoch_loss[k] += sum / out;
+  }
+  return 0;
+}
+
+// Backward and update fused per layer: the gradient for the layer below is
+// taken from the weights before this layer's update, as mlp_train does.
+static void pack_backward(MLPPack* pack) {
+  size_t lanes = pack->lanes;
+  const float* rate = pack->rates;
+  float* g = pack->grad[0];
+  float* g_below = pack->grad[1];
+
+  for (size_t l = pack->num_layers; l-- > 0;) {
+    size_t in = pack->dims[l], out = pack->dims[l + 1];
+    const float* x = pack->act[l];
+    float* w = pack->weights[l];
+    float* b = pack->bias[l];
+    pack_scale_by_derivative(pack->activations[l], g, pack->act[l + 1], out * lanes);
+
+    if (l > 0) memset(g_below, 0, sizeof(float) * in * lanes);
+    for (size_t o = 0; o < out; o++) {
+      const float* go = g + o * lanes;
+      for (size_t i = 0; i < in; i++) {
+        float* wi = w + (o * in + i) * lanes;
+        const float* xi = x + i * lanes;
+        if (l > 0) {
+          float* gi = g_below + i * lanes;
+          for (size_t k = 0; k < lanes; k++) gi[k] += wi[k] * go[k];
+        }
+        for (size_t k = 0; k < lanes; k++) wi[k] -= go[k] * xi[k] * rate[k];
+      }
+      float* bo = b + o * lanes;
+      for (size_t k = 0; k < lanes; k++) bo[k] -= go[k] * rate[k];
+    }
+
+    float* tmp = g;
+    g = g_below;
+    g_below = tmp;
+  }
+}
+
+// Trains every packed model on the same samples, like mlp_train on each.
+// Per-model results are in pack->loss and pack->epochs. Returns the mean of
+// the models' last epoch losses, -1 on error.
+float mlp_pack_train(MLPPack* pack, Matrix** inputs, Matrix** targets, size_t num_samples, size_t epochs, LossFunction loss_func, float epsilon) {
+  if (!pack || !inputs || !targets || num_samples == 0) return -1.0f;
+
+  size_t K = pack->num_models, L = pack->num_layers;
+  for (size_t s = 0; s < num_samples; s++) {
+    if (!inputs[s] || inputs[s]->rows != pack->dims[0]) return -1.0f;
+    if (!targets[s] || targets[s]->rows != pack->dims[L]) return -1.0f;
+  }
+  memcpy(pack->rates, pack->learning_rates, sizeof(float) * K);
+  memset(pack->converged, 0, K);
+
+  size_t training = K;
+  float mean_loss = 0.0f;
+  for (size_t epoch = 0; epoch < epochs && training > 0; epoch++) {
+    memset(pack->epoch_loss, 0, sizeof(float) * K);
+
+    for (size_t s = 0; s < num_samples; s++) {
+      for (size_t i = 0; i < pack->dims[0]; i++) {
+        float v = mat_get(inputs[s], i, 0);
+        float* xi = pack->act[0] + i * pack->lanes;
+        for (size_t k = 0; k < pack->lanes; k++) xi[k] = v;
+      }
+      pack_forward(pack);
+      if (pack_loss(pack, targets[s], loss_func) != 0) return -1.0f;
+      pack_backward(pack);
+    }
+
+    float min_loss = INFINITY, max_loss = 0.0f;
+    mean_loss = 0.0f;
+    for (size_t k = 0; k < K; k++) {
+      if (pack->converged[k]) continue;
+      pack->loss[k] = pack->epoch_loss[k] / num_samples;
+      pack->epochs[k]++;
+      if (pack->loss[k] < epsilon) {
+        pack->converged[k] = 1;
+        pack->rates[k] = 0.0f;
+        training--;
+      }
+    }
+    for (size_t k = 0; k < K; k++) {
+      mean_loss += pack->loss[k];
+      if (pack->loss[k] < min_loss) min_loss = pack->loss[k];
+      if (pack->loss[k] > max_loss) max_loss = pack->loss[k];
+    }
+    mean_loss /= K;
+
+    if (epoch % 10 == 0 || epoch == epochs - 1)
+      printf("Epoch %zu/%zu = Loss: mean %.4f min %.4f max %.4f, %zu/%zu models training\n",
+             epoch + 1, epochs, mean_loss, min_loss, max_loss, training, K);
+  }
+  return mean_loss;
+}
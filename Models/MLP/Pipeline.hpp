@@ -0,0 +1,434 @@
+#pragma once
+
+#include "MLP.hpp"
+#include "../../Utils/SPSCQueue.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Pipeline-parallel training.
+//
+// The layers are split into num_stages contiguous groups of roughly equal
+// weight count, each run by its own thread. A step of
+// micro_batch * micro_batches_per_step samples is cut into micro-batches that
+// stream through the stages with a 1F1B schedule: stage s first runs
+// min(S - s - 1, M) forwards to fill the pipeline, then alternates one
+// forward and one backward, then drains the remaining backwards. Activations
+// go downstream and gradients upstream through SPSC queues as column views
+// of the sender's per-micro-batch buffers, so nothing is copied between
+// stages.
+//
+// Gradients are summed over the step and every stage applies the mean to its
+// own layers once its last backward is done (a flush per step), so the
+// result is plain mini-batch SGD: weights never change while a micro-batch
+// is in flight. Unlike mlp_train, which updates after every sample, one
+// update covers the whole step.
+//
+// Every stage pushes and pops the same sequence of items whatever happens, so
+// a stage whose work fails still sends PIPELINE_FAILED_ITEM in place of the
+// view (the queues cannot carry NULL). Its neighbours skip the compute for
+// that micro-batch and pass the marker on, and the epoch barrier stops every
+// stage at once.
+
+#define PIPELINE_FAILED_ITEM ((void*)~(uintptr_t)0)
+
+typedef struct {
+  size_t first_layer;     // [first_layer, last_layer)
+  size_t last_layer;
+  Matrix ***acts;         // acts[l - first_layer][m]: output of layer l for micro-batch slot m
+  Matrix **in;            // stage 0: gathered input columns per slot
+  Matrix **target;        // last stage: gathered target columns per slot
+  Matrix **in_grad;       // stages > 0: gradient w.r.t. the stage input per slot
+  Matrix **recv;          // stages > 0: input views received per slot, freed after backward
+  Matrix *grad[2];        // ping-pong gradients between layers of the stage
+  SPSCQueue *fwd_in, *fwd_out;
+  SPSCQueue *bwd_in, *bwd_out;
+} PipelineStage;
+
+typedef struct {
+  MLP *mlp;
+  PipelineStage *stages;
+  size_t num_stages;
+  size_t micro_batch;
+  size_t micro_per_step;
+
+  Matrix **inputs;
+  Matrix **targets;
+  size_t num_samples;
+  size_t epochs;
+  LossFunction loss_func;
+  float epsilon;
+
+  std::mutex lock;          // epoch barrier
+  std::condition_variable wake;
+  size_t arrived;
+  size_t generation;
+  bool stop;
+  float epoch_loss;         // written by the last stage
+  float avg_loss;
+  std::atomic<int> failed;
+} Pipeline;
+
+// Contiguous layer groups with about total / num_stages weights each, at least one layer per stage.
+static void pipeline_partition(const MLP* mlp, PipelineStage* stages, size_t num_stages) {
+  size_t total = 0;
+  for (size_t l = 0; l < mlp->num_layers; l++) {
+    total += mat_size(mlp->layers[l].weights);
+  }
+
+  size_t l = 0;
+  size_t acc = 0;
+  for (size_t s = 0; s < num_stages; s++) {
+    stages[s].first_layer = l;
+    size_t layers_left_for_others = num_stages - s - 1;
+    size_t goal = total * (s + 1) / num_stages;
+    do {
+      acc += mat_size(mlp->layers[l].weights);
+      l++;
+    } while (l < mlp->num_layers - layers_left_for_others &&
+             (s + 1 == num_stages || acc + mat_size(mlp->layers[l].weights) / 2 <= goal));
+    stages[s].last_layer = l;
+  }
+}
+
+static void pipeline_free_slots(Matrix** slots, size_t count) {
+  if (!slots) return;
+  for (size_t m = 0; m < count; m++) {
+    mat_free(slots[m]);
+  }
+  free(slots);
+}
+
+static Matrix** pipeline_create_slots(size_t count, size_t rows, size_t cols) {
+  Matrix** slots = (Matrix**)calloc(count, sizeof(Matrix*));
+  CHECK_NULL(slots);
+  for (size_t m = 0; m < count; m++) {
+    slots[m] = mat_create(rows, cols);
+    if (!slots[m]) {
+      pipeline_free_slots(slots, count);
+      return NULL;
+    }
+  }
+  return slots;
+}
+
+static void pipeline_free(Pipeline* p) {
+  if (!p) return;
+
+  if (p->stages) {
+    size_t M = p->micro_per_step;
+    for (size_t s = 0; s < p->num_stages; s++) {
+      PipelineStage* st = &p->stages[s];
+      if (st->acts) {
+        for (size_t l = st->first_layer; l < st->last_layer; l++) {
+          pipeline_free_slots(st->acts[l - st->first_layer], M);
+        }
+        free(st->acts);
+      }
+      pipeline_free_slots(st->in, M);
+      pipeline_free_slots(st->target, M);
+      pipeline_free_slots(st->in_grad, M);
+      free(st->recv);
+      mat_free(st->grad[0]);
+      mat_free(st->grad[1]);
+      // queues are shared by neighbours, each stage frees its outgoing ones
+      spsc_free(st->fwd_out);
+      spsc_free(st->bwd_out);
+    }
+    free(p->stages);
+  }
+
+  delete p;
+}
+
+static Pipeline* pipeline_create(MLP* mlp, size_t num_stages, size_t micro_batch, size_t micro_per_step) {
+  Pipeline* p = new Pipeline();
+  p->mlp = mlp;
+  p->num_stages = num_stages;
+  p->micro_batch = micro_batch;
+  p->micro_per_step = micro_per_step;
+  p->arrived = 0;
+  p->generation = 0;
+  p->stop = false;
+  p->epoch_loss = 0.0f;
+  p->avg_loss = 0.0f;
+  p->failed = 0;
+
+  p->stages = (PipelineStage*)calloc(num_stages, sizeof(PipelineStage));
+  if (!p->stages) {
+    delete p;
+    return NULL;
+  }
+  pipeline_partition(mlp, p->stages, num_stages);
+
+  size_t M = micro_per_step;
+  for (size_t s = 0; s < num_stages; s++) {
+    PipelineStage* st = &p->stages[s];
+    size_t in_rows = mlp->layers[st->first_layer].weights->cols;
+    size_t max_rows = in_rows;
+
+    st->acts = (Matrix***)calloc(st->last_layer - st->first_layer, sizeof(Matrix**));
+    if (!st->acts) goto fail;
+    for (size_t l = st->first_layer; l < st->last_layer; l++) {
+      size_t rows = mlp->layers[l].weights->rows;
+      if (rows > max_rows) max_rows = rows;
+      st->acts[l - st->first_layer] = pipeline_create_slots(M, rows, micro_batch);
+      if (!st->acts[l - st->first_layer]) goto fail;
+    }
+
+    if (s == 0) {
+      st->in = pipeline_create_slots(M, in_rows, micro_batch);
+      if (!st->in) goto fail;
+    } else {
+      st->in_grad = pipeline_create_slots(M, in_rows, micro_batch);
+      st->recv = (Matrix**)calloc(M, sizeof(Matrix*));
+      if (!st->in_grad || !st->recv) goto fail;
+    }
+    if (s + 1 == num_stages) {
+      st->target = pipeline_create_slots(M, mlp->layers[st->last_layer - 1].weights->rows, micro_batch);
+      if (!st->target) goto fail;
+    }
+
+    st->grad[0] = mat_create(max_rows, micro_batch);
+    st->grad[1] = mat_create(max_rows, micro_batch);
+    if (!st->grad[0] || !st->grad[1]) goto fail;
+
+    if (s + 1 < num_stages) {
+      // at most M micro-batches are in flight between two stages
+      st->fwd_out = spsc_create(M);
+      if (!st->fwd_out) goto fail;
+    }
+    if (s > 0) {
+      st->bwd_out = spsc_create(M);
+      if (!st->bwd_out) goto fail;
+      st->fwd_in = p->stages[s - 1].fwd_out;
+      p->stages[s - 1].bwd_in = st->bwd_out;
+    }
+  }
+
+  return p;
+
+fail:
+  pipeline_free(p);
+  return NULL;
+}
+
+// Blocks until every stage reached the end of the epoch, returns true when training should stop.
+static bool pipeline_epoch_barrier(Pipeline* p, size_t epoch) {
+  std::unique_lock<std::mutex> guard(p->lock);
+
+  size_t generation = p->generation;
+  if (++p->arrived == p->num_stages) {
+    // every stage is parked here, so the parameters are quiescent for the epoch hook
+    p->avg_loss = p->epoch_loss / p->num_samples;
+    p->epoch_loss = 0.0f;
+    if (epoch % 10 == 0 || epoch == p->epochs - 1)
+      printf("Epoch %zu/%zu = Loss: %.4f\n", epoch + 1, p->epochs, p->avg_loss);
+    if (p->avg_loss < p->epsilon || p->failed) p->stop = true;
+
+    p->mlp->epoch++;
+    if (p->mlp->epoch_hook) p->mlp->epoch_hook(p->mlp->epoch_hook_ctx, p->mlp->epoch, p->avg_loss);
+
+    p->arrived = 0;
+    p->generation++;
+    p->wake.notify_all();
+  } else {
+    p->wake.wait(guard, [p, generation] { return p->generation != generation; });
+  }
+  return p->stop;
+}
+
+// View of slot m's first `count` columns (a new header the caller frees)
+static inline Matrix* pipeline_cols(Matrix* slot, size_t count) {
+  return mat_view_cols(slot, 0, count);
+}
+
+static void pipeline_forward(Pipeline* p, size_t s, size_t m, size_t first_sample, size_t count) {
+  PipelineStage* st = &p->stages[s];
+  MLP* mlp = p->mlp;
+  Matrix* in;
+
+  if (s == 0) {
+    mlp_gather_columns(p->inputs, first_sample, count, st->in[m]);
+    in = pipeline_cols(st->in[m], count);
+  } else {
+    void* item = spsc_pop(st->fwd_in);
+    in = st->recv[m] = item == PIPELINE_FAILED_ITEM ? NULL : (Matrix*)item;
+  }
+
+  for (size_t l = st->first_layer; l < st->last_layer; l++) {
+    Matrix* out = in ? pipeline_cols(st->acts[l - st->first_layer][m], count) : NULL;
+    if (!out || layer_forward_batch(&mlp->layers[l], mlp->activations[l], in, out) != 0) p->failed = 1;
+    if (l > st->first_layer || s == 0) mat_free(in);  // the received view is kept for backward
+    in = out;
+  }
+
+  if (s + 1 < p->num_stages) {
+    spsc_push(st->fwd_out, in ? (void*)in : PIPELINE_FAILED_ITEM);   // the next stage owns the view now
+  } else {
+    mat_free(in);
+  }
+}
+
+static void pipeline_backward(Pipeline* p, size_t s, size_t m, size_t first_sample, size_t count) {
+  PipelineStage* st = &p->stages[s];
+  MLP* mlp = p->mlp;
+  size_t last = st->last_layer - 1;
+  Matrix* out_grad;
+  int next = 0;
+
+  if (s + 1 == p->num_stages) {
+    Matrix* out = pipeline_cols(st->acts[last - st->first_layer][m], count);
+    Matrix* target = pipeline_cols(st->target[m], count);
+    out_grad = out ? mat_view(st->grad[0], 0, 0, out->rows, count) : NULL;
+    if (out && target && out_grad) {
+      mlp_gather_columns(p->targets, first_sample, count, st->target[m]);
+
+      // compute_loss averages over every element, mlp_train reports the mean per sample
+      p->epoch_loss += compute_loss(p->loss_func, out, target) * count;
+      compute_loss_derivative(p->loss_func, out, target, out_grad);
+    } else {
+      p->failed = 1;
+      mat_free(out_grad);
+      out_grad = NULL;
+    }
+    mat_free(out);
+    mat_free(target);
+    next = 1;
+  } else {
+    void* item = spsc_pop(st->bwd_in);
+    out_grad = item == PIPELINE_FAILED_ITEM ? NULL : (Matrix*)item;
+  }
+
+  for (size_t l = last + 1; l-- > st->first_layer;) {
+    Layer* layer = &mlp->layers[l];
+    Matrix* out = pipeline_cols(st->acts[l - st->first_layer][m], count);
+    Matrix* in;
+    Matrix* in_grad = NULL;
+
+    if (l > st->first_layer) {
+      in = pipeline_cols(st->acts[l - 1 - st->first_layer][m], count);
+      in_grad = mat_view(st->grad[next], 0, 0, layer->weights->cols, count);
+      next ^= 1;
+    } else if (s == 0) {
+      in = pipeline_cols(st->in[m], count);
+    } else {
+      in = st->recv[m];
+      in_grad = pipeline_cols(st->in_grad[m], count);
+    }
+
+    // stage 0 does not need the gradient w.r.t. its input, every other layer does
+    bool needs_in_grad = l > st->first_layer || s > 0;
+    if (!out_grad || !out || !in || (needs_in_grad && !in_grad) ||
+        layer_backward_batch(layer, mlp->activations[l], in, out, out_grad, in_grad,
+                             layer->weight_grad, layer->bias_grad) != 0) {
+      p->failed = 1;
+      mat_free(in_grad);
+      in_grad = NULL;   // the layers below and the previous stage skip this micro-batch
+    }
+
+    mat_free(out);
+    mat_free(in);     // for stages > 0 this releases the view received in forward
+    mat_free(out_grad);
+    out_grad = in_grad;
+  }
+
+  if (s > 0) {
+    st->recv[m] = NULL;
+    spsc_push(st->bwd_out, out_grad ? (void*)out_grad : PIPELINE_FAILED_ITEM);  // the previous stage owns the view now
+  }
+}
+
+// Mean-gradient SGD on the stage's own layers
+static void pipeline_update(Pipeline* p, size_t s, size_t step_samples) {
+  PipelineStage* st = &p->stages[s];
+  float rate = p->mlp->learning_rate / step_samples;
+  if (p->failed) return;   // the step's gradients are incomplete
+
+  for (size_t l = st->first_layer; l < st->last_layer; l++) {
+    layer_apply_grads(&p->mlp->layers[l], rate);
+  }
+  mlp_mark_updated(p->mlp);
+}
+
+// Samples in micro-batch m of a step holding in_step samples (the last one may be short)
+static inline size_t pipeline_micro_count(const Pipeline* p, size_t in_step, size_t m) {
+  size_t first = m * p->micro_batch;
+  return in_step - first < p->micro_batch ? in_step - first : p->micro_batch;
+}
+
+static void pipeline_stage_run(Pipeline* p, size_t s) {
+  size_t S = p->num_stages;
+  size_t step_samples = p->micro_batch * p->micro_per_step;
+
+  for (size_t epoch = 0; epoch < p->epochs; epoch++) {
+    for (size_t step_first = 0; step_first < p->num_samples; step_first += step_samples) {
+      size_t in_step = p->num_samples - step_first;
+      if (in_step > step_samples) in_step = step_samples;
+      size_t M = (in_step + p->micro_batch - 1) / p->micro_batch;
+
+      size_t warmup = S - s - 1;
+      if (warmup > M) warmup = M;
+
+      size_t f = 0, b = 0;
+      for (; f < warmup; f++) {
+        pipeline_forward(p, s, f, step_first + f * p->micro_batch, pipeline_micro_count(p, in_step, f));
+      }
+      for (; f < M; f++, b++) {
+        pipeline_forward(p, s, f, step_first + f * p->micro_batch, pipeline_micro_count(p, in_step, f));
+        pipeline_backward(p, s, b, step_first + b * p->micro_batch, pipeline_micro_count(p, in_step, b));
+      }
+      for (; b < M; b++) {
+        pipeline_backward(p, s, b, step_first + b * p->micro_batch, pipeline_micro_count(p, in_step, b));
+      }
+
+      pipeline_update(p, s, in_step);
+    }
+
+    if (pipeline_epoch_barrier(p, epoch)) break;
+  }
+}
+
+// Trains mlp like mlp_train with num_stages threads. Samples are taken in
+// order, micro_batch at a time, and weights are updated every
+// micro_batch * micro_batches_per_step samples. num_stages is capped at the
+// number of layers. Returns the last epoch's average loss, -1 on error.
+float mlp_train_pipeline(MLP* mlp, Matrix** inputs, Matrix** targets, size_t num_samples, size_t epochs,
+                         LossFunction loss_func, float epsilon, size_t num_stages, size_t micro_batch,
+                         size_t micro_batches_per_step) {
+  if (!mlp || !inputs || !targets || num_samples == 0) return -1.0f;
+  if (num_stages == 0 || micro_batch == 0 || micro_batches_per_step == 0) return -1.0f;
+  if (num_stages > mlp->num_layers) num_stages = mlp->num_layers;
+
+  size_t in_size = mlp->layers[0].weights->cols;
+  size_t out_size = mlp->layers[mlp->num_layers - 1].weights->rows;
+  for (size_t i = 0; i < num_samples; i++) {
+    if (!mat_is_valid(inputs[i]) || inputs[i]->rows != in_size || inputs[i]->cols != 1) return -1.0f;
+    if (!mat_is_valid(targets[i]) || targets[i]->rows != out_size || targets[i]->cols != 1) return -1.0f;
+  }
+
+  if (mlp_zero_grads(mlp) != 0) return -1.0f;
+
+  Pipeline* p = pipeline_create(mlp, num_stages, micro_batch, micro_batches_per_step);
+  if (!p) return -1.0f;
+  p->inputs = inputs;
+  p->targets = targets;
+  p->num_samples = num_samples;
+  p->epochs = epochs;
+  p->loss_func = loss_func;
+  p->epsilon = epsilon;
+
+  std::thread* workers = new std::thread[num_stages];
+  for (size_t s = 0; s < num_stages; s++) {
+    workers[s] = std::thread(pipeline_stage_run, p, s);
+  }
+  for (size_t s = 0; s < num_stages; s++) {
+    workers[s].join();
+  }
+  delete[] workers;
+
+  float avg_loss = p->failed ? -1.0f : p->avg_loss;
+  pipeline_free(p);
+  return avg_loss;
+}
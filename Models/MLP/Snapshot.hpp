@@ -0,0 +1,223 @@
+#pragma once
+
+#include "MLP.hpp"
+#include <atomic>
+#include <stdint.h>
+
+// Read-copy-update snapshots of an MLP's parameters for serving while training.
+//
+// The trainer keeps mutating its own MLP and every now and then calls
+// snapshot_publish(), which copies the parameters into a spare snapshot and
+// swaps it in with one atomic exchange. Readers never lock: snapshot_pin()
+// announces the snapshot it is about to use in its hazard slot and
+// re-checks that it is still current, so the writer knows not to recycle
+// it. A retired snapshot goes back to the spare list once no hazard slot
+// points at it. In steady state publishing allocates nothing, the
+// same few buffers rotate.
+//
+// One writer thread (the one calling snapshot_publish / snapshot_reclaim),
+// any number of readers up to SNAPSHOT_MAX_READERS. Pinned snapshots are
+// read-only: use mlp_forward_batch (or mlp_prepack), never mlp_forward,
+// which writes Layer::output.
+
+#define SNAPSHOT_MAX_READERS 64
+#define SNAPSHOT_MAX_SPARES 2   // recycled buffers kept around by the writer
+
+typedef struct {
+  MLP *mlp;
+  uint64_t version;             // 1 for the initial model, +1 per publish
+} ModelSnapshot;
+
+typedef struct {
+  std::atomic<ModelSnapshot*> hazard;   // snapshot the reader is using, NULL when idle
+  std::atomic<int> used;                // slot owned by a registered reader
+  char pad[64 - sizeof(std::atomic<ModelSnapshot*>) - sizeof(std::atomic<int>)];
+} SnapshotReader;
+
+typedef struct {
+  size_t published;
+  size_t recycled;              // retired snapshots reused for a later publish
+  size_t freed;
+  size_t retired;               // still pinned by a reader, waiting to be reclaimed
+  uint64_t version;
+} SnapshotStats;
+
+typedef struct {
+  std::atomic<ModelSnapshot*> current;
+  SnapshotReader readers[SNAPSHOT_MAX_READERS];
+
+  // writer side only
+  ModelSnapshot *retired[SNAPSHOT_MAX_READERS + 1];
+  size_t num_retired;
+  ModelSnapshot *spares[SNAPSHOT_MAX_SPARES];
+  size_t num_spares;
+  uint64_t version;
+  size_t published, recycled, freed;
+} SnapshotStore;
+
+static ModelSnapshot* snapshot_alloc(const MLP* mlp) {
+  ModelSnapshot* snap = (ModelSnapshot*)malloc(sizeof(ModelSnapshot));
+  CHECK_NULL(snap);
+  snap->mlp = mlp_clone(mlp);
+  if (!snap->mlp) {
+    free(snap);
+    return NULL;
+  }
+  snap->version = 0;
+  return snap;
+}
+
+static void snapshot_release(ModelSnapshot* snap) {
+  if (!snap) return;
+  mlp_free(snap->mlp);
+  free(snap);
+}
+
+static int snapshot_same_topology(const MLP* a, const MLP* b) {
+  if (a->num_layers != b->num_layers) return 0;
+  for (size_t i = 0; i < a->num_layers; i++) {
+    if (a->layers[i].weights->rows != b->layers[i].weights->rows) return 0;
+    if (a->layers[i].weights->cols != b->layers[i].weights->cols) return 0;
+  }
+  return 1;
+}
+
+// The store starts out serving a copy of `initial`
+SnapshotStore* snapshot_store_create(const MLP* initial) {
+  if (!initial) return NULL;
+
+  SnapshotStore* store = new SnapshotStore();
+  ModelSnapshot* first = snapshot_alloc(initial);
+  if (!first) {
+    delete store;
+    return NULL;
+  }
+
+  first->version = store->version = 1;
+  store->current.store(first);
+  for (size_t r = 0; r < SNAPSHOT_MAX_READERS; r++) {
+    store->readers[r].hazard.store(NULL);
+    store->readers[r].used.store(0);
+  }
+  store->num_retired = 0;
+  store->num_spares = 0;
+  store->published = store->recycled = store->freed = 0;
+  return store;
+}
+
+// All readers must be done with the store
+void snapshot_store_free(SnapshotStore* store) {
+  if (!store) return;
+
+  snapshot_release(store->current.load());
+  for (size_t i = 0; i < store->num_retired; i++) {
+    snapshot_release(store->retired[i]);
+  }
+  for (size_t i = 0; i < store->num_spares; i++) {
+    snapshot_release(store->spares[i]);
+  }
+  delete store;
+}
+
+// Claims a hazard slot for one reader thread, -1 if all are taken
+int snapshot_reader_register(SnapshotStore* store) {
+  if (!store) return -1;
+
+  for (int r = 0; r < SNAPSHOT_MAX_READERS; r++) {
+    int expected = 0;
+    if (store->readers[r].used.compare_exchange_strong(expected, 1)) return r;
+  }
+  return -1;
+}
+
+void snapshot_reader_unregister(SnapshotStore* store, int slot) {
+  if (!store || slot < 0 || slot >= SNAPSHOT_MAX_READERS) return;
+  store->readers[slot].hazard.store(NULL);
+  store->readers[slot].used.store(0);
+}
+
+// Returns the current snapshot, guaranteed not to be recycled until
+// snapshot_unpin(). Wait-free unless a publish lands between the two loads.
+const ModelSnapshot* snapshot_pin(SnapshotStore* store, int slot) {
+  std::atomic<ModelSnapshot*>& hazard = store->readers[slot].hazard;
+  ModelSnapshot* snap = store->current.load();
+  for (;;) {
+    hazard.store(snap);
+    ModelSnapshot* again = store->current.load();
+    if (again == snap) return snap;
+    snap = again;
+  }
+}
+
+void snapshot_unpin(SnapshotStore* store, int slot) {
+  store->readers[slot].hazard.store(NULL, std::memory_order_release);
+}
+
+static int snapshot_is_pinned(SnapshotStore* store, const ModelSnapshot* snap) {
+  for (size_t r = 0; r < SNAPSHOT_MAX_READERS; r++) {
+    if (store->readers[r].hazard.load() == snap) return 1;
+  }
+  return 0;
+}
+
+// Moves retired snapshots no reader holds to the spare list (or frees them).
+// Called by snapshot_publish, returns how many are still pinned.
+size_t snapshot_reclaim(SnapshotStore* store) {
+  if (!store) return 0;
+
+  size_t kept = 0;
+  for (size_t i = 0; i < store->num_retired; i++) {
+    ModelSnapshot* snap = store->retired[i];
+    if (snapshot_is_pinned(store, snap)) {
+      store->retired[kept++] = snap;
+    } else if (store->num_spares < SNAPSHOT_MAX_SPARES) {
+      store->spares[store->num_spares++] = snap;
+    } else {
+      snapshot_release(snap);
+      store->freed++;
+    }
+  }
+  store->num_retired = kept;
+  return kept;
+}
+
+// Publishes a copy of mlp's parameters (same topology as the initial model).
+// Returns the new version, 0 on error.
+uint64_t snapshot_publish(SnapshotStore* store, const MLP* mlp) {
+  if (!store || !mlp) return 0;
+
+  ModelSnapshot* cur = store->current.load();
+  if (!snapshot_same_topology(cur->mlp, mlp)) return 0;
+
+  ModelSnapshot* next;
+  if (store->num_spares > 0) {
+    next = store->spares[--store->num_spares];
+    mlp_copy_params(next->mlp, mlp);
+    store->recycled++;
+  } else {
+    next = snapshot_alloc(mlp);
+    if (!next) return 0;
+  }
+  next->version = ++store->version;
+
+  ModelSnapshot* old = store->current.exchange(next);
+  store->retired[store->num_retired++] = old;
+  store->published++;
+
+  // every reader pins at most one snapshot, so this always leaves room for the next retire
+  snapshot_reclaim(store);
+  return next->version;
+}
+
+// Writer-side counters (call from the publishing thread)
+SnapshotStats snapshot_stats(const SnapshotStore* store) {
+  SnapshotStats stats = {0, 0, 0, 0, 0};
+  if (!store) return stats;
+
+  stats.published = store->published;
+  stats.recycled = store->recycled;
+  stats.freed = store->freed;
+  stats.retired = store->num_retired;
+  stats.version = store->version;
+  return stats;
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <atomic>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#ifndef __ANDROID__
+#include <sys/mman.h>
+#endif
+
+// Block allocator used by mat_create. A Matrix lives in a single block:
+// the header first, the data right after it at the next 64 byte boundary.
+//
+// The default allocator keeps thread-local free lists per power-of-two size
+// class, so short-lived matrices are recycled without touching libc. Any
+// allocator can be plugged in with mat_set_allocator(); blocks remember the
+// allocator that created them, so switching is safe at any time.
+
+#define MAT_ALIGNMENT 64
+#define MAT_POOL_MIN_SHIFT 6                            // smallest class: 64 bytes
+#define MAT_POOL_CLASSES 20                             // largest class: 32 MiB
+#define MAT_POOL_THREAD_CACHE_BYTES ((size_t)32 << 20)   // parked blocks per thread, all classes together
+#define MAT_HUGE_PAGE_BYTES ((size_t)2 << 20)
+
+typedef struct MatAllocator {
+    const char *name;
+    void *(*alloc)(void *ctx, size_t bytes);              // MAT_ALIGNMENT aligned, NULL on failure
+    void (*release)(void *ctx, void *ptr, size_t bytes);  // bytes as passed to alloc
+    void *ctx;
+    size_t (*footprint)(void *ctx, size_t bytes);         // memory really held for a request, NULL = bytes
+} MatAllocator;
+
+typedef struct {
+    size_t live_bytes;      // held by blocks not yet released (the pool counts whole size classes)
+    size_t peak_bytes;
+    size_t limit_bytes;     // 0 = unlimited
+    size_t allocs;
+    size_t frees;
+    size_t failed;          // refused by the limit or the system
+    size_t pool_hits;
+    size_t pool_misses;
+    size_t pool_cached_bytes;  // parked in free lists (all threads)
+    double hit_rate;
+} MatAllocStats;
+
+static std::atomic<size_t> mat_stat_live(0);
+static std::atomic<size_t> mat_stat_peak(0);
+static std::atomic<size_t> mat_stat_limit(0);
+static std::atomic<size_t> mat_stat_allocs(0);
+static std::atomic<size_t> mat_stat_frees(0);
+static std::atomic<size_t> mat_stat_failed(0);
+static std::atomic<size_t> mat_stat_hits(0);
+static std::atomic<size_t> mat_stat_misses(0);
+static std::atomic<size_t> mat_stat_cached(0);
+static std::atomic<int> mat_use_huge_pages(0);
+
+// ============================================================================
+// SYSTEM BACKING
+// ============================================================================
+
+static void* mat_sys_alloc(size_t bytes) {
+    void* ptr = NULL;
+    size_t align = MAT_ALIGNMENT;
+    int huge = bytes >= MAT_HUGE_PAGE_BYTES && mat_use_huge_pages.load(std::memory_order_relaxed);
+    if (huge) {
+        align = MAT_HUGE_PAGE_BYTES;
+    }
+
+    if (posix_memalign(&ptr, align, bytes)) {
+        return NULL;
+    }
+
+#if !defined(__ANDROID__) && defined(MADV_HUGEPAGE)
+    if (huge) {
+        madvise(ptr, bytes, MADV_HUGEPAGE);  // best effort, THP may be disabled
+    }
+#endif
+    return ptr;
+}
+
+static void* mat_system_alloc(void*, size_t bytes) {
+    return mat_sys_alloc(bytes);
+}
+
+static void mat_system_release(void*, void* ptr, size_t) {
+    free(ptr);
+}
+
+// ============================================================================
+// SIZE-CLASS POOL
+// ============================================================================
+
+static inline int mat_pool_class(size_t bytes) {
+    size_t size = (size_t)1 << MAT_POOL_MIN_SHIFT;
+    for (int c = 0; c < MAT_POOL_CLASSES; c++, size <<= 1) {
+        if (bytes <= size) return c;
+    }
+    return -1;  // too large, goes straight to the system
+}
+
+static inline size_t mat_pool_class_bytes(int c) {
+    return (size_t)1 << (MAT_POOL_MIN_SHIFT + c);
+}
+
+// Counters are kept per thread and folded into the globals every
+// MAT_STATS_FLUSH_EVERY events, so the hot path has no atomic RMW besides
+// the live byte count.
+#define MAT_STATS_FLUSH_EVERY 256
+
+struct MatPoolCache {
+    void* heads[MAT_POOL_CLASSES];
+    size_t counts[MAT_POOL_CLASSES];
+
+    size_t cached_bytes;    // parked in this thread's lists, capped by MAT_POOL_THREAD_CACHE_BYTES
+
+    size_t allocs, frees, hits, misses, pending;
+    size_t cached_in, cached_out;
+
+    MatPoolCache() {
+        memset(heads, 0, sizeof(heads));
+        memset(counts, 0, sizeof(counts));
+        cached_bytes = 0;
+        allocs = frees = hits = misses = pending = 0;
+        cached_in = cached_out = 0;
+    }
+
+    void flush() {
+        mat_stat_allocs.fetch_add(allocs, std::memory_order_relaxed);
+        mat_stat_frees.fetch_add(frees, std::memory_order_relaxed);
+        mat_stat_hits.fetch_add(hits, std::memory_order_relaxed);
+        mat_stat_misses.fetch_add(misses, std::memory_order_relaxed);
+        mat_stat_cached.fetch_add(cached_in, std::memory_order_relaxed);
+        mat_stat_cached.fetch_sub(cached_out, std::memory_order_relaxed);
+        allocs = frees = hits = misses = pending = 0;
+        cached_in = cached_out = 0;
+    }
+
+    void tick() {
+        if (++pending >= MAT_STATS_FLUSH_EVERY) flush();
+    }
+
+    void trim() {
+        for (int c = 0; c < MAT_POOL_CLASSES; c++) {
+            while (heads[c]) {
+                void* next = *(void**)heads[c];
+                free(heads[c]);
+                heads[c] = next;
+            }
+            cached_out += counts[c] * mat_pool_class_bytes(c);
+            counts[c] = 0;
+        }
+        cached_bytes = 0;
+        flush();
+    }
+
+    ~MatPoolCache() {
+        trim();
+    }
+};
+
+static thread_local MatPoolCache mat_pool_cache;
+
+static void* mat_pool_alloc(void*, size_t bytes) {
+    int c = mat_pool_class(bytes);
+    MatPoolCache& cache = mat_pool_cache;
+    if (c < 0) {
+        cache.misses++;
+        return mat_sys_alloc(bytes);
+    }
+
+    void* block = cache.heads[c];
+    if (block) {
+        cache.heads[c] = *(void**)block;
+        cache.counts[c]--;
+        cache.cached_bytes -= mat_pool_class_bytes(c);
+        cache.cached_out += mat_pool_class_bytes(c);
+        cache.hits++;
+        return block;
+    }
+
+    cache.misses++;
+    return mat_sys_alloc(mat_pool_class_bytes(c));
+}
+
+static void mat_pool_release(void*, void* ptr, size_t bytes) {
+    int c = mat_pool_class(bytes);
+    if (c < 0) {
+        free(ptr);
+        return;
+    }
+
+    // one budget for the whole thread: a server or trainer thread parks at
+    // most MAT_POOL_THREAD_CACHE_BYTES, whatever mix of sizes it frees
+    size_t class_bytes = mat_pool_class_bytes(c);
+    MatPoolCache& cache = mat_pool_cache;
+    if (cache.cached_bytes + class_bytes > MAT_POOL_THREAD_CACHE_BYTES) {
+        free(ptr);
+        return;
+    }
+
+    *(void**)ptr = cache.heads[c];
+    cache.heads[c] = ptr;
+    cache.counts[c]++;
+    cache.cached_bytes += class_bytes;
+    cache.cached_in += class_bytes;
+}
+
+// a pooled block is a whole size class, larger requests are exact
+static size_t mat_pool_footprint(void*, size_t bytes) {
+    int c = mat_pool_class(bytes);
+    return c < 0 ? bytes : mat_pool_class_bytes(c);
+}
+
+// plain libc, the default under ASan; otherwise only referenced by callers
+// comparing allocators (bench.cpp), so unused in most translation units
+__attribute__((unused)) static MatAllocator mat_system_allocator = {"system", mat_system_alloc, mat_system_release, NULL, NULL};
+static MatAllocator mat_pool_allocator = {"pool", mat_pool_alloc, mat_pool_release, NULL, mat_pool_footprint};
+// recycled blocks would hide use-after-free from ASan, so sanitized builds default to libc
+#if defined(__SANITIZE_ADDRESS__)
+static std::atomic<MatAllocator*> mat_current_allocator(&mat_system_allocator);
+#else
+static std::atomic<MatAllocator*> mat_current_allocator(&mat_pool_allocator);
+#endif
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// NULL restores the pool
+void mat_set_allocator(MatAllocator* allocator) {
+    mat_current_allocator.store(allocator ? allocator : &mat_pool_allocator);
+}
+
+MatAllocator* mat_get_allocator() {
+    return mat_current_allocator.load();
+}
+
+// Cap on live matrix bytes as held by the allocator (size-class rounded for
+// the pool), allocations over it fail (mat_create returns NULL). 0 = no cap.
+void mat_alloc_set_limit(size_t bytes) {
+    mat_stat_limit.store(bytes);
+}
+
+// Back blocks of 2 MiB and up with transparent huge pages (Linux, best effort)
+void mat_alloc_use_huge_pages(int enable) {
+    mat_use_huge_pages.store(enable ? 1 : 0);
+}
+
+// Return the calling thread's cached blocks to the system
+void mat_pool_trim() {
+    mat_pool_cache.trim();
+}
+
+// Exact for the calling thread, other threads' counters may lag by up to
+// MAT_STATS_FLUSH_EVERY events (live / peak bytes are always exact).
+MatAllocStats mat_alloc_stats() {
+    mat_pool_cache.flush();
+
+    MatAllocStats stats;
+    stats.live_bytes = mat_stat_live.load();
+    stats.peak_bytes = mat_stat_peak.load();
+    stats.limit_bytes = mat_stat_limit.load();
+    stats.allocs = mat_stat_allocs.load();
+    stats.frees = mat_stat_frees.load();
+    stats.failed = mat_stat_failed.load();
+    stats.pool_hits = mat_stat_hits.load();
+    stats.pool_misses = mat_stat_misses.load();
+    stats.pool_cached_bytes = mat_stat_cached.load();
+
+    size_t lookups = stats.pool_hits + stats.pool_misses;
+    stats.hit_rate = lookups ? (double)stats.pool_hits / lookups : 0.0;
+    return stats;
+}
+
+void mat_alloc_reset_stats() {
+    mat_pool_cache.flush();
+    mat_stat_peak.store(mat_stat_live.load());
+    mat_stat_allocs.store(0);
+    mat_stat_frees.store(0);
+    mat_stat_failed.store(0);
+    mat_stat_hits.store(0);
+    mat_stat_misses.store(0);
+}
+
+static inline size_t mat_block_footprint(MatAllocator* allocator, size_t bytes) {
+    return allocator->footprint ? allocator->footprint(allocator->ctx, bytes) : bytes;
+}
+
+// Used by mat_create / mat_free: accounting + dispatch to the allocator.
+static void* mat_block_alloc(MatAllocator* allocator, size_t bytes) {
+    size_t held = mat_block_footprint(allocator, bytes);
+    size_t limit = mat_stat_limit.load(std::memory_order_relaxed);
+    size_t live = mat_stat_live.fetch_add(held, std::memory_order_relaxed) + held;
+    if (limit && live > limit) {
+        mat_stat_live.fetch_sub(held, std::memory_order_relaxed);
+        mat_stat_failed.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    void* block = allocator->alloc(allocator->ctx, bytes);
+    if (!block) {
+        mat_stat_live.fetch_sub(held, std::memory_order_relaxed);
+        mat_stat_failed.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    size_t peak = mat_stat_peak.load(std::memory_order_relaxed);
+    while (live > peak && !mat_stat_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+
+    MatPoolCache& cache = mat_pool_cache;
+    cache.allocs++;
+    cache.tick();
+    return block;
+}
+
+static void mat_block_release(MatAllocator* allocator, void* block, size_t bytes) {
+    allocator->release(allocator->ctx, block, bytes);
+    mat_stat_live.fetch_sub(mat_block_footprint(allocator, bytes), std::memory_order_relaxed);
+
+    MatPoolCache& cache = mat_pool_cache;
+    cache.frees++;
+    cache.tick();
+}
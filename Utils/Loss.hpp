@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Matrix.hpp"
+#include "MatrixExpr.hpp"
 #include <alloca.h>
 #include <cstddef>
 #include <math.h>
@@ -50,16 +51,9 @@ float mae(Matrix *pred, Matrix *target) {
       pred->cols != target->cols)
     return -1.0;
 
-  float sum = 0.0;
+  float sum = mat_sum(mx_abs(mx(pred) - mx(target)));
   size_t total_elem = mat_size(pred);
 
-  for (size_t i = 0; i < pred->rows; i++) {
-    for (size_t j = 0; j < pred->cols; j++) {
-      float diff = mat_get(pred, i, j) - mat_get(target, i, j);
-      sum += fabs(diff);
-    }
-  }
-
   return sum / total_elem;
 }
 
@@ -69,15 +63,7 @@ int mae_derivative(Matrix *pred, Matrix *target, Matrix *output) {
       output->cols != pred->cols)
     return -1;
 
-  for (size_t i = 0; i < pred->rows; i++) {
-    for (size_t j = 0; j < pred->cols; j++) {
-      float diff = mat_get(pred, i, j) - mat_get(target, i, j);
-      float deriv = (diff > 0) ? 1.0 : -1.0;
-      mat_set(output, i, j, deriv);
-    }
-  }
-
-  return 0;
+  return mat_assign(output, mx_sign(mx(pred) - mx(target)));
 }
 
 float mse(Matrix *pred, Matrix *target) {
@@ -85,16 +71,9 @@ float mse(Matrix *pred, Matrix *target) {
       pred->cols != target->cols)
     return -1.0;
 
-  float sum = 0.0;
+  float sum = mat_sum(mx_square(mx(pred) - mx(target)));
   size_t total_elem = mat_size(pred);
 
-  for (size_t i = 0; i < pred->rows; i++) {
-    for (size_t j = 0; j < pred->cols; j++) {
-      float diff = mat_get(pred, i, j) - mat_get(target, i, j);
-      sum += diff * diff;
-    }
-  }
-
   return sum / total_elem;
 }
 
@@ -104,14 +83,7 @@ float mse_derivative(Matrix *pred, Matrix *target, Matrix *output) {
       output->cols != pred->cols)
     return -1;
 
-  for (size_t i = 0; i < pred->rows; i++) {
-    for (size_t j = 0; j < pred->cols; j++) {
-      float diff = mat_get(pred, i, j) - mat_get(target, i, j);
-      mat_set(output, i, j, 2.0 * diff);
-    }
-  }
-
-  return 0;
+  return mat_assign(output, (mx(pred) - mx(target)) * 2.0f);
 }
 
 float cross_entropy(Matrix *pred, Matrix *target) {
@@ -119,23 +91,10 @@ float cross_entropy(Matrix *pred, Matrix *target) {
       pred->cols != target->cols)
     return -1.0;
 
-  float sum = 0.0;
+  float epsilon = 1e-15;
+  float sum = mat_sum(mx(target) * mx_map(logf, mx_clamp(mx(pred), epsilon, 1.0 - epsilon)));
   size_t total_elem = mat_size(pred);
 
-  for (size_t i = 0; i < pred->rows; i++) {
-    for (size_t j = 0; j < pred->cols; j++) {
-      float pred_val = mat_get(pred, i, j);
-      float target_val = mat_get(target, i, j);
-      float epsilon = 1e-15;
-
-      if (pred_val < epsilon)
-        pred_val = epsilon;
-      if (pred_val > (1.0 - epsilon))
-        pred_val = 1.0 - epsilon;
-
-      sum += target_val * log(pred_val);
-    }
-  }
   return -sum / total_elem;
 }
 
@@ -145,21 +104,8 @@ float cross_entropy_derivative(Matrix *pred, Matrix *target, Matrix *output) {
       output->cols != pred->cols)
     return -1;
 
-  for (size_t i = 0; i < pred->rows; i++) {
-    for (size_t j = 0; j < pred->cols; j++) {
-      float pred_val = mat_get(pred, i, j);
-      float target_val = mat_get(target, i, j);
-
-      float epsilon = 1e-15;
-      if (pred_val < epsilon)
-        pred_val = epsilon;
-
-      float deriv = -target_val / pred_val;
-      mat_set(output, i, j, deriv);
-    }
-  }
-
-  return 0;
+  float epsilon = 1e-15;
+  return mat_assign(output, -mx(target) / mx_clamp(mx(pred), epsilon, INFINITY));
 }
 
 int softMax(Matrix *input, Matrix *output) {
@@ -6,57 +6,87 @@
 #include <string.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <pthread.h>
+
+#include "Allocator.hpp"
 
 typedef struct Matrix {
     float *data;        // Data.
     size_t rows;        // Number of rows
     size_t cols;        // Number of columns
     size_t stride;      // Row stride 
+    size_t block_bytes;         // size of the block holding header + data
+    MatAllocator *allocator;    // who owns the block
+    unsigned flags;             // MAT_FLAG_*
 } Matrix;
 
+#define MAT_FLAG_VIEW 0x1       // data belongs to another matrix, only the header is freed
+#define MAT_FLAG_PADDED 0x2     // stride is a multiple of MAT_SIMD_FLOATS and the padding is zero
+
+// one SIMD-aligned chunk of a row (64 bytes)
+#define MAT_SIMD_FLOATS (MAT_ALIGNMENT / sizeof(float))
+
+typedef enum {
+    MAT_LAYOUT_DENSE,   // stride == cols
+    MAT_LAYOUT_PADDED,  // stride rounded up to MAT_SIMD_FLOATS, every row 64-byte aligned
+} MatLayout;
+
+static MatLayout mat_default_layout = MAT_LAYOUT_DENSE;
+
+// header is padded so data starts on a MAT_ALIGNMENT boundary of the same block
+#define MAT_HEADER_BYTES ((sizeof(Matrix) + MAT_ALIGNMENT - 1) & ~(size_t)(MAT_ALIGNMENT - 1))
+
 // ============================================================================
 // CORE MATRIX FUNCTIONS
 // ============================================================================
 
-Matrix* mat_create(size_t rows, size_t cols) {
+// Padded layout keeps the padding zero: every kernel here either skips it or
+// writes op(0, 0) == 0 into it, so whole-vector loops never need a tail.
+// Column vectors stay dense, padding them would cost 16x the memory.
+Matrix* mat_create_ex(size_t rows, size_t cols, MatLayout layout) {
     if (rows == 0 || cols == 0) {
         return NULL;
     }
     
-    if (rows > SIZE_MAX / cols) {
-        return NULL;
+    size_t stride = cols;
+    if (layout == MAT_LAYOUT_PADDED && cols > 1) {
+        if (cols > SIZE_MAX - MAT_SIMD_FLOATS) {
+            return NULL;
+        }
+        stride = (cols + MAT_SIMD_FLOATS - 1) / MAT_SIMD_FLOATS * MAT_SIMD_FLOATS;
     }
     
-    Matrix* mat = (Matrix*)malloc(sizeof(Matrix));
-    if (!mat) {
+    if (rows > SIZE_MAX / stride) {
         return NULL;
     }
     
-    size_t total_elements = rows * cols;
-    
-    // needs to be rounded up to nearest multiple of 32 for alignment
-    size_t size_in_bytes = total_elements * sizeof(float);
-    size_t aligned_size = (size_in_bytes + 31) & ~31;  // rounding here
-    
-#ifdef __ANDROID__
-    void* ptr = NULL;
-    if (posix_memalign(&ptr, 32, aligned_size)) {
-        free(mat);
+    size_t total_elements = rows * stride;
+    if (total_elements > (SIZE_MAX - 2 * MAT_HEADER_BYTES) / sizeof(float)) {
         return NULL;
     }
-    mat->data = (float*)ptr;
-#else
-    mat->data = (float*)aligned_alloc(32, aligned_size);
     
-    if (!mat->data) {
-        free(mat);
+    // needs to be rounded up to the allocator alignment
+    size_t size_in_bytes = total_elements * sizeof(float);
+    size_t aligned_size = (size_in_bytes + MAT_ALIGNMENT - 1) & ~(size_t)(MAT_ALIGNMENT - 1);  // rounding here
+    size_t block_bytes = MAT_HEADER_BYTES + aligned_size;
+    
+    MatAllocator* allocator = mat_get_allocator();
+    Matrix* mat = (Matrix*)mat_block_alloc(allocator, block_bytes);
+    if (!mat) {
         return NULL;
     }
-#endif
     
+    mat->data = (float*)((char*)mat + MAT_HEADER_BYTES);
     mat->rows = rows;
     mat->cols = cols;
-    mat->stride = cols;  
+    mat->stride = stride;  
+    mat->block_bytes = block_bytes;
+    mat->allocator = allocator;
+    mat->flags = (stride != cols) ? MAT_FLAG_PADDED : 0;
     
     // only zero the actual data we're using, not the entire aligned block
     memset(mat->data, 0, size_in_bytes);
@@ -64,30 +94,125 @@ Matrix* mat_create(size_t rows, size_t cols) {
     return mat;
 }
 
+Matrix* mat_create(size_t rows, size_t cols) {
+    return mat_create_ex(rows, cols, mat_default_layout);
+}
+
+// Layout used by mat_create (and everything built on it)
+void mat_set_default_layout(MatLayout layout) {
+    mat_default_layout = layout;
+}
+
 Matrix* mat_create_with_value(size_t rows, size_t cols, float init_value) {
     Matrix* mat = mat_create(rows, cols);
     if (!mat) {
         return NULL;
     }
     
-    size_t total_elements = rows * cols;
-    for (size_t i = 0; i < total_elements; i++) {
-        mat->data[i] = init_value;
+    for (size_t i = 0; i < rows; i++) {
+        float* row = mat->data + i * mat->stride;
+        for (size_t j = 0; j < cols; j++) {
+            row[j] = init_value;
+        }
     }
     
     return mat;
 }
 
+// Views are not special here: their block is just the header.
 void mat_free(Matrix* mat) {
     if (!mat) {
         return;
     }
     
-    if (mat->data) {
-        free(mat->data);
+    mat_block_release(mat->allocator, mat, mat->block_bytes);
+}
+
+// ============================================================================
+// VIEWS
+// ============================================================================
+
+// Non-owning (rows x cols) window of parent starting at (row, col). Shares the
+// parent's data and stride, so writes go to the parent. The parent must outlive
+// the view; mat_free on a view only releases the view's header.
+Matrix* mat_view(const Matrix* parent, size_t row, size_t col, size_t rows, size_t cols) {
+    if (!parent || !parent->data || rows == 0 || cols == 0) {
+        return NULL;
+    }
+    
+    if (row > parent->rows || rows > parent->rows - row) return NULL;
+    if (col > parent->cols || cols > parent->cols - col) return NULL;
+    
+    MatAllocator* allocator = mat_get_allocator();
+    Matrix* view = (Matrix*)mat_block_alloc(allocator, MAT_HEADER_BYTES);
+    if (!view) {
+        return NULL;
+    }
+    
+    view->data = parent->data + row * parent->stride + col;
+    view->rows = rows;
+    view->cols = cols;
+    view->stride = parent->stride;
+    view->block_bytes = MAT_HEADER_BYTES;
+    view->allocator = allocator;
+    view->flags = MAT_FLAG_VIEW;
+    
+    // a row range still owns its whole padded rows, a column range does not
+    if ((parent->flags & MAT_FLAG_PADDED) && col == 0 && cols == parent->cols) {
+        view->flags |= MAT_FLAG_PADDED;
     }
     
-    free(mat);
+    return view;
+}
+
+Matrix* mat_view_rows(const Matrix* parent, size_t row, size_t rows) {
+    return parent ? mat_view(parent, row, 0, rows, parent->cols) : NULL;
+}
+
+Matrix* mat_view_cols(const Matrix* parent, size_t col, size_t cols) {
+    return parent ? mat_view(parent, 0, col, parent->rows, cols) : NULL;
+}
+
+// Point an existing view at another window of the same shape (no allocation).
+int mat_view_reset(Matrix* view, const Matrix* parent, size_t row, size_t col) {
+    if (!view || !(view->flags & MAT_FLAG_VIEW) || !parent || !parent->data) return -1;
+    if (row > parent->rows || view->rows > parent->rows - row) return -1;
+    if (col > parent->cols || view->cols > parent->cols - col) return -1;
+    
+    view->data = parent->data + row * parent->stride + col;
+    view->stride = parent->stride;
+    view->flags = MAT_FLAG_VIEW;
+    if ((parent->flags & MAT_FLAG_PADDED) && col == 0 && view->cols == parent->cols) {
+        view->flags |= MAT_FLAG_PADDED;
+    }
+    return 0;
+}
+
+static inline int mat_is_view(const Matrix* mat) {
+    return (mat && (mat->flags & MAT_FLAG_VIEW)) ? 1 : 0;
+}
+
+// rows are back to back, the matrix can be walked as one flat array
+static inline int mat_is_contiguous(const Matrix* mat) {
+    return (mat && (mat->stride == mat->cols || mat->rows == 1)) ? 1 : 0;
+}
+
+static inline int mat_is_padded(const Matrix* mat) {
+    return (mat && (mat->flags & MAT_FLAG_PADDED)) ? 1 : 0;
+}
+
+// Number of floats element-wise kernels can process as one flat run, 0 when
+// the operands have to be walked row by row. Padded operands with a shared
+// stride cover the padding too, which keeps it zero for op(0, 0) == 0.
+static inline size_t mat_flat_span(const Matrix* a, const Matrix* b, const Matrix* c) {
+    if (mat_is_padded(a) && mat_is_padded(b) && mat_is_padded(c) &&
+        a->stride == b->stride && a->stride == c->stride) {
+        return a->rows * a->stride;
+    }
+    if (mat_is_contiguous(a) && mat_is_contiguous(b) && mat_is_contiguous(c)) {
+        return a->rows * a->cols;
+    }
+    return 0;
 }
 
 // ============================================================================
@@ -163,20 +288,35 @@ Matrix* mat_copy(const Matrix* src) {
         return NULL;
     }
     
-    size_t total_elements = src->rows * src->cols;
-    memcpy(dst->data, src->data, total_elements * sizeof(float));
+    for (size_t i = 0; i < src->rows; i++) {
+        memcpy(dst->data + i * dst->stride, src->data + i * src->stride, src->cols * sizeof(float));
+    }
     
     return dst;
 }
 
+// Copy into an existing matrix of the same shape (either side may be a view)
+int mat_copy_into(const Matrix* src, Matrix* dst) {
+    if (!mat_is_valid(src) || !mat_is_valid(dst)) return -1;
+    if (src->rows != dst->rows || src->cols != dst->cols) return -1;
+    
+    for (size_t i = 0; i < src->rows; i++) {
+        memmove(dst->data + i * dst->stride, src->data + i * src->stride, src->cols * sizeof(float));
+    }
+    
+    return 0;
+}
+
 void mat_fill(Matrix* mat, float value) {
     if (!mat_is_valid(mat)) {
         return;
     }
     
-    size_t total_elements = mat->rows * mat->cols;
-    for (size_t i = 0; i < total_elements; i++) {
-        mat->data[i] = value;
+    for (size_t i = 0; i < mat->rows; i++) {
+        float* row = mat->data + i * mat->stride;
+        for (size_t j = 0; j < mat->cols; j++) {
+            row[j] = value;
+        }
     }
 }
 
@@ -185,27 +325,461 @@ void mat_zero(Matrix* mat) {
         return;
     }
     
-    size_t total_elements = mat->rows * mat->cols;
-    memset(mat->data, 0, total_elements * sizeof(float));
+    if (mat_is_contiguous(mat)) {
+        memset(mat->data, 0, mat->rows * mat->cols * sizeof(float));
+        return;
+    }
+    
+    for (size_t i = 0; i < mat->rows; i++) {
+        memset(mat->data + i * mat->stride, 0, mat->cols * sizeof(float));
+    }
 }
 
 // ============================================================================
 // MATRIX OPERATIONS
 // ============================================================================
 
+// ============================================================================
+// GEMM KERNELS
+// ============================================================================
+
+#define MAT_GEMM_MR 4
+#define MAT_GEMM_NR 8
+
+// 4-float GCC/Clang vectors, the unaligned one is for rows of b and c
+typedef float mat_v4 __attribute__((vector_size(16)));
+typedef float mat_v4u __attribute__((vector_size(16), aligned(4)));
+
+// c[0..MR)[0..NR) (+)= a[0..MR)[0..K) * b[0..K)[0..NR), 8 vector accumulators
+static inline void mat_gemm_micro(const float* a, size_t as, const float* b, size_t bs,
+                                  float* c, size_t cs, size_t K, int accumulate) {
+    mat_v4 c00 = {0, 0, 0, 0}, c01 = c00, c10 = c00, c11 = c00;
+    mat_v4 c20 = c00, c21 = c00, c30 = c00, c31 = c00;
+    if (accumulate) {
+        c00 = *(const mat_v4u*)(c);          c01 = *(const mat_v4u*)(c + 4);
+        c10 = *(const mat_v4u*)(c + cs);     c11 = *(const mat_v4u*)(c + cs + 4);
+        c20 = *(const mat_v4u*)(c + 2 * cs); c21 = *(const mat_v4u*)(c + 2 * cs + 4);
+        c30 = *(const mat_v4u*)(c + 3 * cs); c31 = *(const mat_v4u*)(c + 3 * cs + 4);
+    }
+    const float* a0 = a;
+    const float* a1 = a + as;
+    const float* a2 = a + 2 * as;
+    const float* a3 = a + 3 * as;
+
+    for (size_t k = 0; k < K; k++) {
+        const float* bk = b + k * bs;
+        mat_v4 b0 = *(const mat_v4u*)bk;
+        mat_v4 b1 = *(const mat_v4u*)(bk + 4);
+        c00 += a0[k] * b0; c01 += a0[k] * b1;
+        c10 += a1[k] * b0; c11 += a1[k] * b1;
+        c20 += a2[k] * b0; c21 += a2[k] * b1;
+        c30 += a3[k] * b0; c31 += a3[k] * b1;
+    }
+
+    *(mat_v4u*)(c) = c00;          *(mat_v4u*)(c + 4) = c01;
+    *(mat_v4u*)(c + cs) = c10;     *(mat_v4u*)(c + cs + 4) = c11;
+    *(mat_v4u*)(c + 2 * cs) = c20; *(mat_v4u*)(c + 2 * cs + 4) = c21;
+    *(mat_v4u*)(c + 3 * cs) = c30; *(mat_v4u*)(c + 3 * cs + 4) = c31;
+}
+
+// one row of c over [0..n) columns, used for the row remainder
+static inline void mat_gemm_row(const float* a, const float* b, size_t bs, float* c, size_t n, size_t K,
+                                int accumulate) {
+    if (!accumulate) memset(c, 0, n * sizeof(float));
+    for (size_t k = 0; k < K; k++) {
+        float ak = a[k];
+        const float* bk = b + k * bs;
+        for (size_t j = 0; j < n; j++) {
+            c[j] += ak * bk[j];
+        }
+    }
+}
+
+// C (M x N) (+)= A (M x K) * B (K x N), raw row-major pointers with strides
+static void mat_gemm_block(const float* a, size_t as, const float* b, size_t bs,
+                           float* c, size_t cs, size_t M, size_t N, size_t K, int accumulate) {
+    size_t n_main = N / MAT_GEMM_NR * MAT_GEMM_NR;
+    size_t i = 0;
+    for (; i + MAT_GEMM_MR <= M; i += MAT_GEMM_MR) {
+        for (size_t j = 0; j < n_main; j += MAT_GEMM_NR) {
+            mat_gemm_micro(a + i * as, as, b + j, bs, c + i * cs + j, cs, K, accumulate);
+        }
+        if (n_main < N) {
+            for (size_t r = 0; r < MAT_GEMM_MR; r++) {
+                mat_gemm_row(a + (i + r) * as, b + n_main, bs, c + (i + r) * cs + n_main, N - n_main, K, accumulate);
+            }
+        }
+    }
+    for (; i < M; i++) {
+        mat_gemm_row(a + i * as, b, bs, c + i * cs, N, K, accumulate);
+    }
+}
+
+// Same product one row of C at a time, each row an axpy over b that the
+// compiler vectorizes. Streams b once per row, wins when M is small.
+static void mat_gemm_rows(const float* a, size_t as, const float* b, size_t bs,
+                          float* c, size_t cs, size_t M, size_t N, size_t K, int accumulate) {
+    for (size_t i = 0; i < M; i++) {
+        mat_gemm_row(a + i * as, b, bs, c + i * cs, N, K, accumulate);
+    }
+}
+
+// ============================================================================
+// GEMM CONFIGURATION
+// ============================================================================
+
+typedef enum {
+    MAT_GEMM_KERNEL_VEC4X8,     // 4x8 register-blocked vector micro-kernel
+    MAT_GEMM_KERNEL_ROWS,       // one row at a time, compiler-vectorized axpy
+} MatGemmKernel;
+
+typedef enum {
+    MAT_GEMM_ORDER_MNK,         // row blocks outer: a block of a is reused across all of b
+    MAT_GEMM_ORDER_NKM,         // column blocks outer: a kc x nc block of b is reused across all rows
+} MatGemmOrder;
+
+// How mat_mul runs one product. A block size of 0 means the whole dimension,
+// so the default config is the plain register-blocked kernel over the full
+// matrices on the calling thread.
+typedef struct {
+    size_t kc;                  // depth of a K block, partial sums are accumulated in c
+    size_t nc;                  // columns of an N block, rounded up to MAT_GEMM_NR
+    size_t mc;                  // rows of an M block, rounded up to MAT_GEMM_MR
+    MatGemmKernel kernel;
+    MatGemmOrder order;
+    size_t threads;             // rows of c are split across this many threads
+} MatGemmConfig;
+
+static const MatGemmConfig mat_gemm_default_config = {0, 0, 0, MAT_GEMM_KERNEL_VEC4X8, MAT_GEMM_ORDER_MNK, 1};
+
+// Per-shape overrides consulted by mat_mul, filled by an autotuner. Not
+// synchronized: install them before other threads start multiplying.
+#define MAT_GEMM_MAX_CONFIGS 64
+
+typedef struct {
+    size_t M, N, K;
+    MatGemmConfig config;
+} MatGemmShapeConfig;
+
+static MatGemmShapeConfig mat_gemm_configs[MAT_GEMM_MAX_CONFIGS];
+static size_t mat_gemm_num_configs = 0;
+
+// replaces an existing entry for the shape, -1 when the table is full
+int mat_gemm_set_config(size_t M, size_t N, size_t K, const MatGemmConfig* config) {
+    if (!config) return -1;
+    for (size_t i = 0; i < mat_gemm_num_configs; i++) {
+        MatGemmShapeConfig* e = &mat_gemm_configs[i];
+        if (e->M == M && e->N == N && e->K == K) {
+            e->config = *config;
+            return 0;
+        }
+    }
+    if (mat_gemm_num_configs == MAT_GEMM_MAX_CONFIGS) return -1;
+    MatGemmShapeConfig* e = &mat_gemm_configs[mat_gemm_num_configs++];
+    e->M = M;
+    e->N = N;
+    e->K = K;
+    e->config = *config;
+    return 0;
+}
+
+const MatGemmConfig* mat_gemm_get_config(size_t M, size_t N, size_t K) {
+    for (size_t i = 0; i < mat_gemm_num_configs; i++) {
+        const MatGemmShapeConfig* e = &mat_gemm_configs[i];
+        if (e->M == M && e->N == N && e->K == K) return &e->config;
+    }
+    return &mat_gemm_default_config;
+}
+
+void mat_gemm_clear_configs() {
+    mat_gemm_num_configs = 0;
+}
+
+static inline size_t mat_gemm_round(size_t block, size_t full, size_t multiple) {
+    if (block == 0 || block >= full) return full;
+    return (block + multiple - 1) / multiple * multiple;
+}
+
+// Rows [0..M) of C with the blocking of cfg, single-threaded. Every K block
+// after the first accumulates into c, the first one overwrites it.
+static void mat_gemm_tiled(const MatGemmConfig* cfg, const float* a, size_t as, const float* b, size_t bs,
+                           float* c, size_t cs, size_t M, size_t N, size_t K) {
+    void (*kernel)(const float*, size_t, const float*, size_t, float*, size_t, size_t, size_t, size_t, int) =
+        cfg->kernel == MAT_GEMM_KERNEL_ROWS ? mat_gemm_rows : mat_gemm_block;
+    size_t kc = mat_gemm_round(cfg->kc, K, 1);
+    size_t nc = mat_gemm_round(cfg->nc, N, MAT_GEMM_NR);
+    size_t mc = mat_gemm_round(cfg->mc, M, MAT_GEMM_MR);
+    if (K == 0) {
+        for (size_t i = 0; i < M; i++) memset(c + i * cs, 0, N * sizeof(float));
+        return;
+    }
+
+    if (cfg->order == MAT_GEMM_ORDER_NKM) {
+        for (size_t j = 0; j < N; j += nc) {
+            size_t nj = N - j < nc ? N - j : nc;
+            for (size_t k = 0; k < K; k += kc) {
+                size_t kk = K - k < kc ? K - k : kc;
+                for (size_t i = 0; i < M; i += mc) {
+                    size_t mi = M - i < mc ? M - i : mc;
+                    kernel(a + i * as + k, as, b + k * bs + j, bs, c + i * cs + j, cs, mi, nj, kk, k > 0);
+                }
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < M; i += mc) {
+        size_t mi = M - i < mc ? M - i : mc;
+        for (size_t j = 0; j < N; j += nc) {
+            size_t nj = N - j < nc ? N - j : nc;
+            for (size_t k = 0; k < K; k += kc) {
+                size_t kk = K - k < kc ? K - k : kc;
+                kernel(a + i * as + k, as, b + k * bs + j, bs, c + i * cs + j, cs, mi, nj, kk, k > 0);
+            }
+        }
+    }
+}
+
+// ============================================================================
+// GEMM WORKER POOL
+// ============================================================================
+
+// Threaded products run on workers that persist across calls instead of
+// threads created and joined per mat_mul. A product is cut into `parts` row
+// ranges on MAT_GEMM_MR boundaries, so no two share a row of c; the caller
+// runs part 0 and worker w runs part w + 1. One product uses the pool at a
+// time, a caller that finds it busy runs its product alone. A forked child
+// inherits the pool but none of its threads, so it starts over empty.
+
+#define MAT_GEMM_MAX_THREADS 64
+
+typedef struct {
+    const MatGemmConfig* cfg;
+    const float *a, *b;
+    float* c;
+    size_t as, bs, cs, M, N, K;
+    size_t groups;              // MAT_GEMM_MR row groups of c
+    size_t parts;
+} MatGemmJob;
+
+struct MatGemmPool {
+    std::mutex busy;            // held by the caller whose product is running
+    std::mutex lock;
+    std::condition_variable start, done;
+    std::thread workers[MAT_GEMM_MAX_THREADS - 1];
+    size_t num_workers;         // started so far, never shrinks
+    MatGemmJob job;
+    size_t generation;          // bumped for every product
+    size_t pending;             // workers still on the current product
+    bool stopping;
+    bool atfork_registered;
+
+    // workers are parked on `start`, they must be joined before exit
+    ~MatGemmPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        start.notify_all();
+        for (size_t w = 0; w < num_workers; w++) workers[w].join();
+    }
+};
+
+static MatGemmPool mat_gemm_pool;
+
+// pthread_atfork child handler: the workers exist only in the parent and the
+// locks may have been held by one of them, rebuild everything in place
+static void mat_gemm_pool_reset_after_fork() {
+    MatGemmPool* pool = &mat_gemm_pool;
+    new (&pool->busy) std::mutex();
+    new (&pool->lock) std::mutex();
+    new (&pool->start) std::condition_variable();
+    new (&pool->done) std::condition_variable();
+    for (size_t w = 0; w < pool->num_workers; w++) new (&pool->workers[w]) std::thread();
+    pool->num_workers = 0;
+    pool->generation = 0;
+    pool->pending = 0;
+    pool->stopping = false;
+}
+
+static void mat_gemm_part(const MatGemmJob* job, size_t part) {
+    size_t begin = job->groups * part / job->parts * MAT_GEMM_MR;
+    size_t end = job->groups * (part + 1) / job->parts * MAT_GEMM_MR;
+    if (end > job->M) end = job->M;
+    mat_gemm_tiled(job->cfg, job->a + begin * job->as, job->as, job->b, job->bs, job->c + begin * job->cs,
+                   job->cs, end - begin, job->N, job->K);
+}
+
+static void mat_gemm_worker(MatGemmPool* pool, size_t index) {
+    size_t seen = 0;
+    std::unique_lock<std::mutex> guard(pool->lock);
+    for (;;) {
+        pool->start.wait(guard, [pool, seen] { return pool->stopping || pool->generation != seen; });
+        if (pool->stopping) return;
+        seen = pool->generation;
+        if (index + 1 >= pool->job.parts) continue;     // not needed for this product
+
+        MatGemmJob job = pool->job;
+        guard.unlock();
+        mat_gemm_part(&job, index + 1);
+        guard.lock();
+        if (--pool->pending == 0) pool->done.notify_one();
+    }
+}
+
+// C = A * B with an explicit config, cfg->threads row ranges in parallel
+static void mat_gemm_run(const MatGemmConfig* cfg, const float* a, size_t as, const float* b, size_t bs,
+                         float* c, size_t cs, size_t M, size_t N, size_t K) {
+    size_t groups = (M + MAT_GEMM_MR - 1) / MAT_GEMM_MR;
+    size_t threads = cfg->threads < groups ? cfg->threads : groups;
+    if (threads > MAT_GEMM_MAX_THREADS) threads = MAT_GEMM_MAX_THREADS;
+    MatGemmPool* pool = &mat_gemm_pool;
+    if (threads <= 1 || !pool->busy.try_lock()) {
+        mat_gemm_tiled(cfg, a, as, b, bs, c, cs, M, N, K);
+        return;
+    }
+
+    MatGemmJob job = {cfg, a, b, c, as, bs, cs, M, N, K, groups, threads};
+    {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        if (!pool->atfork_registered) {
+            pthread_atfork(NULL, NULL, mat_gemm_pool_reset_after_fork);
+            pool->atfork_registered = true;
+        }
+        while (pool->num_workers < threads - 1) {
+            pool->workers[pool->num_workers] = std::thread(mat_gemm_worker, pool, pool->num_workers);
+            pool->num_workers++;
+        }
+        pool->job = job;
+        pool->pending = threads - 1;
+        pool->generation++;
+    }
+    pool->start.notify_all();
+
+    mat_gemm_part(&job, 0);
+
+    {
+        std::unique_lock<std::mutex> guard(pool->lock);
+        pool->done.wait(guard, [pool] { return pool->pending == 0; });
+    }
+    pool->busy.unlock();
+}
+
+// result = a * b through the blocked kernels with an explicit config, no
+// matrix-vector shortcut. mat_mul uses the config installed for the shape.
+int mat_mul_config(const Matrix* a, const Matrix* b, Matrix* result, const MatGemmConfig* config) {
+    if (!mat_is_valid(a) || !mat_is_valid(b) || !mat_is_valid(result) || !config) return -1;
+    if (a->cols != b->rows) return -1;
+    if (result->rows != a->rows || result->cols != b->cols) return -1;
+
+    // Register-blocked: 4 rows x 8 columns of result stay in registers while
+    // k runs, each row of b is loaded once per 4 rows of a. With both b and
+    // result padded the column range covers the padding (it stays 0) and there
+    // is no column remainder.
+    size_t width = b->cols;
+    if (mat_is_padded(b) && mat_is_padded(result) && b->stride == result->stride) {
+        width = b->stride;
+    }
+    mat_gemm_run(config, a->data, a->stride, b->data, b->stride, result->data, result->stride,
+                 a->rows, width, a->cols);
+    return 0;
+}
+
 int mat_mul(const Matrix* a, const Matrix* b, Matrix* result) {
     if (!a || !b || !result) return -1;
     if (!mat_is_valid(a) || !mat_is_valid(b) || !mat_is_valid(result)) return -1;
     if (a->cols != b->rows) return -1;
     if (result->rows != a->rows || result->cols != b->cols) return -1;
     
+    // matrix x vector: one dot product per row, 16 independent partial sums
+    // so the loop vectorizes without reassociating
+    if (b->cols == 1) {
+        const float* x = b->data;
+        size_t bs = b->stride;
+        size_t n = a->cols;
+        for (size_t i = 0; i < a->rows; i++) {
+            const float* row = a->data + i * a->stride;
+            float sum = 0.0f;
+            if (bs == 1) {
+                float acc[MAT_SIMD_FLOATS] = {0};
+                size_t k = 0;
+                for (; k + MAT_SIMD_FLOATS <= n; k += MAT_SIMD_FLOATS) {
+                    for (size_t l = 0; l < MAT_SIMD_FLOATS; l++) {
+                        acc[l] += row[k + l] * x[k + l];
+                    }
+                }
+                for (; k < n; k++) {
+                    sum += row[k] * x[k];
+                }
+                for (size_t l = 0; l < MAT_SIMD_FLOATS; l++) {
+                    sum += acc[l];
+                }
+            } else {
+                for (size_t k = 0; k < n; k++) {
+                    sum += row[k] * x[k * bs];
+                }
+            }
+            result->data[i * result->stride] = sum;
+        }
+        return 0;
+    }
+    
+    return mat_mul_config(a, b, result, mat_gemm_get_config(a->rows, b->cols, a->cols));
+}
+
+// result = a^T * b without materializing the transpose. a is (K x M), b is
+// (K x N). With accumulate != 0 the product is added to result.
+int mat_mul_tn(const Matrix* a, const Matrix* b, Matrix* result, int accumulate) {
+    if (!mat_is_valid(a) || !mat_is_valid(b) || !mat_is_valid(result)) return -1;
+    if (a->rows != b->rows) return -1;
+    if (result->rows != a->cols || result->cols != b->cols) return -1;
+    
+    if (!accumulate) {
+        mat_zero(result);
+    }
+    
+    // rank-1 update per k: row k of b scaled into every row of result
+    for (size_t k = 0; k < a->rows; k++) {
+        const float* a_row = a->data + k * a->stride;
+        const float* b_row = b->data + k * b->stride;
+        for (size_t i = 0; i < a->cols; i++) {
+            float aki = a_row[i];
+            float* c = result->data + i * result->stride;
+            for (size_t j = 0; j < b->cols; j++) {
+                c[j] += aki * b_row[j];
+            }
+        }
+    }
+    return 0;
+}
+
+// result = a * b^T without materializing the transpose. a is (M x K), b is
+// (N x K). With accumulate != 0 the product is added to result.
+int mat_mul_nt(const Matrix* a, const Matrix* b, Matrix* result, int accumulate) {
+    if (!mat_is_valid(a) || !mat_is_valid(b) || !mat_is_valid(result)) return -1;
+    if (a->cols != b->cols) return -1;
+    if (result->rows != a->rows || result->cols != b->rows) return -1;
+    
+    size_t K = a->cols;
     for (size_t i = 0; i < a->rows; i++) {
-        for (size_t j = 0; j < b->cols; j++) {
+        const float* a_row = a->data + i * a->stride;
+        float* c = result->data + i * result->stride;
+        for (size_t j = 0; j < b->rows; j++) {
+            const float* b_row = b->data + j * b->stride;
+            float acc[MAT_SIMD_FLOATS] = {0};
             float sum = 0.0f;
-            for (size_t k = 0; k < a->cols; k++) {
-                sum += mat_get(a, i, k) * mat_get(b, k, j);
+            size_t k = 0;
+            for (; k + MAT_SIMD_FLOATS <= K; k += MAT_SIMD_FLOATS) {
+                for (size_t l = 0; l < MAT_SIMD_FLOATS; l++) {
+                    acc[l] += a_row[k + l] * b_row[k + l];
+                }
             }
-            mat_set_unsafe(result, i, j, sum);
+            for (; k < K; k++) {
+                sum += a_row[k] * b_row[k];
+            }
+            for (size_t l = 0; l < MAT_SIMD_FLOATS; l++) {
+                sum += acc[l];
+            }
+            c[j] = accumulate ? c[j] + sum : sum;
         }
     }
     return 0;
@@ -217,10 +791,20 @@ int mat_add(const Matrix* a, const Matrix* b, Matrix* result) {
     if (a->rows != b->rows || a->cols != b->cols) return -1;
     if (result->rows != a->rows || result->cols != a->cols) return -1;
     
+    size_t n = mat_flat_span(a, b, result);
+    if (n) {
+        for (size_t i = 0; i < n; i++) {
+            result->data[i] = a->data[i] + b->data[i];
+        }
+        return 0;
+    }
+    
     for (size_t i = 0; i < a->rows; i++) {
+        const float* ra = a->data + i * a->stride;
+        const float* rb = b->data + i * b->stride;
+        float* rc = result->data + i * result->stride;
         for (size_t j = 0; j < a->cols; j++) {
-            float sum = mat_get(a, i, j) + mat_get(b, i, j);
-            mat_set_unsafe(result, i, j, sum);
+            rc[j] = ra[j] + rb[j];
         }
     }
     return 0;
@@ -232,10 +816,20 @@ int mat_sub(const Matrix* a, const Matrix* b, Matrix* result) {
     if (a->rows != b->rows || a->cols != b->cols) return -1;
     if (result->rows != a->rows || result->cols != a->cols) return -1;
 
+    size_t n = mat_flat_span(a, b, result);
+    if (n) {
+        for (size_t i = 0; i < n; i++) {
+            result->data[i] = a->data[i] - b->data[i];
+        }
+        return 0;
+    }
+    
     for (size_t i = 0; i < a->rows; i++) {
+        const float* ra = a->data + i * a->stride;
+        const float* rb = b->data + i * b->stride;
+        float* rc = result->data + i * result->stride;
         for (size_t j = 0; j < a->cols; j++) {
-            float diff = mat_get(a, i, j) - mat_get(b, i, j);
-            mat_set_unsafe(result, i, j, diff);
+            rc[j] = ra[j] - rb[j];
         }
     }
     
@@ -249,8 +843,9 @@ int mat_transpose(const Matrix* a, Matrix* result) {
     if (result->rows != a->cols || result->cols != a->rows) return -1;
     
     for (size_t i = 0; i < a->rows; i++) {
+        const float* ra = a->data + i * a->stride;
         for (size_t j = 0; j < a->cols; j++) {
-            mat_set_unsafe(result, j, i, mat_get(a, i, j));
+            result->data[j * result->stride + i] = ra[j];
         }
     }
     
@@ -263,10 +858,20 @@ int mat_hadamard(const Matrix* a, const Matrix* b, Matrix* result) {
     if (a->rows != b->rows || a->cols != b->cols) return -1;
     if (result->rows != a->rows || result->cols != a->cols) return -1;
     
+    size_t n = mat_flat_span(a, b, result);
+    if (n) {
+        for (size_t i = 0; i < n; i++) {
+            result->data[i] = a->data[i] * b->data[i];
+        }
+        return 0;
+    }
+    
     for (size_t i = 0; i < a->rows; i++) {
+        const float* ra = a->data + i * a->stride;
+        const float* rb = b->data + i * b->stride;
+        float* rc = result->data + i * result->stride;
         for (size_t j = 0; j < a->cols; j++) {
-            float product = mat_get(a, i, j) * mat_get(b, i, j);
-            mat_set_unsafe(result, i, j, product);
+            rc[j] = ra[j] * rb[j];
         }
     }
     
@@ -274,13 +879,22 @@ int mat_hadamard(const Matrix* a, const Matrix* b, Matrix* result) {
 }
 
 void mat_scale(const Matrix* a, float scalar, Matrix* result) {
-    if (!mat_is_valid(a) || !result) return;
+    if (!mat_is_valid(a) || !mat_is_valid(result)) return;
     if (result->rows != a->rows || result->cols != a->cols) return;
     
+    size_t n = mat_flat_span(a, a, result);
+    if (n) {
+        for (size_t i = 0; i < n; i++) {
+            result->data[i] = a->data[i] * scalar;
+        }
+        return;
+    }
+    
     for (size_t i = 0; i < a->rows; i++) {
+        const float* ra = a->data + i * a->stride;
+        float* rc = result->data + i * result->stride;
         for (size_t j = 0; j < a->cols; j++) {
-            float value = mat_get(a, i, j) * scalar;
-            mat_set_unsafe(result, i, j, value);
+            rc[j] = ra[j] * scalar;
         }
     }
 }
@@ -330,11 +944,14 @@ M_Stats mat_stats(const Matrix* mat) {
     stats.min = mat->data[0];
     stats.max = mat->data[0];
     
-    for (size_t i = 0; i < total_elements; i++) {
-        float val = mat->data[i];
-        stats.sum += val;
-        if (val < stats.min) stats.min = val;
-        if (val > stats.max) stats.max = val;
+    for (size_t i = 0; i < mat->rows; i++) {
+        const float* row = mat->data + i * mat->stride;
+        for (size_t j = 0; j < mat->cols; j++) {
+            float val = row[j];
+            stats.sum += val;
+            if (val < stats.min) stats.min = val;
+            if (val > stats.max) stats.max = val;
+        }
     }
     
     stats.mean = stats.sum / total_elements;
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "Matrix.hpp"
+#include <math.h>
+
+// Lazy element-wise expressions over Matrix.
+//
+//   mat_assign(out, (mx(a) - mx(b)) * mx_map(sigmoid_derivative, mx(z)) * 0.5f);
+//
+// builds a small expression object and evaluates it in one loop, with no
+// temporary matrices. Leaves are wrapped with mx(), scalars broadcast, '*' is
+// the element-wise (hadamard) product. Every node is a tiny value type, so
+// expressions can be built from temporaries safely.
+
+namespace matexpr
+{
+  template <typename E>
+  struct Expr {
+    const E& self() const { return static_cast<const E&>(*this); }
+  };
+
+  // Leaf over a Matrix (stride aware)
+  struct Ref : Expr<Ref> {
+    const float* data;
+    size_t rows, cols, stride;
+
+    explicit Ref(const Matrix* m)
+      : data(m ? m->data : NULL), rows(m ? m->rows : 0), cols(m ? m->cols : 0), stride(m ? m->stride : 0) {}
+
+    float at(size_t i, size_t j) const { return data[i * stride + j]; }
+    float flat(size_t k) const { return data[k]; }
+    bool ok() const { return data != NULL; }
+    bool contiguous() const { return stride == cols; }
+  };
+
+  // Broadcast scalar, rows/cols of 0 mean "any shape"
+  struct Scalar : Expr<Scalar> {
+    float value;
+    size_t rows, cols;
+
+    explicit Scalar(float v) : value(v), rows(0), cols(0) {}
+
+    float at(size_t, size_t) const { return value; }
+    float flat(size_t) const { return value; }
+    bool ok() const { return true; }
+    bool contiguous() const { return true; }
+  };
+
+  struct OpAdd { static float apply(float a, float b) { return a + b; } };
+  struct OpSub { static float apply(float a, float b) { return a - b; } };
+  struct OpMul { static float apply(float a, float b) { return a * b; } };
+  struct OpDiv { static float apply(float a, float b) { return a / b; } };
+
+  template <typename Op, typename L, typename R>
+  struct Binary : Expr<Binary<Op, L, R> > {
+    L l;
+    R r;
+    size_t rows, cols;
+
+    Binary(const L& l_, const R& r_)
+      : l(l_), r(r_), rows(l_.rows ? l_.rows : r_.rows), cols(l_.cols ? l_.cols : r_.cols) {}
+
+    float at(size_t i, size_t j) const { return Op::apply(l.at(i, j), r.at(i, j)); }
+    float flat(size_t k) const { return Op::apply(l.flat(k), r.flat(k)); }
+    bool ok() const {
+      if (!l.ok() || !r.ok()) return false;
+      if (l.rows && r.rows && (l.rows != r.rows || l.cols != r.cols)) return false;
+      return true;
+    }
+    bool contiguous() const { return l.contiguous() && r.contiguous(); }
+  };
+
+  // f(x) per element, F is a function pointer or functor
+  template <typename F, typename E>
+  struct Map : Expr<Map<F, E> > {
+    F f;
+    E e;
+    size_t rows, cols;
+
+    Map(F f_, const E& e_) : f(f_), e(e_), rows(e_.rows), cols(e_.cols) {}
+
+    float at(size_t i, size_t j) const { return f(e.at(i, j)); }
+    float flat(size_t k) const { return f(e.flat(k)); }
+    bool ok() const { return e.ok(); }
+    bool contiguous() const { return e.contiguous(); }
+  };
+
+  struct Square { float operator()(float x) const { return x * x; } };
+  struct Abs { float operator()(float x) const { return fabsf(x); } };
+  struct Sign { float operator()(float x) const { return x > 0.0f ? 1.0f : -1.0f; } };
+  struct Clamp {
+    float lo, hi;
+    float operator()(float x) const { return x < lo ? lo : (x > hi ? hi : x); }
+  };
+
+#define MATEXPR_BINARY_OP(OP, TAG)                                                         \
+  template <typename L, typename R>                                                        \
+  Binary<TAG, L, R> operator OP(const Expr<L>& l, const Expr<R>& r) {                      \
+    return Binary<TAG, L, R>(l.self(), r.self());                                          \
+  }                                                                                        \
+  template <typename L>                                                                    \
+  Binary<TAG, L, Scalar> operator OP(const Expr<L>& l, float r) {                          \
+    return Binary<TAG, L, Scalar>(l.self(), Scalar(r));                                    \
+  }                                                                                        \
+  template <typename R>                                                                    \
+  Binary<TAG, Scalar, R> operator OP(float l, const Expr<R>& r) {                          \
+    return Binary<TAG, Scalar, R>(Scalar(l), r.self());                                    \
+  }
+
+  MATEXPR_BINARY_OP(+, OpAdd)
+  MATEXPR_BINARY_OP(-, OpSub)
+  MATEXPR_BINARY_OP(*, OpMul)
+  MATEXPR_BINARY_OP(/, OpDiv)
+
+#undef MATEXPR_BINARY_OP
+
+  template <typename E>
+  Binary<OpMul, Scalar, E> operator-(const Expr<E>& e) {
+    return Binary<OpMul, Scalar, E>(Scalar(-1.0f), e.self());
+  }
+}
+
+// ============================================================================
+// BUILDERS
+// ============================================================================
+
+static inline matexpr::Ref mx(const Matrix* m) {
+  return matexpr::Ref(m);
+}
+
+template <typename F, typename E>
+matexpr::Map<F, E> mx_map(F f, const matexpr::Expr<E>& e) {
+  return matexpr::Map<F, E>(f, e.self());
+}
+
+template <typename E>
+matexpr::Map<matexpr::Square, E> mx_square(const matexpr::Expr<E>& e) {
+  return matexpr::Map<matexpr::Square, E>(matexpr::Square(), e.self());
+}
+
+template <typename E>
+matexpr::Map<matexpr::Abs, E> mx_abs(const matexpr::Expr<E>& e) {
+  return matexpr::Map<matexpr::Abs, E>(matexpr::Abs(), e.self());
+}
+
+template <typename E>
+matexpr::Map<matexpr::Sign, E> mx_sign(const matexpr::Expr<E>& e) {
+  return matexpr::Map<matexpr::Sign, E>(matexpr::Sign(), e.self());
+}
+
+template <typename E>
+matexpr::Map<matexpr::Clamp, E> mx_clamp(const matexpr::Expr<E>& e, float lo, float hi) {
+  matexpr::Clamp c;
+  c.lo = lo;
+  c.hi = hi;
+  return matexpr::Map<matexpr::Clamp, E>(c, e.self());
+}
+
+// ============================================================================
+// EVALUATION
+// ============================================================================
+
+// out = e, in a single pass. out may alias any leaf of e.
+template <typename E>
+int mat_assign(Matrix* out, const matexpr::Expr<E>& expr) {
+  const E& e = expr.self();
+  if (!mat_is_valid(out) || !e.ok()) return -1;
+  if (e.rows && (e.rows != out->rows || e.cols != out->cols)) return -1;
+
+  if (e.contiguous() && out->stride == out->cols) {
+    size_t n = out->rows * out->cols;
+    float* o = out->data;
+    for (size_t k = 0; k < n; k++) {
+      o[k] = e.flat(k);
+    }
+    return 0;
+  }
+
+  for (size_t i = 0; i < out->rows; i++) {
+    float* o = out->data + i * out->stride;
+    for (size_t j = 0; j < out->cols; j++) {
+      o[j] = e.at(i, j);
+    }
+  }
+  return 0;
+}
+
+// Sum of all elements of e (0 for an empty / invalid expression)
+template <typename E>
+float mat_sum(const matexpr::Expr<E>& expr) {
+  const E& e = expr.self();
+  if (!e.ok() || !e.rows) return 0.0f;
+
+  float sum = 0.0f;
+  if (e.contiguous()) {
+    size_t n = e.rows * e.cols;
+    for (size_t k = 0; k < n; k++) {
+      sum += e.flat(k);
+    }
+    return sum;
+  }
+
+  for (size_t i = 0; i < e.rows; i++) {
+    for (size_t j = 0; j < e.cols; j++) {
+      sum += e.at(i, j);
+    }
+  }
+  return sum;
+}
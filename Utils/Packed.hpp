@@ -0,0 +1,257 @@
+#pragma once
+
+#include "Matrix.hpp"
+#include "MatrixExpr.hpp"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compact storage for activations that are saved between forward and backward.
+// A packed matrix is write-once (packed_encode) / read-many (packed_get), it is
+// not meant to be used as an operand of the regular Matrix kernels.
+
+typedef enum {
+    PACK_MASK,      // 1 bit per element, stores (x > 0). Only good for ReLU derivatives
+    PACK_FP16,      // IEEE half precision
+    PACK_BF16,      // bfloat16 (fp32 exponent range, 8 bit mantissa)
+} PackFormat;
+
+typedef struct {
+    void *data;
+    size_t rows;
+    size_t cols;
+    size_t bytes;       // size of data
+    PackFormat format;
+} PackedMatrix;
+
+// ============================================================================
+// SCALAR CONVERSIONS
+// ============================================================================
+
+static inline uint16_t f32_to_f16(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t f_exp = (x >> 23) & 0xff;
+    uint32_t mant = x & 0x7fffff;
+
+    if (f_exp == 0xff) {
+        return (uint16_t)(sign | 0x7c00 | (mant ? 0x200 : 0));  // inf / nan
+    }
+
+    int32_t exp = (int32_t)f_exp - 127 + 15;
+    if (exp >= 31) {
+        return (uint16_t)(sign | 0x7c00);  // overflow -> inf
+    }
+
+    if (exp <= 0) {
+        // subnormal half (or zero)
+        if (exp < -10) {
+            return (uint16_t)sign;
+        }
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+
+    // round to nearest even, a carry into the exponent is still correct
+    uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;
+    return (uint16_t)half;
+}
+
+static inline float f16_to_f32(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {
+            float f = (float)mant * 5.9604644775390625e-8f;  // mant * 2^-24
+            return sign ? -f : f;
+        }
+    } else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static inline uint16_t f32_to_bf16(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) {
+        return (uint16_t)((x >> 16) | 0x40);  // keep nan quiet
+    }
+    x += 0x7fff + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+}
+
+static inline float bf16_to_f32(uint16_t b) {
+    uint32_t x = (uint32_t)b << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// ============================================================================
+// PACKED MATRIX
+// ============================================================================
+
+size_t packed_bytes_for(size_t rows, size_t cols, PackFormat format) {
+    size_t n = rows * cols;
+    switch (format) {
+        case PACK_MASK:
+            return ((n + 63) / 64) * sizeof(uint64_t);
+        case PACK_FP16:
+        case PACK_BF16:
+        default:
+            return n * sizeof(uint16_t);
+    }
+}
+
+PackedMatrix* packed_create(size_t rows, size_t cols, PackFormat format) {
+    if (rows == 0 || cols == 0) {
+        return NULL;
+    }
+
+    if (rows > SIZE_MAX / cols) {
+        return NULL;
+    }
+
+    PackedMatrix* pm = (PackedMatrix*)malloc(sizeof(PackedMatrix));
+    if (!pm) {
+        return NULL;
+    }
+
+    pm->rows = rows;
+    pm->cols = cols;
+    pm->format = format;
+    pm->bytes = packed_bytes_for(rows, cols, format);
+    pm->data = calloc(1, pm->bytes);
+    if (!pm->data) {
+        free(pm);
+        return NULL;
+    }
+
+    return pm;
+}
+
+void packed_free(PackedMatrix* pm) {
+    if (!pm) {
+        return;
+    }
+
+    if (pm->data) {
+        free(pm->data);
+    }
+
+    free(pm);
+}
+
+int packed_encode(const Matrix* src, PackedMatrix* dst) {
+    if (!mat_is_valid(src) || !dst) return -1;
+    if (src->rows != dst->rows || src->cols != dst->cols) return -1;
+
+    size_t idx = 0;
+    switch (dst->format) {
+        case PACK_MASK: {
+            uint64_t* bits = (uint64_t*)dst->data;
+            memset(bits, 0, dst->bytes);
+            for (size_t i = 0; i < src->rows; i++) {
+                for (size_t j = 0; j < src->cols; j++, idx++) {
+                    if (mat_get_unsafe(src, i, j) > 0.0f) {
+                        bits[idx >> 6] |= (uint64_t)1 << (idx & 63);
+                    }
+                }
+            }
+            break;
+        }
+        case PACK_FP16: {
+            uint16_t* halves = (uint16_t*)dst->data;
+            for (size_t i = 0; i < src->rows; i++) {
+                for (size_t j = 0; j < src->cols; j++, idx++) {
+                    halves[idx] = f32_to_f16(mat_get_unsafe(src, i, j));
+                }
+            }
+            break;
+        }
+        case PACK_BF16: {
+            uint16_t* halves = (uint16_t*)dst->data;
+            for (size_t i = 0; i < src->rows; i++) {
+                for (size_t j = 0; j < src->cols; j++, idx++) {
+                    halves[idx] = f32_to_bf16(mat_get_unsafe(src, i, j));
+                }
+            }
+            break;
+        }
+        default:
+            return -1;
+    }
+
+    return 0;
+}
+
+// Decode a single element. For PACK_MASK this is 1.0f / 0.0f, not the original value.
+static inline float packed_get_flat(const PackedMatrix* pm, size_t idx) {
+    switch (pm->format) {
+        case PACK_MASK:
+            return ((((const uint64_t*)pm->data)[idx >> 6] >> (idx & 63)) & 1) ? 1.0f : 0.0f;
+        case PACK_FP16:
+            return f16_to_f32(((const uint16_t*)pm->data)[idx]);
+        case PACK_BF16:
+            return bf16_to_f32(((const uint16_t*)pm->data)[idx]);
+        default:
+            return 0.0f;
+    }
+}
+
+static inline float packed_get(const PackedMatrix* pm, size_t row, size_t col) {
+    return packed_get_flat(pm, row * pm->cols + col);
+}
+
+int packed_decode(const PackedMatrix* src, Matrix* dst) {
+    if (!src || !mat_is_valid(dst)) return -1;
+    if (src->rows != dst->rows || src->cols != dst->cols) return -1;
+
+    for (size_t i = 0; i < src->rows; i++) {
+        for (size_t j = 0; j < src->cols; j++) {
+            mat_set_unsafe(dst, i, j, packed_get(src, i, j));
+        }
+    }
+
+    return 0;
+}
+
+// Expression leaf, decodes while the expression is evaluated
+namespace matexpr
+{
+  struct PackedRef : Expr<PackedRef> {
+    const PackedMatrix* pm;
+    size_t rows, cols;
+
+    explicit PackedRef(const PackedMatrix* p) : pm(p), rows(p ? p->rows : 0), cols(p ? p->cols : 0) {}
+
+    float at(size_t i, size_t j) const { return packed_get(pm, i, j); }
+    float flat(size_t k) const { return packed_get_flat(pm, k); }
+    bool ok() const { return pm != NULL; }
+    bool contiguous() const { return true; }
+  };
+}
+
+static inline matexpr::PackedRef mx(const PackedMatrix* pm) {
+  return matexpr::PackedRef(pm);
+}
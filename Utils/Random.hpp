@@ -0,0 +1,230 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Counter-based random numbers (Philox4x32-10, Salmon et al. 2011).
+//
+// Every 128-bit output block is a pure function of (key, counter), so the
+// i-th number of a stream can be computed directly without generating the
+// ones before it. The bulk fillers below define element i of a fill as lane
+// i % 4 of block i / 4, which means a range can be split across any number
+// of threads and still produce exactly the same values for a given seed.
+//
+// A stream is (seed, stream id): the seed is the Philox key, the stream id
+// occupies the upper half of the counter and the element index the lower
+// half. Rng wraps a stream for sequential use (shuffling, sampling).
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define RNG_PARALLEL_MIN 65536      // elements per thread worth spawning for
+
+typedef struct {
+    uint32_t key[2];
+    uint32_t stream[2];             // counter words 2 and 3
+} RngStream;
+
+typedef struct {
+    RngStream s;
+    uint64_t counter;               // next block
+    uint32_t block[4];
+    unsigned used;                  // lanes of block already handed out
+} Rng;
+
+static inline RngStream rng_stream(uint64_t seed, uint64_t stream_id) {
+    RngStream s;
+    s.key[0] = (uint32_t)seed;
+    s.key[1] = (uint32_t)(seed >> 32);
+    s.stream[0] = (uint32_t)stream_id;
+    s.stream[1] = (uint32_t)(stream_id >> 32);
+    return s;
+}
+
+static inline void philox4x32_10(const RngStream* s, uint64_t block, uint32_t out[4]) {
+    uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32);
+    uint32_t c2 = s->stream[0], c3 = s->stream[1];
+    uint32_t k0 = s->key[0], k1 = s->key[1];
+
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Top 24 bits -> [0, 1), exactly representable
+static inline float rng_u32_to_unit(uint32_t x) {
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// ============================================================================
+// BULK FILLS (element i depends only on the stream and offset + i)
+// ============================================================================
+
+#define RNG_BATCH_BLOCKS 8  // blocks generated together so the rounds vectorize
+
+// Calls emit(index, block) for every block touching [offset, offset + n)
+template <typename F>
+static inline void rng_for_blocks(const RngStream* s, uint64_t offset, size_t n, F emit) {
+    uint64_t first = offset / 4;
+    uint64_t last = (offset + n + 3) / 4;
+    uint32_t blocks[RNG_BATCH_BLOCKS][4];
+
+    for (uint64_t b = first; b < last; b += RNG_BATCH_BLOCKS) {
+        size_t count = last - b < RNG_BATCH_BLOCKS ? (size_t)(last - b) : RNG_BATCH_BLOCKS;
+        for (size_t j = 0; j < count; j++) {
+            philox4x32_10(s, b + j, blocks[j]);
+        }
+        for (size_t j = 0; j < count; j++) {
+            emit(b + j, blocks[j]);
+        }
+    }
+}
+
+// out[i] = uniform in [lo, hi) for element offset + i
+void rng_fill_uniform(RngStream s, uint64_t offset, float* out, size_t n, float lo, float hi) {
+    float span = hi - lo;
+    rng_for_blocks(&s, offset, n, [&](uint64_t block, const uint32_t* r) {
+        for (size_t lane = 0; lane < 4; lane++) {
+            uint64_t idx = block * 4 + lane;
+            if (idx >= offset && idx < offset + n) out[idx - offset] = lo + span * rng_u32_to_unit(r[lane]);
+        }
+    });
+}
+
+// out[i] = normal(mean, stddev) for element offset + i (Box-Muller on lane pairs)
+void rng_fill_normal(RngStream s, uint64_t offset, float* out, size_t n, float mean, float stddev) {
+    rng_for_blocks(&s, offset, n, [&](uint64_t block, const uint32_t* r) {
+        for (size_t pair = 0; pair < 2; pair++) {
+            // (0, 1] keeps the log finite
+            float u1 = 1.0f - rng_u32_to_unit(r[2 * pair]);
+            float u2 = rng_u32_to_unit(r[2 * pair + 1]);
+            float radius = sqrtf(-2.0f * logf(u1)) * stddev;
+            float angle = 6.28318530718f * u2;
+            uint64_t idx = block * 4 + 2 * pair;
+            if (idx >= offset && idx < offset + n) out[idx - offset] = mean + radius * cosf(angle);
+            if (idx + 1 >= offset && idx + 1 < offset + n) out[idx + 1 - offset] = mean + radius * sinf(angle);
+        }
+    });
+}
+
+// Inverted dropout mask: 1 / keep_prob with probability keep_prob, else 0
+void rng_fill_dropout(RngStream s, uint64_t offset, float* out, size_t n, float keep_prob) {
+    uint32_t threshold = keep_prob >= 1.0f ? UINT32_MAX : (uint32_t)(keep_prob * 4294967296.0);
+    float scale = keep_prob > 0.0f ? 1.0f / keep_prob : 0.0f;
+    rng_for_blocks(&s, offset, n, [&](uint64_t block, const uint32_t* r) {
+        for (size_t lane = 0; lane < 4; lane++) {
+            uint64_t idx = block * 4 + lane;
+            if (idx >= offset && idx < offset + n) out[idx - offset] = r[lane] < threshold ? scale : 0.0f;
+        }
+    });
+}
+
+// Runs fn(begin, end) over [0, n) on up to `threads` threads (0 = all cores).
+// Only worth it for large n; results must not depend on the split.
+template <typename F>
+void rng_parallel_for(size_t n, size_t threads, F fn) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    if (threads > n / RNG_PARALLEL_MIN) threads = n / RNG_PARALLEL_MIN;
+    if (threads <= 1) {
+        fn((size_t)0, n);
+        return;
+    }
+
+    std::thread* workers = new std::thread[threads - 1];
+    for (size_t t = 1; t < threads; t++) {
+        workers[t - 1] = std::thread(fn, n * t / threads, n * (t + 1) / threads);
+    }
+    fn((size_t)0, n / threads);
+    for (size_t t = 1; t < threads; t++) {
+        workers[t - 1].join();
+    }
+    delete[] workers;
+}
+
+// ============================================================================
+// SEQUENTIAL STREAM
+// ============================================================================
+
+static inline void rng_init(Rng* rng, uint64_t seed, uint64_t stream_id) {
+    rng->s = rng_stream(seed, stream_id);
+    rng->counter = 0;
+    rng->used = 4;
+}
+
+static inline uint32_t rng_next_u32(Rng* rng) {
+    if (rng->used == 4) {
+        philox4x32_10(&rng->s, rng->counter++, rng->block);
+        rng->used = 0;
+    }
+    return rng->block[rng->used++];
+}
+
+static inline float rng_uniform(Rng* rng) {
+    return rng_u32_to_unit(rng_next_u32(rng));
+}
+
+// Uniform integer in [0, bound), unbiased (Lemire's multiply-shift with rejection)
+static inline uint32_t rng_below(Rng* rng, uint32_t bound) {
+    uint64_t m = (uint64_t)rng_next_u32(rng) * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound) {
+        uint32_t threshold = (uint32_t)(-bound) % bound;
+        while (low < threshold) {
+            m = (uint64_t)rng_next_u32(rng) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+// Fisher-Yates shuffle of idx[0..n)
+static inline void rng_shuffle(Rng* rng, size_t* idx, size_t n) {
+    for (size_t i = n; i > 1; i--) {
+        size_t j = rng_below(rng, (uint32_t)i);
+        size_t tmp = idx[i - 1];
+        idx[i - 1] = idx[j];
+        idx[j] = tmp;
+    }
+}
+
+// ============================================================================
+// GLOBAL SEED
+// ============================================================================
+
+// Seed for models created without an explicit one. Each create_mlp call
+// takes the next model index, so a program that seeds once gets the same
+// sequence of networks on every run.
+static std::atomic<uint64_t> rng_global_seed(0x853c49e6748fea9bull);
+static std::atomic<uint64_t> rng_global_models(0);
+
+void rng_set_global_seed(uint64_t seed) {
+    rng_global_seed.store(seed);
+    rng_global_models.store(0);
+}
+
+// Seed for the next model: the global seed mixed with a running model index (splitmix64)
+uint64_t rng_next_model_seed() {
+    uint64_t z = rng_global_seed.load() + 0x9E3779B97F4A7C15ull * (rng_global_models.fetch_add(1) + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
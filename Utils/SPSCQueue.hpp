@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <stdlib.h>
+#include <stddef.h>
+
+// Bounded lock-free queue of pointers for exactly one producer thread and one
+// consumer thread. head is only written by the consumer, tail only by the
+// producer; each sits on its own cache line so the two sides do not bounce
+// a shared line on every operation.
+
+#define SPSC_CACHE_LINE 64
+#define SPSC_SPIN_LIMIT 64      // busy polls before falling back to yield()
+
+typedef struct {
+    std::atomic<size_t> head;                   // next slot to pop
+    char pad0[SPSC_CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;                   // next slot to push
+    char pad1[SPSC_CACHE_LINE - sizeof(std::atomic<size_t>)];
+    void **slots;
+    size_t mask;                                // capacity - 1, capacity is a power of two
+} SPSCQueue;
+
+// capacity is rounded up to a power of two
+SPSCQueue* spsc_create(size_t capacity) {
+    if (capacity == 0) return NULL;
+
+    size_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+
+    SPSCQueue* q = new SPSCQueue();
+    q->slots = (void**)calloc(cap, sizeof(void*));
+    if (!q->slots) {
+        delete q;
+        return NULL;
+    }
+    q->mask = cap - 1;
+    q->head.store(0);
+    q->tail.store(0);
+    return q;
+}
+
+void spsc_free(SPSCQueue* q) {
+    if (!q) return;
+    free(q->slots);
+    delete q;
+}
+
+// Producer side, 0 on success, -1 if full
+int spsc_try_push(SPSCQueue* q, void* item) {
+    size_t tail = q->tail.load(std::memory_order_relaxed);
+    if (tail - q->head.load(std::memory_order_acquire) > q->mask) return -1;
+
+    q->slots[tail & q->mask] = item;
+    q->tail.store(tail + 1, std::memory_order_release);
+    return 0;
+}
+
+// Consumer side, NULL if empty (so NULL items cannot be queued)
+void* spsc_try_pop(SPSCQueue* q) {
+    size_t head = q->head.load(std::memory_order_relaxed);
+    if (head == q->tail.load(std::memory_order_acquire)) return NULL;
+
+    void* item = q->slots[head & q->mask];
+    q->head.store(head + 1, std::memory_order_release);
+    return item;
+}
+
+// Blocking variants: spin briefly, then yield the core to the other side
+void spsc_push(SPSCQueue* q, void* item) {
+    for (size_t spins = 0; spsc_try_push(q, item) != 0; spins++) {
+        if (spins >= SPSC_SPIN_LIMIT) std::this_thread::yield();
+    }
+}
+
+void* spsc_pop(SPSCQueue* q) {
+    void* item;
+    for (size_t spins = 0; (item = spsc_try_pop(q)) == NULL; spins++) {
+        if (spins >= SPSC_SPIN_LIMIT) std::this_thread::yield();
+    }
+    return item;
+}
+
+size_t spsc_size(const SPSCQueue* q) {
+    return q->tail.load(std::memory_order_acquire) - q->head.load(std::memory_order_acquire);
+}
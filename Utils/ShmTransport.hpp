@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Transport.hpp"
+#include <atomic>
+#include <new>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Transport over one POSIX shared memory segment holding a byte ring per
+// ordered pair of ranks. The segment is created before the workers fork,
+// each worker then calls shm_transport_open() with its rank.
+//
+// Each ring has exactly one writer and one reader process, so a release
+// store of the tail / head is all the synchronisation needed. The atomics
+// must be lock-free to work across processes.
+
+#define SHM_CACHE_LINE 64
+#define SHM_DEFAULT_CHANNEL_BYTES ((size_t)256 << 10)
+
+typedef struct {
+    std::atomic<size_t> head;           // bytes consumed, written by the reader
+    char pad0[SHM_CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;           // bytes produced, written by the writer
+    char pad1[SHM_CACHE_LINE - sizeof(std::atomic<size_t>)];
+} ShmChannel;                           // followed by `capacity` data bytes
+
+typedef struct {
+    char name[64];
+    void *base;
+    size_t bytes;
+    int world;
+    size_t capacity;                    // per channel, a power of two
+    size_t channel_stride;              // header + data, cache line multiple
+    size_t user_offset;                 // start of the caller's area
+    size_t user_bytes;
+} ShmWorld;
+
+static inline ShmChannel* shm_channel(const ShmWorld* w, int from, int to) {
+    return (ShmChannel*)((char*)w->base + (size_t)(from * w->world + to) * w->channel_stride);
+}
+
+static inline char* shm_channel_data(ShmChannel* ch) {
+    return (char*)(ch + 1);
+}
+
+// Area of user_bytes shared by all ranks, e.g. for results (cache line aligned)
+static inline void* shm_world_user(const ShmWorld* w) {
+    return (char*)w->base + w->user_offset;
+}
+
+// Creates the segment for `world` ranks plus user_bytes of shared user area.
+// The name is unlinked as soon as it is mapped, so only processes forked
+// afterwards can reach it and nothing is left behind if they crash.
+ShmWorld* shm_world_create(int world, size_t channel_bytes, size_t user_bytes) {
+    if (world < 1) return NULL;
+    static_assert(sizeof(size_t) == sizeof(long) && ATOMIC_LONG_LOCK_FREE == 2,
+                  "shared memory channels need lock-free atomics");
+
+    size_t cap = SHM_CACHE_LINE;
+    while (cap < channel_bytes) cap <<= 1;
+
+    ShmWorld* w = (ShmWorld*)calloc(1, sizeof(ShmWorld));
+    if (!w) return NULL;
+
+    static std::atomic<unsigned> serial(0);
+    snprintf(w->name, sizeof(w->name), "/nn_shm_%d_%u", (int)getpid(), serial++);
+    w->world = world;
+    w->capacity = cap;
+    w->channel_stride = sizeof(ShmChannel) + cap;
+    w->user_offset = (size_t)world * world * w->channel_stride;
+    w->user_bytes = user_bytes;
+    w->bytes = w->user_offset + ((user_bytes + SHM_CACHE_LINE - 1) & ~(size_t)(SHM_CACHE_LINE - 1));
+
+    int fd = shm_open(w->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        free(w);
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)w->bytes) != 0) {
+        close(fd);
+        shm_unlink(w->name);
+        free(w);
+        return NULL;
+    }
+    w->base = mmap(NULL, w->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    shm_unlink(w->name);
+    if (w->base == MAP_FAILED) {
+        free(w);
+        return NULL;
+    }
+
+    // ftruncate zero-fills, constructing the atomics just makes that official
+    for (int from = 0; from < world; from++) {
+        for (int to = 0; to < world; to++) {
+            ShmChannel* ch = shm_channel(w, from, to);
+            new (&ch->head) std::atomic<size_t>(0);
+            new (&ch->tail) std::atomic<size_t>(0);
+        }
+    }
+    return w;
+}
+
+void shm_world_free(ShmWorld* w) {
+    if (!w) return;
+    munmap(w->base, w->bytes);
+    free(w);
+}
+
+static ssize_t shm_send(Transport* t, int peer, const void* buf, size_t bytes) {
+    const ShmWorld* w = (const ShmWorld*)t->ctx;
+    ShmChannel* ch = shm_channel(w, t->rank, peer);
+
+    size_t tail = ch->tail.load(std::memory_order_relaxed);
+    size_t room = w->capacity - (tail - ch->head.load(std::memory_order_acquire));
+    size_t n = bytes < room ? bytes : room;
+    if (n == 0) return 0;
+
+    size_t pos = tail & (w->capacity - 1);
+    size_t first = w->capacity - pos < n ? w->capacity - pos : n;
+    memcpy(shm_channel_data(ch) + pos, buf, first);
+    memcpy(shm_channel_data(ch), (const char*)buf + first, n - first);
+    ch->tail.store(tail + n, std::memory_order_release);
+    return (ssize_t)n;
+}
+
+static ssize_t shm_recv(Transport* t, int peer, void* buf, size_t bytes) {
+    const ShmWorld* w = (const ShmWorld*)t->ctx;
+    ShmChannel* ch = shm_channel(w, peer, t->rank);
+
+    size_t head = ch->head.load(std::memory_order_relaxed);
+    size_t avail = ch->tail.load(std::memory_order_acquire) - head;
+    size_t n = bytes < avail ? bytes : avail;
+    if (n == 0) return 0;
+
+    size_t pos = head & (w->capacity - 1);
+    size_t first = w->capacity - pos < n ? w->capacity - pos : n;
+    memcpy(buf, shm_channel_data(ch) + pos, first);
+    memcpy((char*)buf + first, shm_channel_data(ch), n - first);
+    ch->head.store(head + n, std::memory_order_release);
+    return (ssize_t)n;
+}
+
+static void shm_close(Transport* t) {
+    free(t);
+}
+
+// Endpoint of `rank`, released with transport_close(). The world must outlive it.
+Transport* shm_transport_open(ShmWorld* w, int rank) {
+    if (!w || rank < 0 || rank >= w->world) return NULL;
+
+    Transport* t = (Transport*)calloc(1, sizeof(Transport));
+    if (!t) return NULL;
+    t->name = "shm";
+    t->rank = rank;
+    t->world = w->world;
+    t->send = shm_send;
+    t->recv = shm_recv;
+    t->close = shm_close;
+    t->ctx = w;
+    return t;
+}
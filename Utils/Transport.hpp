@@ -0,0 +1,131 @@
+#pragma once
+
+#include <thread>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+// Point-to-point byte transport between the ranks of a fixed group, and the
+// collectives built on it. A backend only provides non-blocking send / recv
+// that move as many bytes as they can right now. The collectives drive both
+// directions together, so they cannot deadlock however small the backend's
+// buffers are. The shared memory backend lives in ShmTransport.hpp; a socket
+// backend would implement send / recv with non-blocking write / read.
+
+typedef struct Transport {
+    const char *name;
+    int rank;
+    int world;
+
+    // Move up to `bytes` to / from `peer`. Returns the bytes moved (0 when
+    // nothing can move right now) or -1 if the link is broken.
+    ssize_t (*send)(struct Transport *t, int peer, const void *buf, size_t bytes);
+    ssize_t (*recv)(struct Transport *t, int peer, void *buf, size_t bytes);
+    void (*close)(struct Transport *t);
+    void *ctx;
+
+    float *scratch;             // receive buffer of the collectives, grown on demand
+    size_t scratch_floats;
+} Transport;
+
+#define TRANSPORT_SPIN_LIMIT 64
+
+// Send sbuf to `to` while receiving rbuf from `from`, 0 on success
+int transport_sendrecv(Transport* t, int to, const void* sbuf, size_t sbytes,
+                       int from, void* rbuf, size_t rbytes) {
+    const char* s = (const char*)sbuf;
+    char* r = (char*)rbuf;
+    size_t spins = 0;
+
+    while (sbytes > 0 || rbytes > 0) {
+        ssize_t sent = 0, got = 0;
+        if (sbytes > 0) {
+            sent = t->send(t, to, s, sbytes);
+            if (sent < 0) return -1;
+            s += sent;
+            sbytes -= (size_t)sent;
+        }
+        if (rbytes > 0) {
+            got = t->recv(t, from, r, rbytes);
+            if (got < 0) return -1;
+            r += got;
+            rbytes -= (size_t)got;
+        }
+
+        if (sent == 0 && got == 0) {
+            if (++spins >= TRANSPORT_SPIN_LIMIT) std::this_thread::yield();
+        } else {
+            spins = 0;
+        }
+    }
+    return 0;
+}
+
+static float* transport_scratch(Transport* t, size_t floats) {
+    if (t->scratch_floats < floats) {
+        float* grown = (float*)realloc(t->scratch, floats * sizeof(float));
+        if (!grown) return NULL;
+        t->scratch = grown;
+        t->scratch_floats = floats;
+    }
+    return t->scratch;
+}
+
+// In-place sum of data[0..n) over all ranks (ring algorithm). Every rank
+// sends and receives 2 * (world - 1) / world * n floats, whatever the world size.
+int transport_allreduce_sum(Transport* t, float* data, size_t n) {
+    if (!t || (!data && n)) return -1;
+    int world = t->world;
+    if (world == 1 || n == 0) return 0;
+
+    int next = (t->rank + 1) % world;
+    int prev = (t->rank + world - 1) % world;
+    float* tmp = transport_scratch(t, n / world + 1);
+    if (!tmp) return -1;
+
+#define CHUNK_BEGIN(c) ((size_t)(c) * n / world)
+#define CHUNK_LEN(c) (CHUNK_BEGIN((c) + 1) - CHUNK_BEGIN(c))
+
+    // reduce-scatter: after world - 1 rounds rank r owns the full sum of chunk r + 1
+    for (int k = 0; k < world - 1; k++) {
+        int send_c = (t->rank - k + world) % world;
+        int recv_c = (t->rank - k - 1 + 2 * world) % world;
+        if (transport_sendrecv(t, next, data + CHUNK_BEGIN(send_c), CHUNK_LEN(send_c) * sizeof(float),
+                               prev, tmp, CHUNK_LEN(recv_c) * sizeof(float)) != 0) {
+            return -1;
+        }
+        float* dst = data + CHUNK_BEGIN(recv_c);
+        for (size_t i = 0; i < CHUNK_LEN(recv_c); i++) {
+            dst[i] += tmp[i];
+        }
+    }
+
+    // all-gather: pass the finished chunks around the ring
+    for (int k = 0; k < world - 1; k++) {
+        int send_c = (t->rank + 1 - k + world) % world;
+        int recv_c = (t->rank - k + world) % world;
+        if (transport_sendrecv(t, next, data + CHUNK_BEGIN(send_c), CHUNK_LEN(send_c) * sizeof(float),
+                               prev, data + CHUNK_BEGIN(recv_c), CHUNK_LEN(recv_c) * sizeof(float)) != 0) {
+            return -1;
+        }
+    }
+
+#undef CHUNK_BEGIN
+#undef CHUNK_LEN
+    return 0;
+}
+
+// Returns once every rank has called it
+int transport_barrier(Transport* t) {
+    float token = 0.0f;
+    return transport_allreduce_sum(t, &token, 1);
+}
+
+void transport_close(Transport* t) {
+    if (!t) return;
+    free(t->scratch);
+    t->scratch = NULL;
+    t->scratch_floats = 0;
+    if (t->close) t->close(t);
+}
@@ -0,0 +1,1082 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <string.h>
+#include <mutex>
+#include <thread>
+
+#include "Utils/Matrix.hpp"
+#include "Models/MLP/MLP.hpp"
+#include "Models/MLP/Inference.hpp"
+#include "Models/MLP/InferenceServer.hpp"
+#include "Models/MLP/Pipeline.hpp"
+#include "Models/MLP/DataParallel.hpp"
+#include "Models/MLP/Snapshot.hpp"
+#include "Models/MLP/Checkpoint.hpp"
+#include "Models/MLP/ModelPack.hpp"
+#include "Models/MLP/LowRank.hpp"
+#include "Models/MLP/Autotune.hpp"
+#include "Models/MLP/InferenceCache.hpp"
+#include "Models/Autoencoder/Autoencoder.hpp"
+
+// Micro benchmarks, build with `make bench` (release flags, no sanitizer).
+
+static double now_sec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void bench_allocator() {
+    printf("\n=== Bench: Matrix allocation (create + free) ===\n");
+
+    const size_t iters = 200000;
+    size_t shapes[][2] = {{4, 1}, {64, 1}, {256, 256}, {1000, 1}};
+    MatAllocator* allocators[] = {&mat_system_allocator, &mat_pool_allocator};
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        for (size_t a = 0; a < 2; a++) {
+            mat_set_allocator(allocators[a]);
+            mat_alloc_reset_stats();
+
+            double start = now_sec();
+            for (size_t i = 0; i < iters; i++) {
+                Matrix* tmp = mat_create(shapes[s][0], shapes[s][1]);
+                mat_free(tmp);
+            }
+            double elapsed = now_sec() - start;
+
+            MatAllocStats stats = mat_alloc_stats();
+            printf("%-6s %4zu x %-4zu : %7.1f ns/op  (hit rate %.3f)\n", allocators[a]->name,
+                   shapes[s][0], shapes[s][1], elapsed * 1e9 / iters, stats.hit_rate);
+        }
+    }
+    mat_set_allocator(NULL);
+
+    // whole training run, which creates temporaries every sample
+    size_t layer_dims[] = {2, 16, 16, 1};
+    ActivationType activations[] = {ACTIVATION_TANH, ACTIVATION_TANH, ACTIVATION_SIGMOID};
+    Matrix* inputs[4];
+    Matrix* targets[4];
+    for (int i = 0; i < 4; i++) {
+        inputs[i] = mat_create(2, 1);
+        mat_set(inputs[i], 0, 0, (float)(i & 1));
+        mat_set(inputs[i], 1, 0, (float)((i >> 1) & 1));
+        targets[i] = mat_create_with_value(1, 1, (float)((i & 1) ^ ((i >> 1) & 1)));
+    }
+
+    for (size_t a = 0; a < 2; a++) {
+        mat_set_allocator(allocators[a]);
+        mat_alloc_reset_stats();
+        rng_set_global_seed(42);
+        MLP* network = create_mlp(layer_dims, 4, activations, 0.1f);
+
+        double start = now_sec();
+        FILE* saved = stdout;
+        stdout = fopen("/dev/null", "w");
+        mlp_train(network, inputs, targets, 4, 2000, LOSS_MSE, 0.0f);
+        fclose(stdout);
+        stdout = saved;
+        double elapsed = now_sec() - start;
+
+        MatAllocStats stats = mat_alloc_stats();
+        printf("%-6s XOR 2-16-16-1, 2000 epochs: %7.2f ms  (allocs %zu, peak %zu B, hit rate %.3f)\n",
+               allocators[a]->name, elapsed * 1e3, stats.allocs, stats.peak_bytes, stats.hit_rate);
+        mlp_free(network);
+    }
+    mat_set_allocator(NULL);
+
+    for (int i = 0; i < 4; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+}
+
+// best of `reps` runs of fn, in seconds
+template <typename F>
+static double best_of(int reps, F fn) {
+    double best = 1e30;
+    for (int r = 0; r < reps; r++) {
+        double start = now_sec();
+        fn();
+        double elapsed = now_sec() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+void bench_layout() {
+    printf("\n=== Bench: dense vs padded row stride ===\n");
+
+    size_t sizes[] = {100, 257, 1000};
+    MatLayout layouts[] = {MAT_LAYOUT_DENSE, MAT_LAYOUT_PADDED};
+    const char* names[] = {"dense", "padded"};
+    double gemm_time[2] = {0, 0};
+    double ew_time[2] = {0, 0};
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        for (int l = 0; l < 2; l++) {
+            Matrix* a = mat_create_ex(n, n, layouts[l]);
+            Matrix* b = mat_create_ex(n, n, layouts[l]);
+            Matrix* c = mat_create_ex(n, n, layouts[l]);
+            // same values for both layouts: element (i, j) is draw i * n + j of its stream
+            for (size_t i = 0; i < n; i++) {
+                rng_fill_uniform(rng_stream(17, 0), i * n, a->data + i * a->stride, n, 0.0f, 1.0f);
+                rng_fill_uniform(rng_stream(17, 1), i * n, b->data + i * b->stride, n, 0.0f, 1.0f);
+            }
+
+            int gemm_reps = n >= 1000 ? 3 : 20;
+            gemm_time[l] = best_of(gemm_reps, [&]() { mat_mul(a, b, c); });
+
+            const int ew_iters = 50;
+            ew_time[l] = best_of(5, [&]() {
+                for (int it = 0; it < ew_iters; it++) {
+                    mat_add(a, b, c);
+                    mat_hadamard(c, b, c);
+                    mat_scale(c, 0.5f, c);
+                }
+            }) / ew_iters;
+
+            mat_free(a);
+            mat_free(b);
+            mat_free(c);
+        }
+
+        double flops = 2.0 * n * n * n;
+        for (int l = 0; l < 2; l++) {
+            printf("%4zu x %-4zu %-6s : GEMM %8.3f ms (%5.2f GFLOP/s)   add+hadamard+scale %8.2f us\n",
+                   n, n, names[l], gemm_time[l] * 1e3, flops / gemm_time[l] * 1e-9, ew_time[l] * 1e6);
+        }
+        printf("%4zu x %-4zu speedup: GEMM %.2fx, element-wise %.2fx\n",
+               n, n, gemm_time[0] / gemm_time[1], ew_time[0] / ew_time[1]);
+    }
+}
+
+// p-th percentile (0..100) of samples, sorts in place
+static double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t idx = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[idx];
+}
+
+static MLP* bench_random_mlp(size_t* dims, size_t num_dims, ActivationType hidden) {
+    std::vector<ActivationType> activations(num_dims - 1, hidden);
+    activations.back() = ACTIVATION_SIGMOID;
+    return create_mlp(dims, num_dims, activations.data(), 0.01f);
+}
+
+void bench_gemv_inference() {
+    printf("\n=== Bench: batch-1 inference latency (mlp_forward vs prepacked GEMV) ===\n");
+
+    size_t net_a[] = {32, 64, 64, 4};
+    size_t net_b[] = {128, 256, 256, 256, 10};
+    size_t net_c[] = {256, 256, 256, 256, 256, 256, 10};
+    size_t* nets[] = {net_a, net_b, net_c};
+    size_t net_dims[] = {4, 5, 7};
+    const size_t calls = 20000;
+
+    for (size_t n = 0; n < 3; n++) {
+        size_t* dims = nets[n];
+        size_t num_dims = net_dims[n];
+        MLP* mlp = bench_random_mlp(dims, num_dims, ACTIVATION_RELU);
+        InferMLP* net = mlp_prepack(mlp);
+
+        Matrix* input = mat_create(dims[0], 1);
+        rng_fill_uniform(rng_stream(19, n), 0, input->data, dims[0], 0.0f, 1.0f);
+        Matrix* out_ref = mat_create(dims[num_dims - 1], 1);
+        Matrix* out_fast = mat_create(dims[num_dims - 1], 1);
+
+        std::vector<double> base, fast;
+        base.reserve(calls);
+        fast.reserve(calls);
+        for (size_t c = 0; c < calls; c++) {
+            double t0 = now_sec();
+            mlp_forward(mlp, input, out_ref);
+            double t1 = now_sec();
+            infer_forward_mat(net, input, out_fast);
+            double t2 = now_sec();
+            base.push_back((t1 - t0) * 1e6);
+            fast.push_back((t2 - t1) * 1e6);
+        }
+
+        float max_diff = 0.0f;
+        for (size_t i = 0; i < out_ref->rows; i++) {
+            float d = fabsf(mat_get(out_ref, i, 0) - mat_get(out_fast, i, 0));
+            if (d > max_diff) max_diff = d;
+        }
+
+        printf("MLP %zu layers (", num_dims - 1);
+        for (size_t i = 0; i < num_dims; i++) printf(i ? "-%zu" : "%zu", dims[i]);
+        printf("), max |diff| %.2e\n", max_diff);
+        const char* names[] = {"mlp_forward", "prepacked"};
+        std::vector<double>* runs[] = {&base, &fast};
+        double p99[2];
+        for (int r = 0; r < 2; r++) {
+            double p50 = percentile(*runs[r], 50), p90 = percentile(*runs[r], 90);
+            p99[r] = percentile(*runs[r], 99);
+            double p999 = percentile(*runs[r], 99.9);
+            printf("  %-12s p50 %8.2f us  p90 %8.2f us  p99 %8.2f us  p99.9 %8.2f us\n",
+                   names[r], p50, p90, p99[r], p999);
+        }
+        printf("  p99 speedup %.2fx\n", p99[0] / p99[1]);
+
+        mat_free(input);
+        mat_free(out_ref);
+        mat_free(out_fast);
+        infer_free(net);
+        mlp_free(mlp);
+    }
+}
+
+// Closed-loop load generator: `clients` threads each send `per_client` requests
+// through `serve` and record the latency of every one.
+template <typename F>
+static double run_load(size_t clients, size_t per_client, size_t in_size, size_t out_size,
+                       std::vector<double>& latencies_us, F serve) {
+    std::vector<std::vector<double> > per_thread(clients);
+    std::vector<std::thread> threads;
+
+    double start = now_sec();
+    for (size_t c = 0; c < clients; c++) {
+        threads.push_back(std::thread([&, c]() {
+            Matrix* x = mat_create(in_size, 1);
+            Matrix* y = mat_create(out_size, 1);
+            for (size_t i = 0; i < in_size; i++) mat_set(x, i, 0, (float)((c * 31 + i) % 17) / 17.0f);
+            per_thread[c].reserve(per_client);
+            for (size_t r = 0; r < per_client; r++) {
+                double t0 = now_sec();
+                serve(x, y);
+                per_thread[c].push_back((now_sec() - t0) * 1e6);
+            }
+            mat_free(x);
+            mat_free(y);
+        }));
+    }
+    for (size_t c = 0; c < clients; c++) threads[c].join();
+    double elapsed = now_sec() - start;
+
+    latencies_us.clear();
+    for (size_t c = 0; c < clients; c++) {
+        latencies_us.insert(latencies_us.end(), per_thread[c].begin(), per_thread[c].end());
+    }
+    return clients * per_client / elapsed;
+}
+
+void bench_inference_server() {
+    printf("\n=== Bench: micro-batching inference server vs one-at-a-time ===\n");
+
+    size_t dims[] = {64, 256, 256, 10};
+    MLP* mlp = bench_random_mlp(dims, 4, ACTIVATION_RELU);
+    const size_t per_client = 2000;
+    size_t client_counts[] = {1, 8, 32, 64};
+    std::vector<double> lat;
+
+    for (size_t ci = 0; ci < 4; ci++) {
+        size_t clients = client_counts[ci];
+
+        std::mutex forward_lock;  // mlp_forward writes Layer::output, so callers must serialize
+        double base_tput = run_load(clients, per_client, dims[0], dims[3], lat, [&](Matrix* x, Matrix* y) {
+            std::lock_guard<std::mutex> guard(forward_lock);
+            mlp_forward(mlp, x, y);
+        });
+        printf("%2zu clients  one-at-a-time : %9.0f req/s  p50 %8.1f us  p99 %8.1f us\n",
+               clients, base_tput, percentile(lat, 50), percentile(lat, 99));
+
+        InferServer* server = infer_server_create(mlp, 32, 200);
+        double server_tput = run_load(clients, per_client, dims[0], dims[3], lat, [&](Matrix* x, Matrix* y) {
+            infer_server_forward(server, x, y);
+        });
+        InferServerStats stats = infer_server_stats(server);
+        infer_server_destroy(server);
+        printf("%2zu clients  micro-batched : %9.0f req/s  p50 %8.1f us  p99 %8.1f us  (avg batch %.1f)\n",
+               clients, server_tput, percentile(lat, 50), percentile(lat, 99), stats.avg_batch);
+    }
+
+    mlp_free(mlp);
+}
+
+void bench_pipeline() {
+    printf("\n=== Bench: pipeline-parallel training (deep, narrow MLP) ===\n");
+
+    size_t dims[] = {32, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 8};
+    const size_t num_dims = sizeof(dims) / sizeof(dims[0]);
+    const size_t num_samples = 2048;
+    const size_t epochs = 2;
+    const size_t hw = std::thread::hardware_concurrency();
+
+    std::vector<Matrix*> inputs(num_samples), targets(num_samples);
+    for (size_t i = 0; i < num_samples; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[num_dims - 1], 1);
+        mat_fill(inputs[i], 0.5f);
+        mat_fill(targets[i], (i & 1) ? 1.0f : 0.0f);
+        inputs[i]->data[(i % dims[0]) * inputs[i]->stride] = 1.0f;
+    }
+
+    MLP* mlp = bench_random_mlp(dims, num_dims, ACTIVATION_TANH);
+    double t0 = now_sec();
+    mlp_train(mlp, inputs.data(), targets.data(), num_samples, epochs, LOSS_MSE, 0.0f);
+    double base = (now_sec() - t0) / epochs;
+    mlp_free(mlp);
+    printf("mlp_train (per-sample)       : %8.1f ms/epoch\n", base * 1e3);
+
+    size_t stage_counts[] = {1, 2, 4, 6};
+    for (size_t si = 0; si < 4; si++) {
+        size_t stages = stage_counts[si];
+        mlp = bench_random_mlp(dims, num_dims, ACTIVATION_TANH);
+        t0 = now_sec();
+        mlp_train_pipeline(mlp, inputs.data(), targets.data(), num_samples, epochs, LOSS_MSE, 0.0f, stages, 16, 8);
+        double t = (now_sec() - t0) / epochs;
+        mlp_free(mlp);
+        printf("pipeline %zu stage(s), mb 16x8 : %8.1f ms/epoch  (%.2fx vs mlp_train)\n",
+               stages, t * 1e3, base / t);
+    }
+    printf("(%zu hardware threads, stages beyond that time-slice one core)\n", hw);
+
+    for (size_t i = 0; i < num_samples; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+}
+
+void bench_data_parallel() {
+    printf("\n=== Bench: multi-process data-parallel training (shm ring all-reduce) ===\n");
+
+    size_t dims[] = {64, 256, 256, 256, 10};
+    const size_t num_dims = sizeof(dims) / sizeof(dims[0]);
+    const size_t num_samples = 4096;
+    const size_t epochs = 2;
+    const size_t batch = 32;
+    const long hw = sysconf(_SC_NPROCESSORS_ONLN);
+
+    std::vector<Matrix*> inputs(num_samples), targets(num_samples);
+    for (size_t i = 0; i < num_samples; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[num_dims - 1], 1);
+        mat_fill(inputs[i], 0.1f);
+        mat_fill(targets[i], 0.0f);
+        inputs[i]->data[(i % dims[0]) * inputs[i]->stride] = 1.0f;
+        targets[i]->data[(i % dims[num_dims - 1]) * targets[i]->stride] = 1.0f;
+    }
+
+    int worker_counts[] = {1, 2, 4, 8};
+    double base = 0.0;
+    for (size_t wi = 0; wi < 4; wi++) {
+        int workers = worker_counts[wi];
+        MLP* mlp = bench_random_mlp(dims, num_dims, ACTIVATION_RELU);
+        double t0 = now_sec();
+        float loss = mlp_train_data_parallel(mlp, inputs.data(), targets.data(), num_samples, epochs,
+                                             LOSS_MSE, 0.0f, workers, batch);
+        double t = (now_sec() - t0) / epochs;
+        mlp_free(mlp);
+        if (wi == 0) base = t;
+        printf("%d worker(s), batch %zu/rank : %8.1f ms/epoch  %9.0f samples/s  (%.2fx, loss %.4f)\n",
+               workers, batch, t * 1e3, num_samples / t, base / t, loss);
+    }
+    printf("(%ld cores online, workers beyond that time-slice)\n", hw);
+
+    for (size_t i = 0; i < num_samples; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+}
+
+// Per client-thread state for bench_snapshot_serving
+struct SnapshotClient {
+    SnapshotStore* store;
+    int slot;
+    MLPBatchScratch* scratch;
+    SnapshotClient() : store(NULL), slot(-1), scratch(NULL) {}
+    ~SnapshotClient() {
+        mlp_batch_scratch_free(scratch);
+        snapshot_reader_unregister(store, slot);
+    }
+};
+
+void bench_snapshot_serving() {
+    printf("\n=== Bench: serving latency while training (snapshots vs a shared lock) ===\n");
+
+    size_t dims[] = {64, 256, 256, 10};
+    const size_t clients = 4;
+    const size_t per_client = 3000;
+    const size_t publish_every = 8;
+    std::vector<double> lat;
+
+    MLP* trainee = bench_random_mlp(dims, 4, ACTIVATION_RELU);
+    std::vector<Matrix*> inputs(256), targets(256);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[3], 1);
+        mat_fill(inputs[i], 0.1f);
+        mat_fill(targets[i], 0.0f);
+        inputs[i]->data[(i % dims[0]) * inputs[i]->stride] = 1.0f;
+        targets[i]->data[(i % dims[3]) * targets[i]->stride] = 1.0f;
+    }
+    mlp_train_prepare(trainee, inputs[0]);
+
+    SnapshotStore* store = snapshot_store_create(trainee);
+    std::mutex model_lock;
+    std::atomic<bool> training(false);
+    std::atomic<size_t> trained(0);
+    int use_lock = 0;
+
+    // trains until told to stop, publishing a snapshot (or holding the lock per step)
+    auto trainer = [&]() {
+        for (size_t i = 0; training; i++) {
+            size_t k = i % inputs.size();
+            if (use_lock) {
+                std::lock_guard<std::mutex> guard(model_lock);
+                mlp_train_sample(trainee, inputs[k], targets[k], LOSS_MSE);
+            } else {
+                mlp_train_sample(trainee, inputs[k], targets[k], LOSS_MSE);
+                if (i % publish_every == 0) snapshot_publish(store, trainee);
+            }
+            trained++;
+        }
+    };
+
+    auto serve_snapshot = [&](Matrix* x, Matrix* y) {
+        thread_local SnapshotClient client;
+        if (!client.scratch) {
+            client.store = store;
+            client.slot = snapshot_reader_register(store);
+            client.scratch = mlp_batch_scratch_create(trainee, 1);
+        }
+        const ModelSnapshot* snap = snapshot_pin(store, client.slot);
+        mlp_forward_batch(snap->mlp, x, y, client.scratch);
+        snapshot_unpin(store, client.slot);
+    };
+
+    auto serve_locked = [&](Matrix* x, Matrix* y) {
+        thread_local MLPBatchScratch* scratch = NULL;
+        if (!scratch) scratch = mlp_batch_scratch_create(trainee, 1);
+        std::lock_guard<std::mutex> guard(model_lock);
+        mlp_forward_batch(trainee, x, y, scratch);
+    };
+
+    const char* names[] = {"snapshots, no training  ", "snapshots + training    ", "shared lock + training  "};
+    for (int mode = 0; mode < 3; mode++) {
+        use_lock = mode == 2;
+        training = mode > 0;
+        trained = 0;
+        std::thread train_thread;
+        if (training) train_thread = std::thread(trainer);
+
+        double t0 = now_sec();
+        double tput = mode == 2 ? run_load(clients, per_client, dims[0], dims[3], lat, serve_locked)
+                                : run_load(clients, per_client, dims[0], dims[3], lat, serve_snapshot);
+        double elapsed = now_sec() - t0;
+
+        training = false;
+        if (train_thread.joinable()) train_thread.join();
+        printf("%s: %8.0f req/s  p50 %7.1f us  p99 %7.1f us  (%6.0f train steps/s)\n",
+               names[mode], tput, percentile(lat, 50), percentile(lat, 99), trained / elapsed);
+    }
+
+    SnapshotStats stats = snapshot_stats(store);
+    printf("published %zu snapshots, %zu recycled, %zu freed\n", stats.published, stats.recycled, stats.freed);
+
+    snapshot_store_free(store);
+    mlp_free(trainee);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+}
+
+void bench_checkpoint() {
+    printf("\n=== Bench: training step time with async checkpoints ===\n");
+
+    size_t dims[] = {256, 1024, 1024, 256, 10};
+    const size_t steps = 1500;
+    const size_t checkpoint_every = 100;
+    const char* path = "/tmp/nn_bench_checkpoint.bin";
+
+    MLP* mlp = bench_random_mlp(dims, 5, ACTIVATION_RELU);
+    Matrix* x = mat_create(dims[0], 1);
+    Matrix* y = mat_create(dims[4], 1);
+    mat_fill(x, 0.05f);
+    mat_fill(y, 0.1f);
+    mlp_train_prepare(mlp, x);
+
+    Checkpointer* ckpt = checkpoint_create(path);
+    std::vector<double> step_us;
+    for (int with_ckpt = 0; with_ckpt < 2; with_ckpt++) {
+        step_us.clear();
+        double t0 = now_sec();
+        for (size_t i = 0; i < steps; i++) {
+            double s0 = now_sec();
+            if (with_ckpt && i % checkpoint_every == 0) checkpoint_request(ckpt, mlp);
+            mlp_train_sample(mlp, x, y, LOSS_MSE);
+            step_us.push_back((now_sec() - s0) * 1e6);
+        }
+        double mean = (now_sec() - t0) / steps * 1e6;
+        checkpoint_wait(ckpt);
+        printf("%s: mean %7.1f us/step  p50 %7.1f  p99 %7.1f\n",
+               with_ckpt ? "checkpoint every 100 steps" : "no checkpoints            ",
+               mean, percentile(step_us, 50), percentile(step_us, 99));
+    }
+
+    CheckpointStats stats = checkpoint_stats(ckpt);
+    printf("%.1f MB per checkpoint: staging copy %.2f ms, background write+fsync %.1f ms, %zu written, %zu skipped\n",
+           (double)checkpoint_bytes_for(mlp) / (1 << 20), stats.last_copy_ms, stats.last_write_ms,
+           stats.written, stats.skipped);
+
+    checkpoint_free(ckpt);
+    remove(path);
+    mat_free(x);
+    mat_free(y);
+    mlp_free(mlp);
+}
+
+// Weight initialisation the way create_mlp did it before the Philox streams
+static void bench_rand_init(Matrix* w, float scale) {
+    for (size_t row = 0; row < w->rows; row++) {
+        for (size_t col = 0; col < w->cols; col++) {
+            mat_set_unsafe(w, row, col, ((float)rand() / RAND_MAX) * 2.0f * scale - scale);
+        }
+    }
+}
+
+static int bench_same_weights(const MLP* a, const MLP* b) {
+    for (size_t l = 0; l < a->num_layers; l++) {
+        const Matrix* wa = a->layers[l].weights;
+        const Matrix* wb = b->layers[l].weights;
+        for (size_t r = 0; r < wa->rows; r++) {
+            if (memcmp(wa->data + r * wa->stride, wb->data + r * wb->stride, wa->cols * sizeof(float)) != 0) return 0;
+        }
+    }
+    return 1;
+}
+
+void bench_init() {
+    printf("\n=== Bench: weight initialisation (rand() vs Philox streams) ===\n");
+
+    size_t dims[] = {1024, 4096, 4096, 1024};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    const uint64_t seed = 1234;
+    size_t params = 0;
+    for (size_t i = 0; i < 3; i++) params += dims[i] * dims[i + 1];
+
+    // old path: same allocations, weights drawn serially from rand()
+    MLP* legacy = create_mlp_seeded(dims, 4, activations, 0.01f, seed);
+    double t0 = now_sec();
+    for (size_t i = 0; i < 3; i++) {
+        bench_rand_init(legacy->layers[i].weights, utility::newton_sqrt(2.0f / dims[i]));
+    }
+    double rand_ms = (now_sec() - t0) * 1e3;
+    printf("rand() fill         : %8.1f ms  (%.1f M params)\n", rand_ms, params / 1e6);
+    mlp_free(legacy);
+
+    size_t cores = std::thread::hardware_concurrency();
+    size_t thread_counts[] = {1, 4, cores ? cores : 1};
+    MLP* reference = NULL;
+    for (size_t t = 0; t < 3; t++) {
+        mlp_init_threads = thread_counts[t];
+        t0 = now_sec();
+        MLP* mlp = create_mlp_seeded(dims, 4, activations, 0.01f, seed);
+        double ms = (now_sec() - t0) * 1e3;
+        int same = reference ? bench_same_weights(reference, mlp) : 1;
+        printf("create_mlp %2zu thread%s: %8.1f ms  (%.2fx vs rand() fill alone)  weights %s\n",
+               thread_counts[t], thread_counts[t] == 1 ? " " : "s", ms, rand_ms / ms,
+               same ? "identical" : "DIFFER");
+        if (reference) {
+            mlp_free(mlp);
+        } else {
+            reference = mlp;
+        }
+    }
+    mlp_init_threads = 0;
+    mlp_free(reference);
+
+    // raw generator throughput, what shuffling and dropout masks draw from
+    const size_t n = (size_t)1 << 24;
+    std::vector<float> buf(n);
+    t0 = now_sec();
+    rng_fill_uniform(rng_stream(seed, 0), 0, buf.data(), n, 0.0f, 1.0f);
+    double uniform_s = now_sec() - t0;
+    t0 = now_sec();
+    rng_fill_normal(rng_stream(seed, 0), 0, buf.data(), n, 0.0f, 1.0f);
+    double normal_s = now_sec() - t0;
+    t0 = now_sec();
+    rng_fill_dropout(rng_stream(seed, 0), 0, buf.data(), n, 0.5f);
+    double dropout_s = now_sec() - t0;
+    printf("Philox uniform %.0f M/s, normal %.0f M/s, dropout mask %.0f M/s (1 thread)\n",
+           n / uniform_s / 1e6, n / normal_s / 1e6, n / dropout_s / 1e6);
+}
+
+void bench_model_pack() {
+    printf("\n=== Bench: K XOR models {2, 4, 1}, separate mlp_train vs one packed run ===\n");
+
+    size_t dims[] = {2, 4, 1};
+    ActivationType activations[] = {ACTIVATION_TANH, ACTIVATION_SIGMOID};
+    const size_t epochs = 500;
+    Matrix* inputs[4];
+    Matrix* targets[4];
+    for (int i = 0; i < 4; i++) {
+        inputs[i] = mat_create(2, 1);
+        mat_set(inputs[i], 0, 0, (float)(i & 1));
+        mat_set(inputs[i], 1, 0, (float)((i >> 1) & 1));
+        targets[i] = mat_create_with_value(1, 1, (float)((i & 1) ^ ((i >> 1) & 1)));
+    }
+
+    size_t model_counts[] = {1, 16, 256, 1024};
+    for (size_t c = 0; c < 4; c++) {
+        size_t K = model_counts[c];
+        std::vector<MLP*> separate(K), packed(K);
+        for (size_t k = 0; k < K; k++) {
+            // a learning rate sweep over 0.05 .. 0.5
+            float rate = 0.05f + 0.45f * k / (K > 1 ? K - 1 : 1);
+            separate[k] = create_mlp_seeded(dims, 3, activations, rate, 1000 + k);
+            packed[k] = create_mlp_seeded(dims, 3, activations, rate, 1000 + k);
+        }
+
+        FILE* saved = stdout;
+        stdout = fopen("/dev/null", "w");
+        // the separate baseline is timed on at most 256 models and scaled
+        size_t timed = K < 256 ? K : 256;
+        std::vector<float> separate_loss(timed);
+        double t0 = now_sec();
+        for (size_t k = 0; k < timed; k++) {
+            separate_loss[k] = mlp_train(separate[k], inputs, targets, 4, epochs, LOSS_MSE, 0.0f);
+        }
+        double separate_s = (now_sec() - t0) * K / timed;
+
+        t0 = now_sec();
+        MLPPack* pack = mlp_pack_create(packed.data(), K);
+        mlp_pack_train(pack, inputs, targets, 4, epochs, LOSS_MSE, 0.0f);
+        mlp_pack_unpack(pack, packed.data());
+        double packed_s = now_sec() - t0;
+        fclose(stdout);
+        stdout = saved;
+
+        float max_diff = 0.0f;
+        for (size_t k = 0; k < timed; k++) {
+            max_diff = fmaxf(max_diff, fabsf(pack->loss[k] - separate_loss[k]));
+        }
+        printf("K=%4zu: separate %9.1f ms, packed %8.1f ms  (%6.1fx, %9.0f model-epochs/s)  max |loss diff| %.2e\n",
+               K, separate_s * 1e3, packed_s * 1e3, separate_s / packed_s, K * epochs / packed_s, max_diff);
+
+        mlp_pack_free(pack);
+        for (size_t k = 0; k < K; k++) {
+            mlp_free(separate[k]);
+            mlp_free(packed[k]);
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+}
+
+void bench_autoencoder() {
+    printf("\n=== Bench: autoencoder 784-256-64, tied vs untied decoder ===\n");
+
+    size_t dims[] = {784, 256, 64};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_RELU, ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    const size_t num_samples = 2048, batch = 64, epochs = 5, latent = 16;
+
+    // samples on a 16-dimensional manifold: sigmoid(M z) for random M and z
+    Rng rng;
+    rng_init(&rng, 99, 0);
+    Matrix* basis = mat_create(dims[0], latent);
+    for (size_t i = 0; i < dims[0]; i++) {
+        for (size_t j = 0; j < latent; j++) mat_set(basis, i, j, rng_uniform(&rng) * 2.0f - 1.0f);
+    }
+    std::vector<Matrix*> samples(num_samples);
+    for (size_t s = 0; s < num_samples; s++) {
+        float z[16];
+        for (size_t j = 0; j < latent; j++) z[j] = rng_uniform(&rng) * 2.0f - 1.0f;
+        samples[s] = mat_create(dims[0], 1);
+        for (size_t i = 0; i < dims[0]; i++) {
+            float v = 0.0f;
+            for (size_t j = 0; j < latent; j++) v += mat_get(basis, i, j) * z[j];
+            mat_set(samples[s], i, 0, sigmoid(v));
+        }
+    }
+
+    for (int tied = 0; tied < 2; tied++) {
+        rng_set_global_seed(7);
+        Autoencoder* ae = create_autoencoder(dims, 3, activations, 0.05f, tied);
+
+        FILE* saved = stdout;
+        stdout = fopen("/dev/null", "w");
+        double t0 = now_sec();
+        float loss = autoencoder_train(ae, samples.data(), num_samples, epochs, batch, 0.0f);
+        double train_s = now_sec() - t0;
+        fclose(stdout);
+        stdout = saved;
+
+        const size_t serve_batch = 256, rounds = 20;
+        Matrix* X = mat_create(dims[0], serve_batch);
+        mlp_gather_columns(samples.data(), 0, serve_batch, X);
+        Matrix* codes = mat_create(dims[2], serve_batch);
+        Matrix* recon = mat_create(dims[0], serve_batch);
+        MLPBatchScratch* scratch = autoencoder_encode_scratch(ae, serve_batch);
+        double encode_s = best_of(3, [&]() {
+            for (size_t r = 0; r < rounds; r++) autoencoder_encode(ae, X, codes, scratch);
+        });
+        double full_s = best_of(3, [&]() {
+            for (size_t r = 0; r < rounds; r++) autoencoder_reconstruct(ae, X, recon);
+        });
+
+        printf("%-6s: %6.2f MB params, train %7.1f ms/epoch, loss %.4f, encode %7.0f samples/s (full pass %7.0f)\n",
+               tied ? "tied" : "untied", autoencoder_param_count(ae) * sizeof(float) / 1048576.0,
+               train_s / epochs * 1e3, loss, serve_batch * rounds / encode_s, serve_batch * rounds / full_s);
+
+        mlp_batch_scratch_free(scratch);
+        mat_free(X);
+        mat_free(codes);
+        mat_free(recon);
+        autoencoder_free(ae);
+    }
+
+    for (size_t s = 0; s < num_samples; s++) mat_free(samples[s]);
+    mat_free(basis);
+}
+
+// Relative Frobenius error ||A - B|| / ||B||
+static double bench_rel_error(const Matrix* a, const Matrix* b) {
+    double diff = 0.0, ref = 0.0;
+    for (size_t i = 0; i < b->rows; i++) {
+        for (size_t j = 0; j < b->cols; j++) {
+            double d = mat_get(a, i, j) - mat_get(b, i, j);
+            diff += d * d;
+            ref += (double)mat_get(b, i, j) * mat_get(b, i, j);
+        }
+    }
+    return sqrt(diff / ref);
+}
+
+// Fraction of columns whose largest entry is in the same row
+static double bench_argmax_agreement(const Matrix* a, const Matrix* b) {
+    size_t same = 0;
+    for (size_t j = 0; j < b->cols; j++) {
+        size_t ia = 0, ib = 0;
+        for (size_t i = 1; i < b->rows; i++) {
+            if (mat_get(a, i, j) > mat_get(a, ia, j)) ia = i;
+            if (mat_get(b, i, j) > mat_get(b, ib, j)) ib = i;
+        }
+        same += ia == ib;
+    }
+    return (double)same / b->cols;
+}
+
+void bench_lowrank() {
+    printf("\n=== Bench: low-rank factorized layers, 512-1024-1024-1024-10 ===\n");
+
+    size_t dims[] = {512, 1024, 1024, 1024, 10};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_RELU, ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    const size_t batch = 64, eval = 1024, true_rank = 48;
+    MLP* mlp = create_mlp_seeded(dims, 5, activations, 0.01f, 2024);
+
+    // hidden weights with a decaying spectrum, like trained layers: a rank-48
+    // product plus 10% dense noise, at He scale
+    Rng rng;
+    rng_init(&rng, 5, 0);
+    for (size_t l = 0; l < 3; l++) {
+        Matrix* W = mlp->layers[l].weights;
+        Matrix* A = mat_create(W->rows, true_rank);
+        Matrix* B = mat_create(true_rank, W->cols);
+        for (size_t i = 0; i < A->rows; i++) rng_fill_normal(rng_stream(77, 2 * l), i * true_rank, A->data + i * A->stride, true_rank, 0.0f, 1.0f);
+        for (size_t i = 0; i < B->rows; i++) rng_fill_normal(rng_stream(77, 2 * l + 1), i * W->cols, B->data + i * B->stride, W->cols, 0.0f, 1.0f);
+        mat_mul(A, B, W);
+        float scale = utility::newton_sqrt(2.0f / W->cols) / utility::newton_sqrt((float)true_rank);
+        for (size_t i = 0; i < W->rows; i++) {
+            for (size_t j = 0; j < W->cols; j++) {
+                float noise = (rng_uniform(&rng) * 2.0f - 1.0f) * 1.7f;
+                mat_set_unsafe(W, i, j, (mat_get(W, i, j) + 0.1f * noise) * scale);
+            }
+        }
+        mat_free(A);
+        mat_free(B);
+    }
+
+    // factorization sanity check on an exactly rank-16 matrix
+    {
+        Matrix* A = mat_create(300, 16);
+        Matrix* B = mat_create(16, 200);
+        Matrix* W = mat_create(300, 200);
+        Matrix* R = mat_create(300, 200);
+        for (size_t i = 0; i < 300; i++) rng_fill_normal(rng_stream(3, 0), i * 16, A->data + i * A->stride, 16, 0.0f, 1.0f);
+        for (size_t i = 0; i < 16; i++) rng_fill_normal(rng_stream(3, 1), i * 200, B->data + i * B->stride, 200, 0.0f, 1.0f);
+        mat_mul(A, B, W);
+        Matrix *U, *V;
+        lowrank_factorize(W, 16, 1, 9, &U, &V, NULL);
+        mat_mul(U, V, R);
+        printf("rank-16 300x200 matrix, rank-16 factorization: relative error %.2e\n", bench_rel_error(R, W));
+        mat_free(A); mat_free(B); mat_free(W); mat_free(R); mat_free(U); mat_free(V);
+    }
+
+    Matrix* X = mat_create(dims[0], eval);
+    for (size_t i = 0; i < dims[0]; i++) {
+        for (size_t j = 0; j < eval; j++) mat_set_unsafe(X, i, j, rng_uniform(&rng));
+    }
+    Matrix* ref = mat_create(dims[4], eval);
+    Matrix* out = mat_create(dims[4], eval);
+    MLPBatchScratch* dense_scratch = mlp_batch_scratch_create(mlp, eval);
+    mlp_forward_batch(mlp, X, ref, dense_scratch);
+
+    Matrix* xb = mat_view(X, 0, 0, dims[0], batch);
+    Matrix* yb = mat_view(out, 0, 0, dims[4], batch);
+    double dense_s = best_of(5, [&]() {
+        for (int r = 0; r < 10; r++) mlp_forward_batch(mlp, xb, yb, dense_scratch);
+    });
+    size_t dense_params = 0;
+    for (size_t l = 0; l < 4; l++) dense_params += mat_size(mlp->layers[l].weights) + mat_size(mlp->layers[l].bias);
+    printf("dense      : %5.2f M params, batch %zu forward %7.3f ms\n", dense_params / 1e6, batch, dense_s / 10 * 1e3);
+
+    size_t ranks_tried[] = {8, 16, 32, 48, 64, 128, 256};
+    LowRankMLP* keep = NULL;
+    for (size_t t = 0; t < 7; t++) {
+        size_t ranks[] = {ranks_tried[t], ranks_tried[t], ranks_tried[t], 0};
+        double t0 = now_sec();
+        LowRankMLP* net = mlp_lowrank_compress(mlp, ranks, 2);
+        double compress_s = now_sec() - t0;
+        LowRankScratch* scratch = lowrank_scratch_create(net, eval);
+        lowrank_forward_batch(net, X, out, scratch);
+        double err = bench_rel_error(out, ref), agree = bench_argmax_agreement(out, ref);
+        double fast_s = best_of(5, [&]() {
+            for (int r = 0; r < 10; r++) lowrank_forward_batch(net, xb, yb, scratch);
+        });
+        printf("rank %4zu  : %5.2f M params, batch %zu forward %7.3f ms (%5.2fx), output error %.4f, argmax agreement %5.1f%%, compress %6.1f ms\n",
+               ranks_tried[t], lowrank_param_count(net) / 1e6, batch, fast_s / 10 * 1e3, dense_s / fast_s,
+               err, agree * 100.0, compress_s * 1e3);
+        lowrank_scratch_free(scratch);
+        if (ranks_tried[t] == 16) {
+            keep = net;
+        } else {
+            lowrank_free(net);
+        }
+    }
+
+    // fine-tune the rank-16 network on the dense model's outputs (distillation)
+    size_t train = 512;
+    std::vector<Matrix*> inputs(train), targets(train);
+    for (size_t s = 0; s < train; s++) {
+        inputs[s] = mat_create(dims[0], 1);
+        targets[s] = mat_create(dims[4], 1);
+        for (size_t i = 0; i < dims[0]; i++) mat_set(inputs[s], i, 0, mat_get(X, i, s));
+        for (size_t i = 0; i < dims[4]; i++) mat_set(targets[s], i, 0, mat_get(ref, i, s));
+    }
+    FILE* saved = stdout;
+    stdout = fopen("/dev/null", "w");
+    keep->learning_rate = 0.05f;
+    lowrank_finetune(keep, inputs.data(), targets.data(), train, 10, 32, LOSS_MSE);
+    fclose(stdout);
+    stdout = saved;
+    LowRankScratch* scratch = lowrank_scratch_create(keep, eval);
+    lowrank_forward_batch(keep, X, out, scratch);
+    printf("rank   16 after 10 fine-tuning epochs on 512 samples: output error %.4f, argmax agreement %5.1f%%\n",
+           bench_rel_error(out, ref), bench_argmax_agreement(out, ref) * 100.0);
+
+    for (size_t s = 0; s < train; s++) {
+        mat_free(inputs[s]);
+        mat_free(targets[s]);
+    }
+    lowrank_scratch_free(scratch);
+    lowrank_free(keep);
+    mlp_batch_scratch_free(dense_scratch);
+    mat_free(xb);
+    mat_free(yb);
+    mat_free(X);
+    mat_free(ref);
+    mat_free(out);
+    mlp_free(mlp);
+}
+
+void bench_autotune() {
+    printf("\n=== Bench: GEMM autotuner, 784-1024-1024-256-10 batched forward ===\n");
+
+    size_t dims[] = {784, 1024, 1024, 256, 10};
+    MLP* mlp = bench_random_mlp(dims, 5, ACTIVATION_RELU);
+    const char* profile = "/tmp/nn_bench_gemm_profile.txt";
+    remove(profile);
+
+    size_t batches[] = {16, 256};
+    for (size_t bi = 0; bi < sizeof(batches) / sizeof(batches[0]); bi++) {
+        size_t batch = batches[bi];
+        Matrix* X = mat_create(dims[0], batch);
+        Matrix* Y_default = mat_create(dims[4], batch);
+        Matrix* Y_tuned = mat_create(dims[4], batch);
+        MLPBatchScratch* scratch = mlp_batch_scratch_create(mlp, batch);
+        for (size_t i = 0; i < X->rows; i++) {
+            rng_fill_uniform(rng_stream(11, 0), i * batch, X->data + i * X->stride, batch, 0.0f, 1.0f);
+        }
+
+        mat_gemm_clear_configs();
+        printf("batch %zu, first run:\n", batch);
+        AutotuneReport* report = mlp_autotune(mlp, batch, profile);
+        autotune_report_print(report);
+
+        // interleaved rounds of default and installed configs, medians
+        std::vector<double> t_default, t_tuned;
+        for (int r = 0; r < 11; r++) {
+            mat_gemm_clear_configs();
+            t_default.push_back(best_of(1, [&]() { mlp_forward_batch(mlp, X, Y_default, scratch); }));
+            for (size_t i = 0; i < report->num_shapes; i++) {
+                const AutotuneShape* shape = &report->shapes[i];
+                mat_gemm_set_config(shape->M, shape->N, shape->K, &shape->config);
+            }
+            t_tuned.push_back(best_of(1, [&]() { mlp_forward_batch(mlp, X, Y_tuned, scratch); }));
+        }
+        autotune_report_free(report);
+        double default_p50 = percentile(t_default, 50), tuned_p50 = percentile(t_tuned, 50);
+
+        float max_diff = 0.0f;
+        for (size_t i = 0; i < Y_default->rows; i++) {
+            for (size_t j = 0; j < batch; j++) {
+                float d = fabsf(mat_get(Y_default, i, j) - mat_get(Y_tuned, i, j));
+                if (d > max_diff) max_diff = d;
+            }
+        }
+
+        mat_gemm_clear_configs();
+        printf("batch %zu, restart with the profile:\n", batch);
+        report = mlp_autotune(mlp, batch, profile);
+        autotune_report_print(report);
+        autotune_report_free(report);
+
+        printf("batch %zu forward, median of 11 interleaved: default %.3f ms, tuned %.3f ms (%.2fx), max |diff| %.2e\n",
+               batch, default_p50 * 1e3, tuned_p50 * 1e3, default_p50 / tuned_p50, max_diff);
+
+        mlp_batch_scratch_free(scratch);
+        mat_free(X);
+        mat_free(Y_default);
+        mat_free(Y_tuned);
+    }
+
+    mat_gemm_clear_configs();
+    remove(profile);
+    mlp_free(mlp);
+}
+
+// Single-sample traffic where a share `repeat` of the requests re-sends one of
+// `hot` earlier feature vectors and the rest are new. The repeat ratios come
+// from BENCH_CACHE_REPEAT (comma separated, e.g. "0.5,0.95") if set.
+void bench_inference_cache() {
+    printf("\n=== Bench: input-keyed inference cache, 784-512-256-10, batch 1 ===\n");
+
+    size_t dims[] = {784, 512, 256, 10};
+    MLP* mlp = bench_random_mlp(dims, 4, ACTIVATION_RELU);
+    MLPBatchScratch* scratch = mlp_batch_scratch_create(mlp, 1);
+    const size_t requests = 20000, hot = 2000, capacity = 4096;
+
+    std::vector<double> ratios;
+    const char* env = getenv("BENCH_CACHE_REPEAT");
+    for (const char* p = env; p && *p; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL) {
+        ratios.push_back(atof(p));
+    }
+    if (ratios.empty()) ratios = {0.0, 0.5, 0.9, 0.99};
+
+    // the request stream: hot vectors are drawn from stream 0, fresh ones from stream 1
+    Matrix* pool = mat_create(hot + requests, dims[0]);
+    for (size_t i = 0; i < pool->rows; i++) {
+        rng_fill_uniform(rng_stream(31, 0), i * dims[0], pool->data + i * pool->stride, dims[0], 0.0f, 1.0f);
+    }
+    Matrix* input = mat_create(dims[0], 1);
+    Matrix* out_ref = mat_create(dims[3], 1);
+    Matrix* out_cached = mat_create(dims[3], 1);
+    std::vector<size_t> order(requests);
+
+    printf("%zu requests, %zu hot inputs, capacity %zu\n", requests, hot, capacity);
+    for (size_t r = 0; r < ratios.size(); r++) {
+        Rng rng;
+        rng_init(&rng, 8, r);
+        for (size_t i = 0; i < requests; i++) {
+            order[i] = rng_uniform(&rng) < ratios[r] ? rng_below(&rng, hot) : hot + i;
+        }
+        auto load = [&](size_t i) {
+            const float* row = pool->data + order[i] * pool->stride;
+            for (size_t k = 0; k < dims[0]; k++) input->data[k] = row[k];
+        };
+
+        double start = now_sec();
+        for (size_t i = 0; i < requests; i++) {
+            load(i);
+            mlp_forward_batch(mlp, input, out_ref, scratch);
+        }
+        double t_plain = now_sec() - start;
+
+        InferCache* cache = infer_cache_create(mlp, capacity, 0);
+        start = now_sec();
+        for (size_t i = 0; i < requests; i++) {
+            load(i);
+            mlp_forward_cached(cache, mlp, input, out_cached, scratch);
+        }
+        double t_cached = now_sec() - start;
+
+        InferCacheStats stats = infer_cache_stats(cache);
+
+        // every cached answer must match a fresh forward pass bit for bit
+        size_t wrong = 0;
+        for (size_t i = 0; i < requests; i += 97) {
+            load(i);
+            mlp_forward_batch(mlp, input, out_ref, scratch);
+            mlp_forward_cached(cache, mlp, input, out_cached, scratch);
+            if (memcmp(out_ref->data, out_cached->data, dims[3] * sizeof(float)) != 0) wrong++;
+        }
+
+        printf("repeat %4.2f: uncached %7.2f us/req, cached %7.2f us/req (%5.2fx), hit rate %5.1f%%, "
+               "evictions %zu, mismatches %zu\n",
+               ratios[r], t_plain / requests * 1e6, t_cached / requests * 1e6, t_plain / t_cached,
+               stats.hit_rate * 100.0, stats.evictions, wrong);
+
+        // a weight update turns every entry stale, the next pass refills them
+        if (r + 1 == ratios.size()) {
+            mat_set(mlp->layers[0].weights, 0, 0, mat_get(mlp->layers[0].weights, 0, 0) + 0.01f);
+            mlp_mark_updated(mlp);
+            for (int pass = 0; pass < 2; pass++) {
+                InferCacheStats before = infer_cache_stats(cache);
+                for (size_t i = 0; i < hot; i++) {
+                    const float* row = pool->data + i * pool->stride;
+                    for (size_t k = 0; k < dims[0]; k++) input->data[k] = row[k];
+                    mlp_forward_cached(cache, mlp, input, out_cached, scratch);
+                }
+                stats = infer_cache_stats(cache);
+                printf("%s the weight update, %zu hot inputs: %zu hits, %zu stale\n",
+                       pass ? "second pass after" : "first pass after", hot,
+                       stats.hits - before.hits, stats.stale - before.stale);
+            }
+        }
+        infer_cache_free(cache);
+    }
+
+    mat_free(pool);
+    mat_free(input);
+    mat_free(out_ref);
+    mat_free(out_cached);
+    mlp_batch_scratch_free(scratch);
+    mlp_free(mlp);
+}
+
+int main() {
+    printf("=== Neural Network Benchmarks ===\n");
+
+    // fixed seed so every run times the same weights and inputs
+    rng_set_global_seed(42);
+
+    bench_allocator();
+    bench_layout();
+    bench_gemv_inference();
+    bench_inference_server();
+    bench_pipeline();
+    bench_data_parallel();
+    bench_snapshot_serving();
+    bench_checkpoint();
+    bench_init();
+    bench_model_pack();
+    bench_autoencoder();
+    bench_lowrank();
+    bench_autotune();
+    bench_inference_cache();
+
+    printf("\n=== All Benchmarks Complete ===\n");
+
+    return 0;
+}
@@ -2,11 +2,45 @@
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
 
 #include "Utils/Matrix.hpp"
 #include "Utils/Activation.hpp"
 #include "Utils/Loss.hpp"
 #include "Models/MLP/MLP.hpp"
+#include "Models/MLP/Pipeline.hpp"
+#include "Models/MLP/DataParallel.hpp"
+#include "Models/MLP/LowRank.hpp"
+#include "Models/MLP/Inference.hpp"
+#include "Models/MLP/InferenceCache.hpp"
+#include "Models/MLP/Snapshot.hpp"
+#include "Models/MLP/InferenceServer.hpp"
+#include "Models/MLP/ModelPack.hpp"
+#include "Models/MLP/Checkpoint.hpp"
+#include "Models/MLP/Autotune.hpp"
+#include "Models/Autoencoder/Autoencoder.hpp"
+
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+    printf("  [%s] %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) failures++;
+}
+
+// largest |a - b| over the largest |a|, 0 for two zero matrices
+static float rel_diff(const Matrix* a, const Matrix* b) {
+    float diff = 0.0f, scale = 0.0f;
+    for (size_t i = 0; i < a->rows; i++) {
+        for (size_t j = 0; j < a->cols; j++) {
+            float d = fabsf(mat_get(a, i, j) - mat_get(b, i, j));
+            if (d > diff) diff = d;
+            if (fabsf(mat_get(a, i, j)) > scale) scale = fabsf(mat_get(a, i, j));
+        }
+    }
+    return scale > 0.0f ? diff / scale : diff;
+}
 
 void test_training() {
     printf("\n=== Test: Training XOR Problem ===\n");
@@ -51,15 +85,1456 @@ void test_training() {
 
 }
 
-int main() {
+void test_activation_storage() {
+    printf("\n=== Test: compact saved activations vs fp32 ===\n");
+
+    // ReLU last so the final output goes through the bitmask
+    size_t dims[] = {24, 32, 32, 6};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_TANH, ACTIVATION_RELU};
+    MLP* base = create_mlp_seeded(dims, 4, activations, 0.05f, 7);
+
+    Matrix* input = mat_create(dims[0], 1);
+    Matrix* target = mat_create(dims[3], 1);
+    rng_fill_uniform(rng_stream(3, 0), 0, input->data, dims[0], -1.0f, 1.0f);
+    rng_fill_uniform(rng_stream(3, 1), 0, target->data, dims[3], 0.0f, 1.0f);
+
+    ActivationStorage modes[] = {ACT_STORE_FULL, ACT_STORE_FP16, ACT_STORE_BF16};
+    const char* names[] = {"fp32", "fp16", "bf16"};
+    const float tolerance[] = {0.0f, 5e-3f, 3e-2f};
+    MLP* nets[3];
+    size_t bytes[3];
+    for (int m = 0; m < 3; m++) {
+        nets[m] = mlp_clone(base);
+        mlp_set_activation_storage(nets[m], modes[m]);
+        mlp_train_prepare(nets[m], input);
+        mlp_train_sample(nets[m], input, target, LOSS_MSE);
+        bytes[m] = mlp_saved_activation_bytes(nets[m]);
+    }
+
+    for (int m = 1; m < 3; m++) {
+        float worst = 0.0f;
+        for (size_t l = 0; l < nets[0]->num_layers; l++) {
+            float w = rel_diff(nets[0]->layers[l].weight_grad, nets[m]->layers[l].weight_grad);
+            float b = rel_diff(nets[0]->layers[l].bias_grad, nets[m]->layers[l].bias_grad);
+            if (w > worst) worst = w;
+            if (b > worst) worst = b;
+        }
+        char what[128];
+        snprintf(what, sizeof(what), "%s gradients within %.0e of fp32 (worst %.2e)", names[m], tolerance[m], worst);
+        check(worst <= tolerance[m], what);
+        // layer 0 input + two hidden outputs at 2 bytes, the last output as one 64-bit mask word
+        size_t expect = (dims[0] + dims[1] + dims[2]) * 2 + 8;
+        snprintf(what, sizeof(what), "%s holds %zu bytes of activations (fp32: %zu)", names[m], bytes[m], bytes[0]);
+        check(bytes[m] == expect && bytes[m] < bytes[0], what);
+    }
+
+    // backward of a hidden layer on its own: packed modes keep its input in the
+    // previous layer's compact copy, which layer_backward cannot see
+    Matrix* g = mat_create(dims[2], 1);
+    Matrix* in_grad = mat_create(dims[1], 1);
+    rng_fill_uniform(rng_stream(3, 2), 0, g->data, dims[2], -1.0f, 1.0f);
+    check(layer_backward(g, &nets[0]->layers[1], in_grad, activations[1]) == 0, "fp32 layer_backward on a hidden layer");
+    Matrix* full_grad = mat_copy(nets[0]->layers[1].weight_grad);
+    check(mlp_layer_backward(nets[0], 1, g, in_grad) == 0 && rel_diff(full_grad, nets[0]->layers[1].weight_grad) == 0.0f,
+          "fp32 mlp_layer_backward = layer_backward");
+    int refused = 1, close = 1;
+    for (int m = 1; m < 3; m++) {
+        refused &= layer_backward(g, &nets[m]->layers[1], in_grad, activations[1]) == -1;
+        close &= mlp_layer_backward(nets[m], 1, g, in_grad) == 0 &&
+                 rel_diff(full_grad, nets[m]->layers[1].weight_grad) <= tolerance[m];
+    }
+    check(refused, "packed layer_backward without the input refuses");
+    check(close, "packed mlp_layer_backward reads the previous saved output");
+    mat_free(full_grad);
+    mat_free(g);
+    mat_free(in_grad);
+
+    for (int m = 0; m < 3; m++) mlp_free(nets[m]);
+    mlp_free(base);
+    mat_free(input);
+    mat_free(target);
+}
+
+void test_matrix_expressions() {
+    printf("\n=== Test: lazy matrix expressions vs element loops ===\n");
+
+    // a dense operand, a padded one and a strided view, so both evaluation paths run
+    Matrix* a = mat_create(13, 21);
+    Matrix* b = mat_create_ex(13, 21, MAT_LAYOUT_PADDED);
+    Matrix* parent = mat_create(20, 30);
+    Matrix* z = mat_view(parent, 3, 5, 13, 21);
+    Matrix* out = mat_create(13, 21);
+    for (size_t i = 0; i < 13; i++) {
+        rng_fill_uniform(rng_stream(5, 0), i * 21, a->data + i * a->stride, 21, -2.0f, 2.0f);
+        rng_fill_uniform(rng_stream(5, 1), i * 21, b->data + i * b->stride, 21, -2.0f, 2.0f);
+        rng_fill_uniform(rng_stream(5, 2), i * 21, z->data + i * z->stride, 21, -2.0f, 2.0f);
+    }
+
+    float worst = 0.0f, sum_ref = 0.0f;
+    mat_assign(out, (mx(a) - mx(b)) * mx_map(sigmoid_derivative, mx(z)) * 0.5f + mx_clamp(-mx(a), -1.0f, 1.0f));
+    for (size_t i = 0; i < 13; i++) {
+        for (size_t j = 0; j < 21; j++) {
+            float av = mat_get(a, i, j), bv = mat_get(b, i, j), zv = mat_get(z, i, j);
+            float c = -av < -1.0f ? -1.0f : (-av > 1.0f ? 1.0f : -av);
+            float ref = (av - bv) * sigmoid_derivative(zv) * 0.5f + c;
+            float d = fabsf(mat_get(out, i, j) - ref);
+            if (d > worst) worst = d;
+            sum_ref += (av - bv) * (av - bv);
+        }
+    }
+    check(worst <= 1e-6f, "mixed dense / padded / view expression matches the element loop");
+    check(fabsf(mat_sum(mx_square(mx(a) - mx(b))) - sum_ref) <= 1e-3f * sum_ref, "mat_sum of a squared difference");
+
+    // out aliasing a leaf: every element only reads its own position
+    Matrix* copy = mat_copy(a);
+    mat_assign(a, mx(a) * 2.0f - mx(b));
+    worst = 0.0f;
+    for (size_t i = 0; i < 13; i++) {
+        for (size_t j = 0; j < 21; j++) {
+            float d = fabsf(mat_get(a, i, j) - (2.0f * mat_get(copy, i, j) - mat_get(b, i, j)));
+            if (d > worst) worst = d;
+        }
+    }
+    check(worst <= 1e-6f, "in-place assignment over a leaf");
+
+    Matrix* wrong = mat_create(21, 13);
+    check(mat_assign(wrong, mx(a) + mx(b)) == -1, "shape mismatch is rejected");
+
+    mat_free(wrong);
+    mat_free(copy);
+    mat_free(out);
+    mat_free(z);
+    mat_free(parent);
+    mat_free(b);
+    mat_free(a);
+}
+
+static void fill_uniform(Matrix* m, uint64_t seed, uint64_t stream) {
+    for (size_t i = 0; i < m->rows; i++) {
+        rng_fill_uniform(rng_stream(seed, stream), i * m->cols, m->data + i * m->stride, m->cols, -2.0f, 2.0f);
+    }
+}
+
+// Every element of parent outside the window `view` still equals saved
+static int untouched_outside(const Matrix* parent, const Matrix* saved, const Matrix* view) {
+    size_t offset = (size_t)(view->data - parent->data);
+    size_t row = offset / parent->stride, col = offset % parent->stride;
+    for (size_t i = 0; i < parent->rows; i++) {
+        for (size_t j = 0; j < parent->cols; j++) {
+            int inside = i >= row && i < row + view->rows && j >= col && j < col + view->cols;
+            if (!inside && mat_get(parent, i, j) != mat_get(saved, i, j)) return 0;
+        }
+    }
+    return 1;
+}
+
+void test_view_ops() {
+    printf("\n=== Test: matrix ops on views vs dense copies ===\n");
+
+    typedef int (*BinaryOp)(const Matrix*, const Matrix*, Matrix*);
+    const BinaryOp ops[] = {mat_add, mat_sub, mat_hadamard};
+    // interior window, column range, row range (contiguous), one column, one row
+    const size_t windows[][4] = {{2, 3, 5, 7}, {0, 4, 9, 6}, {1, 0, 4, 13}, {0, 5, 9, 1}, {6, 2, 1, 10}};
+
+    Matrix* pa = mat_create(9, 13);
+    Matrix* pb = mat_create(9, 13);
+    Matrix* pc = mat_create(9, 13);
+    fill_uniform(pa, 107, 0);
+    fill_uniform(pb, 107, 1);
+    fill_uniform(pc, 107, 2);
+    Matrix* saved_a = mat_copy(pa);
+    Matrix* saved_b = mat_copy(pb);
+    Matrix* saved_c = mat_copy(pc);
+
+    int match = 1, inside_only = 1, inputs_kept = 1;
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        const size_t* win = windows[w];
+        Matrix* va = mat_view(pa, win[0], win[1], win[2], win[3]);
+        Matrix* vb = mat_view(pb, win[0], win[1], win[2], win[3]);
+        Matrix* vc = mat_view(pc, win[0], win[1], win[2], win[3]);
+        Matrix* da = mat_copy(va);
+        Matrix* db = mat_copy(vb);
+        Matrix* dc = mat_create(win[2], win[3]);
+
+        for (size_t o = 0; o < 3; o++) {
+            mat_copy_into(saved_c, pc);
+            match &= ops[o](va, vb, vc) == 0 && ops[o](da, db, dc) == 0 && rel_diff(dc, vc) == 0.0f;
+            inside_only &= untouched_outside(pc, saved_c, vc);
+        }
+
+        mat_copy_into(saved_c, pc);
+        mat_scale(va, -1.5f, vc);
+        mat_scale(da, -1.5f, dc);
+        match &= rel_diff(dc, vc) == 0.0f;
+        inside_only &= untouched_outside(pc, saved_c, vc);
+
+        mat_copy_into(saved_c, pc);
+        match &= mat_copy_into(va, vc) == 0 && rel_diff(da, vc) == 0.0f;
+        inside_only &= untouched_outside(pc, saved_c, vc);
+
+        mat_copy_into(saved_c, pc);
+        mat_fill(vc, 3.0f);
+        mat_zero(vc);
+        mat_zero(dc);
+        match &= rel_diff(dc, vc) == 0.0f;
+        inside_only &= untouched_outside(pc, saved_c, vc);
+
+        inputs_kept &= rel_diff(saved_a, pa) == 0.0f && rel_diff(saved_b, pb) == 0.0f;
+        mat_free(va);
+        mat_free(vb);
+        mat_free(vc);
+        mat_free(da);
+        mat_free(db);
+        mat_free(dc);
+    }
+    check(match, "add, sub, hadamard, scale, copy and zero on views match dense copies");
+    check(inside_only, "nothing written outside the result view");
+    check(inputs_kept, "operand parents unchanged");
+
+    // products with every operand an interior view
+    mat_copy_into(saved_c, pc);
+    Matrix* va = mat_view(pa, 2, 3, 5, 7);
+    Matrix* vb = mat_view(pb, 1, 2, 7, 4);
+    Matrix* vc = mat_view(pc, 3, 6, 5, 4);
+    Matrix* da = mat_copy(va);
+    Matrix* db = mat_copy(vb);
+    Matrix* dc = mat_create(5, 4);
+    mat_mul(va, vb, vc);
+    mat_mul(da, db, dc);
+    check(rel_diff(dc, vc) == 0.0f && untouched_outside(pc, saved_c, vc), "mat_mul on views");
+
+    // b with one column takes the matrix-vector path
+    Matrix* vx = mat_view(pb, 1, 8, 7, 1);
+    Matrix* vy = mat_view(pc, 2, 12, 5, 1);
+    Matrix* dx = mat_copy(vx);
+    Matrix* dy = mat_create(5, 1);
+    mat_copy_into(saved_c, pc);
+    mat_mul(va, vx, vy);
+    mat_mul(da, dx, dy);
+    check(rel_diff(dy, vy) == 0.0f && untouched_outside(pc, saved_c, vy), "matrix-vector mat_mul on column views");
+    mat_free(vx);
+    mat_free(vy);
+    mat_free(dx);
+    mat_free(dy);
+
+    Matrix* vt = mat_view(pc, 1, 1, 7, 5);
+    Matrix* dt = mat_create(7, 5);
+    mat_copy_into(saved_c, pc);
+    mat_transpose(va, vt);
+    mat_transpose(da, dt);
+    check(rel_diff(dt, vt) == 0.0f && untouched_outside(pc, saved_c, vt), "mat_transpose into a view");
+
+    mat_free(vt);
+    mat_free(dt);
+    mat_free(va);
+    mat_free(vb);
+    mat_free(vc);
+    mat_free(da);
+    mat_free(db);
+    mat_free(dc);
+    mat_free(saved_a);
+    mat_free(saved_b);
+    mat_free(saved_c);
+    mat_free(pa);
+    mat_free(pb);
+    mat_free(pc);
+}
+
+// Padding lanes of a padded matrix are all still zero
+static int padding_clean(const Matrix* m) {
+    for (size_t i = 0; i < m->rows; i++) {
+        for (size_t j = m->cols; j < m->stride; j++) {
+            if (m->data[i * m->stride + j] != 0.0f) return 0;
+        }
+    }
+    return 1;
+}
+
+// c = op(a) * op(b) by the definition, ta / tb transpose the operand
+static void naive_product(const Matrix* a, int ta, const Matrix* b, int tb, Matrix* c) {
+    size_t K = ta ? a->rows : a->cols;
+    for (size_t i = 0; i < c->rows; i++) {
+        for (size_t j = 0; j < c->cols; j++) {
+            double sum = 0.0;
+            for (size_t k = 0; k < K; k++) {
+                float av = ta ? mat_get(a, k, i) : mat_get(a, i, k);
+                float bv = tb ? mat_get(b, j, k) : mat_get(b, k, j);
+                sum += (double)av * bv;
+            }
+            mat_set(c, i, j, (float)sum);
+        }
+    }
+}
+
+void test_padded_kernels() {
+    printf("\n=== Test: padded kernels vs unpadded, padding lanes untouched ===\n");
+
+    // no dimension is a multiple of the 16-float SIMD width
+    const size_t M = 13, K = 21, N = 35;
+    const MatLayout layouts[] = {MAT_LAYOUT_DENSE, MAT_LAYOUT_PADDED};
+    Matrix *a[2], *b[2], *at[2], *bt[2], *x[2], *y[2], *c[2];
+    for (int l = 0; l < 2; l++) {
+        a[l] = mat_create_ex(M, K, layouts[l]);
+        b[l] = mat_create_ex(K, N, layouts[l]);
+        at[l] = mat_create_ex(K, M, layouts[l]);
+        bt[l] = mat_create_ex(N, K, layouts[l]);
+        x[l] = mat_create_ex(M, N, layouts[l]);
+        y[l] = mat_create_ex(M, N, layouts[l]);
+        c[l] = mat_create_ex(M, N, layouts[l]);
+        fill_uniform(a[l], 109, 0);
+        fill_uniform(b[l], 109, 1);
+        fill_uniform(at[l], 109, 2);
+        fill_uniform(bt[l], 109, 3);
+        fill_uniform(x[l], 109, 4);
+        fill_uniform(y[l], 109, 5);
+    }
+    check(mat_is_padded(c[1]) && c[1]->stride != N, "padded layout has padding lanes");
+
+    Matrix* ref = mat_create(M, N);
+    int match = 1, clean = 1;
+    naive_product(a[0], 0, b[0], 0, ref);
+    for (int l = 0; l < 2; l++) {
+        match &= mat_mul(a[l], b[l], c[l]) == 0 && rel_diff(ref, c[l]) < 1e-5f;
+        clean &= padding_clean(c[1]);
+    }
+    match &= rel_diff(c[0], c[1]) == 0.0f;
+    check(match, "mat_mul padded = unpadded = reference");
+
+    match = 1;
+    naive_product(at[0], 1, b[0], 0, ref);
+    for (int l = 0; l < 2; l++) {
+        match &= mat_mul_tn(at[l], b[l], c[l], 0) == 0 && rel_diff(ref, c[l]) < 1e-5f;
+        clean &= padding_clean(c[1]);
+        mat_mul_tn(at[l], b[l], c[l], 1);
+        mat_scale(c[l], 0.5f, c[l]);
+        match &= rel_diff(ref, c[l]) < 1e-5f;
+        clean &= padding_clean(c[1]);
+    }
+    match &= rel_diff(c[0], c[1]) == 0.0f;
+    check(match, "mat_mul_tn (and accumulate) padded = unpadded = reference");
+
+    match = 1;
+    naive_product(a[0], 0, bt[0], 1, ref);
+    for (int l = 0; l < 2; l++) {
+        match &= mat_mul_nt(a[l], bt[l], c[l], 0) == 0 && rel_diff(ref, c[l]) < 1e-5f;
+        clean &= padding_clean(c[1]);
+        mat_mul_nt(a[l], bt[l], c[l], 1);
+        mat_scale(c[l], 0.5f, c[l]);
+        match &= rel_diff(ref, c[l]) < 1e-5f;
+        clean &= padding_clean(c[1]);
+    }
+    match &= rel_diff(c[0], c[1]) == 0.0f;
+    check(match, "mat_mul_nt (and accumulate) padded = unpadded = reference");
+
+    // element-wise: the padded path runs over whole padded rows
+    typedef int (*BinaryOp)(const Matrix*, const Matrix*, Matrix*);
+    const BinaryOp ops[] = {mat_add, mat_sub, mat_hadamard};
+    match = 1;
+    for (size_t o = 0; o < 3; o++) {
+        for (int l = 0; l < 2; l++) {
+            match &= ops[o](x[l], y[l], c[l]) == 0;
+            clean &= padding_clean(c[1]);
+        }
+        match &= rel_diff(c[0], c[1]) == 0.0f;
+        // mixed layouts take the row-by-row path
+        match &= ops[o](x[1], y[0], c[0]) == 0 && rel_diff(c[0], c[1]) == 0.0f;
+        match &= ops[o](x[0], y[0], c[1]) == 0 && rel_diff(c[0], c[1]) == 0.0f;
+        clean &= padding_clean(c[1]);
+    }
+    for (int l = 0; l < 2; l++) mat_scale(x[l], -3.0f, c[l]);
+    match &= rel_diff(c[0], c[1]) == 0.0f;
+    clean &= padding_clean(c[1]);
+    check(match, "add, sub, hadamard, scale padded = unpadded");
+    check(clean && padding_clean(a[1]) && padding_clean(b[1]) && padding_clean(at[1]) && padding_clean(bt[1]) &&
+          padding_clean(x[1]) && padding_clean(y[1]), "padding lanes stay zero");
+
+    mat_free(ref);
+    for (int l = 0; l < 2; l++) {
+        mat_free(a[l]);
+        mat_free(b[l]);
+        mat_free(at[l]);
+        mat_free(bt[l]);
+        mat_free(x[l]);
+        mat_free(y[l]);
+        mat_free(c[l]);
+    }
+}
+
+void test_allocator_accounting() {
+    printf("\n=== Test: pool allocator accounting ===\n");
+
+    MatAllocator* previous = mat_get_allocator();
+    mat_set_allocator(&mat_pool_allocator);
+    mat_pool_trim();
+
+    // 600 bytes of data + the header land in the 1 KiB class
+    size_t base = mat_alloc_stats().live_bytes;
+    Matrix* m = mat_create(150, 1);
+    size_t held = mat_alloc_stats().live_bytes - base;
+    check(m && held == mat_pool_class_bytes(mat_pool_class(m->block_bytes)) && held == 1024,
+          "live bytes count the whole size class");
+    mat_free(m);
+
+    // a cap between the requested and the held size refuses the block
+    mat_alloc_set_limit(base + 1000);
+    m = mat_create(150, 1);
+    check(m == NULL, "limit applies to the held size");
+    mat_free(m);
+    mat_alloc_set_limit(0);
+
+    // freeing 48 MiB of 1 MiB blocks parks at most the per-thread budget
+    const size_t count = 48;
+    Matrix* blocks[count];
+    for (size_t i = 0; i < count; i++) blocks[i] = mat_create(200000, 1);
+    size_t cached_before = mat_alloc_stats().pool_cached_bytes;
+    for (size_t i = 0; i < count; i++) mat_free(blocks[i]);
+    size_t parked = mat_alloc_stats().pool_cached_bytes - cached_before;
+    check(parked > 0 && parked <= MAT_POOL_THREAD_CACHE_BYTES, "per-thread cache stays within its budget");
+
+    mat_pool_trim();
+    mat_set_allocator(previous);
+}
+
+// Adds the MSE gradients of samples [first, first + count) to the layers' weight_grad / bias_grad,
+// sample by sample on one thread
+static void reference_accumulate_grads(MLP* mlp, Matrix** inputs, Matrix** targets, size_t first, size_t count) {
+    size_t L = mlp->num_layers;
+    Matrix* acts[8];
+    Matrix* grads[8];
+    for (size_t l = 0; l < L; l++) {
+        acts[l] = mat_create(mlp->layers[l].weights->rows, 1);
+        grads[l] = mat_create(mlp->layers[l].weights->rows, 1);
+    }
+
+    for (size_t i = first; i < first + count; i++) {
+        for (size_t l = 0; l < L; l++) {
+            layer_forward_batch(&mlp->layers[l], mlp->activations[l], l ? acts[l - 1] : inputs[i], acts[l]);
+        }
+        compute_loss_derivative(LOSS_MSE, acts[L - 1], targets[i], grads[L - 1]);
+        for (size_t l = L; l-- > 0;) {
+            layer_backward_batch(&mlp->layers[l], mlp->activations[l], l ? acts[l - 1] : inputs[i], acts[l],
+                                 grads[l], l ? grads[l - 1] : NULL,
+                                 mlp->layers[l].weight_grad, mlp->layers[l].bias_grad);
+        }
+    }
+
+    for (size_t l = 0; l < L; l++) {
+        mat_free(acts[l]);
+        mat_free(grads[l]);
+    }
+}
+
+// One epoch of mean-gradient SGD, a step of step_samples at a time
+static void reference_minibatch_epoch(MLP* mlp, Matrix** inputs, Matrix** targets, size_t num_samples,
+                                      size_t step_samples) {
+    mlp_zero_grads(mlp);
+    for (size_t first = 0; first < num_samples; first += step_samples) {
+        size_t in_step = num_samples - first < step_samples ? num_samples - first : step_samples;
+        reference_accumulate_grads(mlp, inputs, targets, first, in_step);
+        for (size_t l = 0; l < mlp->num_layers; l++) layer_apply_grads(&mlp->layers[l], mlp->learning_rate / in_step);
+    }
+}
+
+// Caps the allocator at what is live now, so every later view header fails
+static void cap_allocations(void*, size_t, float) {
+    mat_alloc_set_limit(mat_alloc_stats().live_bytes);
+}
+
+void test_pipeline_training() {
+    printf("\n=== Test: pipeline-parallel training vs sequential mini-batch SGD ===\n");
+
+    size_t dims[] = {6, 16, 12, 10, 3};
+    ActivationType activations[] = {ACTIVATION_TANH, ACTIVATION_RELU, ACTIVATION_TANH, ACTIVATION_SIGMOID};
+    MLP* base = create_mlp_seeded(dims, 5, activations, 0.1f, 11);
+
+    // 3 micro-batches of 3 per step: steps of 9, 9 and 2, the last one a short micro-batch
+    const size_t n = 20, micro_batch = 3, micro_per_step = 3, epochs = 3;
+    Matrix* inputs[n];
+    Matrix* targets[n];
+    for (size_t i = 0; i < n; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[4], 1);
+        rng_fill_uniform(rng_stream(13, 0), i * dims[0], inputs[i]->data, dims[0], -1.0f, 1.0f);
+        rng_fill_uniform(rng_stream(13, 1), i * dims[4], targets[i]->data, dims[4], 0.0f, 1.0f);
+    }
+
+    MLP* reference = mlp_clone(base);
+    for (size_t e = 0; e < epochs; e++) {
+        reference_minibatch_epoch(reference, inputs, targets, n, micro_batch * micro_per_step);
+    }
+
+    for (size_t stages = 1; stages <= 4; stages++) {
+        MLP* net = mlp_clone(base);
+        float loss = mlp_train_pipeline(net, inputs, targets, n, epochs, LOSS_MSE, 0.0f, stages, micro_batch,
+                                        micro_per_step);
+        float worst = 0.0f;
+        for (size_t l = 0; l < net->num_layers; l++) {
+            float w = rel_diff(reference->layers[l].weights, net->layers[l].weights);
+            float b = rel_diff(reference->layers[l].bias, net->layers[l].bias);
+            if (w > worst) worst = w;
+            if (b > worst) worst = b;
+        }
+        char what[128];
+        snprintf(what, sizeof(what), "%zu stage(s) match sequential training (worst %.2e)", stages, worst);
+        check(loss >= 0.0f && worst <= 1e-5f, what);
+        mlp_free(net);
+    }
+
+    // views that cannot be allocated must stop every stage instead of leaving one waiting forever
+    MLP* net = mlp_clone(base);
+    net->epoch_hook = cap_allocations;
+    float loss = mlp_train_pipeline(net, inputs, targets, n, epochs, LOSS_MSE, 0.0f, 4, micro_batch, micro_per_step);
+    mat_alloc_set_limit(0);
+    check(loss == -1.0f, "failed views stop the pipeline with an error");
+    mlp_free(net);
+
+    for (size_t i = 0; i < n; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+    mlp_free(reference);
+    mlp_free(base);
+}
+
+// sum of (y - x)^2 in double, so finite differences are not drowned by rounding
+static double squared_error(const Matrix* y, const Matrix* x) {
+    double sum = 0.0;
+    for (size_t i = 0; i < y->rows; i++) {
+        for (size_t j = 0; j < y->cols; j++) {
+            double d = (double)mat_get(y, i, j) - mat_get(x, i, j);
+            sum += d * d;
+        }
+    }
+    return sum;
+}
+
+void test_tied_autoencoder() {
+    printf("\n=== Test: tied decoder vs an untied decoder holding W^T ===\n");
+
+    // ReLU throughout: the derivatives are taken on the layer output, which is exact only for ReLU,
+    // so the finite-difference check below holds
+    size_t dims[] = {10, 7, 4};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_RELU, ACTIVATION_RELU, ACTIVATION_RELU};
+    const size_t L = 2, batch = 5;
+    const float lr = 0.05f;
+    // create_autoencoder draws from the global seed; pin it so the probes below sit away from ReLU kinks
+    rng_set_global_seed(29);
+    Autoencoder* tied = create_autoencoder(dims, 3, activations, lr, 1);
+    Autoencoder* untied = create_autoencoder(dims, 3, activations, lr, 0);
+
+    // same encoder, untied decoder layer j = transpose of encoder layer L-1-j, non-zero decoder biases
+    mlp_copy_params(untied->encoder, tied->encoder);
+    for (size_t j = 0; j < L; j++) {
+        mat_transpose(ae_tied_layer(tied, j)->weights, untied->decoder[j].weights);
+        Matrix* bias = tied->decoder[j].bias;
+        rng_fill_uniform(rng_stream(23, j), 0, bias->data, bias->rows, -0.2f, 0.2f);
+        mat_copy_into(bias, untied->decoder[j].bias);
+    }
+
+    Matrix* X = mat_create(dims[0], batch);
+    for (size_t i = 0; i < dims[0]; i++) {
+        rng_fill_uniform(rng_stream(23, 9), i * batch, X->data + i * X->stride, batch, 0.0f, 1.0f);
+    }
+    Matrix* y_tied = mat_create(dims[0], batch);
+    Matrix* y_untied = mat_create(dims[0], batch);
+    autoencoder_reconstruct(tied, X, y_tied);
+    autoencoder_reconstruct(untied, X, y_untied);
+    check(rel_diff(y_untied, y_tied) <= 1e-6f, "tied forward matches the untied decoder");
+
+    // central differences of the batch loss for a few tied weights, before the step moves them
+    Matrix* W = tied->encoder->layers[1].weights;
+    const size_t probes[][2] = {{0, 0}, {1, 3}, {3, 6}};
+    float numeric[3];
+    for (size_t p = 0; p < 3; p++) {
+        float* w = W->data + probes[p][0] * W->stride + probes[p][1];
+        const float h = 1e-3f, saved = *w;
+        *w = saved + h;
+        autoencoder_reconstruct(tied, X, y_tied);
+        double up = squared_error(y_tied, X);
+        *w = saved - h;
+        autoencoder_reconstruct(tied, X, y_tied);
+        double down = squared_error(y_tied, X);
+        *w = saved;
+        numeric[p] = (float)((up - down) / (2.0 * h));
+    }
+
+    Matrix* before[L];
+    for (size_t l = 0; l < L; l++) before[l] = mat_copy(tied->encoder->layers[l].weights);
+    float loss_tied = autoencoder_train_batch(tied, X);
+    float loss_untied = autoencoder_train_batch(untied, X);
+    check(loss_tied >= 0.0f && fabsf(loss_tied - loss_untied) <= 1e-6f * loss_untied, "same loss");
+
+    // the tied step moves W by the encoder and the decoder gradient: W' = E' + D'^T - W
+    float worst = 0.0f;
+    for (size_t l = 0; l < L; l++) {
+        Matrix* decoder_t = mat_create(dims[l + 1], dims[l]);
+        mat_transpose(untied->decoder[L - 1 - l].weights, decoder_t);
+        Matrix* expect = mat_create(dims[l + 1], dims[l]);
+        mat_assign(expect, mx(untied->encoder->layers[l].weights) + mx(decoder_t) - mx(before[l]));
+        float d = rel_diff(expect, tied->encoder->layers[l].weights);
+        if (d > worst) worst = d;
+        d = rel_diff(untied->decoder[l].bias, tied->decoder[l].bias);
+        if (d > worst) worst = d;
+        mat_free(decoder_t);
+        mat_free(expect);
+    }
+    char what[128];
+    snprintf(what, sizeof(what), "tied update = encoder + transposed decoder update (worst %.2e)", worst);
+    check(worst <= 1e-5f, what);
+
+    // the applied step was rate = lr / batch times the summed gradient
+    float diff = 0.0f, scale = 0.0f;
+    for (size_t p = 0; p < 3; p++) {
+        size_t i = probes[p][0], j = probes[p][1];
+        float analytic = (mat_get(before[1], i, j) - mat_get(W, i, j)) * batch / lr;
+        if (fabsf(analytic - numeric[p]) > diff) diff = fabsf(analytic - numeric[p]);
+        if (fabsf(numeric[p]) > scale) scale = fabsf(numeric[p]);
+    }
+    worst = diff / scale;
+    snprintf(what, sizeof(what), "tied weight gradient matches finite differences (worst %.2e)", worst);
+    check(worst <= 1e-2f, what);
+
+    for (size_t l = 0; l < L; l++) mat_free(before[l]);
+    mat_free(X);
+    mat_free(y_tied);
+    mat_free(y_untied);
+    autoencoder_free(tied);
+    autoencoder_free(untied);
+}
+
+void test_lowrank_gradients() {
+    printf("\n=== Test: low-rank fine-tuning vs the dense backward of W = U V ===\n");
+
+    // two factorized layers and a dense one, so every branch of lowrank_layer_backward runs
+    size_t dims[] = {12, 16, 12, 3};
+    ActivationType activations[] = {ACTIVATION_TANH, ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    size_t ranks[] = {4, 4, 0};
+    const size_t n = 8;
+    const float lr = 0.5f;
+    MLP* dense = create_mlp_seeded(dims, 4, activations, lr, 31);
+    LowRankMLP* net = mlp_lowrank_compress(dense, ranks, 1);
+    check(net && net->layers[0].rank == 4 && net->layers[1].rank == 4 && net->layers[2].rank == 0,
+          "layers 0 and 1 factorized, layer 2 dense");
+
+    // the dense reference holds exactly U V, so both compute the same function
+    for (size_t l = 0; l < 3; l++) {
+        if (net->layers[l].rank) mat_mul(net->layers[l].U, net->layers[l].V, dense->layers[l].weights);
+    }
+
+    Matrix* inputs[n];
+    Matrix* targets[n];
+    Matrix* X = mat_create(dims[0], n);
+    for (size_t i = 0; i < n; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[3], 1);
+        rng_fill_uniform(rng_stream(37, 0), i * dims[0], inputs[i]->data, dims[0], -1.0f, 1.0f);
+        rng_fill_uniform(rng_stream(37, 1), i * dims[3], targets[i]->data, dims[3], 0.0f, 1.0f);
+    }
+    mlp_gather_columns(inputs, 0, n, X);
+
+    Matrix* y_dense = mat_create(dims[3], n);
+    Matrix* y_lowrank = mat_create(dims[3], n);
+    MLPBatchScratch* dense_scratch = mlp_batch_scratch_create(dense, n);
+    LowRankScratch* lowrank_scratch = lowrank_scratch_create(net, n);
+    mlp_forward_batch(dense, X, y_dense, dense_scratch);
+    lowrank_forward_batch(net, X, y_lowrank, lowrank_scratch);
+    check(rel_diff(y_dense, y_lowrank) <= 1e-5f, "factorized forward matches the dense forward");
+
+    // summed dense gradients of the batch, then one full-batch fine-tuning step on U and V
+    mlp_zero_grads(dense);
+    reference_accumulate_grads(dense, inputs, targets, 0, n);
+    Matrix* U[2];
+    Matrix* V[2];
+    Matrix* bias[3];
+    for (size_t l = 0; l < 3; l++) {
+        if (l < 2) {
+            U[l] = mat_copy(net->layers[l].U);
+            V[l] = mat_copy(net->layers[l].V);
+        }
+        bias[l] = mat_copy(net->layers[l].bias);
+    }
+    Matrix* W2 = mat_copy(net->layers[2].weights);
+    float loss = lowrank_finetune(net, inputs, targets, n, 1, n, LOSS_MSE);
+
+    // recover the summed gradients from the applied step (rate = lr / n) and compare them with
+    // the chain rule through W = U V: dU = dW V^T, dV = U^T dW
+    float worst = 0.0f;
+    for (size_t l = 0; l < 3; l++) {
+        const Layer* ref = &dense->layers[l];
+        LowRankLayer* layer = &net->layers[l];
+        float d;
+        if (layer->rank) {
+            Matrix* expect_u = mat_create(dims[l + 1], layer->rank);
+            Matrix* expect_v = mat_create(layer->rank, dims[l]);
+            mat_mul_nt(ref->weight_grad, V[l], expect_u, 0);
+            mat_mul_tn(U[l], ref->weight_grad, expect_v, 0);
+            mat_assign(U[l], (mx(U[l]) - mx(layer->U)) * (n / lr));
+            mat_assign(V[l], (mx(V[l]) - mx(layer->V)) * (n / lr));
+            d = fmaxf(rel_diff(expect_u, U[l]), rel_diff(expect_v, V[l]));
+            mat_free(expect_u);
+            mat_free(expect_v);
+        } else {
+            mat_assign(W2, (mx(W2) - mx(layer->weights)) * (n / lr));
+            d = rel_diff(ref->weight_grad, W2);
+        }
+        if (d > worst) worst = d;
+        mat_assign(bias[l], (mx(bias[l]) - mx(layer->bias)) * (n / lr));
+        d = rel_diff(ref->bias_grad, bias[l]);
+        if (d > worst) worst = d;
+    }
+    char what[128];
+    snprintf(what, sizeof(what), "U, V, W and bias steps match the dense gradients (worst %.2e)", worst);
+    check(loss >= 0.0f && worst <= 1e-3f, what);
+
+    for (size_t l = 0; l < 3; l++) {
+        if (l < 2) {
+            mat_free(U[l]);
+            mat_free(V[l]);
+        }
+        mat_free(bias[l]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+    mat_free(W2);
+    mat_free(X);
+    mat_free(y_dense);
+    mat_free(y_lowrank);
+    mlp_batch_scratch_free(dense_scratch);
+    lowrank_scratch_free(lowrank_scratch);
+    lowrank_free(net);
+    mlp_free(dense);
+}
+
+void test_inference_cache() {
+    printf("\n=== Test: inference cache under concurrent lookups and version bumps ===\n");
+
+    size_t dims[] = {9, 16, 3};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    MLP* mlp = create_mlp_seeded(dims, 3, activations, 0.1f, 41);
+    // 60 distinct inputs over 5 shards of 8 slots: hits, misses and evictions all happen
+    InferCache* cache = infer_cache_create(mlp, 40, 5);
+    check(cache != NULL, "cache created");
+
+    // 4 readers, each checking every answer against a plain forward, while a
+    // fifth thread keeps bumping the parameter version (the weights stay the same,
+    // so an answer can only be wrong if a lookup or insert races)
+    const int threads = 4, iters = 5000;
+    std::atomic<int> errors(0), mismatches(0), stop(0);
+    std::thread bumper([&] {
+        while (!stop.load()) {
+            mlp_mark_updated(mlp);
+            std::this_thread::yield();
+        }
+    });
+    std::thread readers[threads];
+    for (int t = 0; t < threads; t++) {
+        readers[t] = std::thread([&, t] {
+            MLPBatchScratch* scratch = mlp_batch_scratch_create(mlp, 1);
+            Matrix* x = mat_create(dims[0], 1);
+            Matrix* y = mat_create(dims[2], 1);
+            Matrix* ref = mat_create(dims[2], 1);
+            Rng rng;
+            rng_init(&rng, 43, t);
+            for (int i = 0; i < iters; i++) {
+                size_t key = rng_below(&rng, 60);
+                for (size_t j = 0; j < dims[0]; j++) x->data[j] = (float)(key * dims[0] + j) / 100.0f;
+                if (mlp_forward_cached(cache, mlp, x, y, scratch) < 0) errors++;
+                mlp_forward_batch(mlp, x, ref, scratch);
+                if (memcmp(y->data, ref->data, dims[2] * sizeof(float)) != 0) mismatches++;
+            }
+            mat_free(x);
+            mat_free(y);
+            mat_free(ref);
+            mlp_batch_scratch_free(scratch);
+        });
+    }
+    for (int t = 0; t < threads; t++) readers[t].join();
+    stop = 1;
+    bumper.join();
+
+    InferCacheStats stats = infer_cache_stats(cache);
+    check(errors.load() == 0 && mismatches.load() == 0, "every cached answer equals the plain forward");
+    check(stats.hits + stats.misses == (size_t)threads * iters && stats.entries <= 40, "counters add up");
+
+    // strided input (a column view): first a miss, then a hit, then stale after an update
+    infer_cache_clear(cache);
+    Matrix* wide = mat_create(dims[0], 2);
+    Matrix* col = mat_view(wide, 0, 1, dims[0], 1);
+    Matrix* y = mat_create(dims[2], 1);
+    for (size_t j = 0; j < dims[0]; j++) mat_set(wide, j, 1, (float)j / 10.0f);
+    int first = mlp_forward_cached(cache, mlp, col, y, NULL);
+    int second = mlp_forward_cached(cache, mlp, col, y, NULL);
+    mlp_mark_updated(mlp);
+    int third = mlp_forward_cached(cache, mlp, col, y, NULL);
+    check(first == 0 && second == 1 && third == 0 && infer_cache_stats(cache).stale == 1,
+          "strided input: miss, hit, then stale after an update");
+    check(infer_cache_stats(cache).capacity == 40, "40 slots over 5 shards");
+
+    // 17 over 16 shards: one shard gets 2 slots, the rest 1, never 32 in total
+    InferCache* odd = infer_cache_create(mlp, 17, 16);
+    Matrix* x = mat_create(dims[0], 1);
+    for (size_t key = 0; key < 200; key++) {
+        for (size_t j = 0; j < dims[0]; j++) x->data[j] = (float)(key * dims[0] + j) / 100.0f;
+        mlp_forward_cached(odd, mlp, x, y, NULL);
+    }
+    InferCacheStats odd_stats = infer_cache_stats(odd);
+    check(odd_stats.capacity == 17 && odd_stats.entries <= 17 && odd_stats.evictions > 0,
+          "remainder spread: capacity 17 holds at most 17 entries");
+
+    mat_free(x);
+    infer_cache_free(odd);
+    mat_free(col);
+    mat_free(wide);
+    mat_free(y);
+    infer_cache_free(cache);
+    mlp_free(mlp);
+}
+
+void test_inference_server() {
+    printf("\n=== Test: micro-batching server vs mlp_forward, malformed requests ===\n");
+
+    size_t dims[] = {7, 13, 5};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    MLP* mlp = create_mlp_seeded(dims, 3, activations, 0.1f, 59);
+
+    // references from the plain per-sample forward, computed before the server starts
+    const int threads = 4, per_thread = 40;
+    const int samples = threads * per_thread;
+    Matrix* inputs[samples];
+    Matrix* expected[samples];
+    for (int i = 0; i < samples; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        expected[i] = mat_create(dims[2], 1);
+        rng_fill_uniform(rng_stream(61, 0), (uint64_t)i * dims[0], inputs[i]->data, dims[0], -1.0f, 1.0f);
+        mlp_forward(mlp, inputs[i], expected[i]);
+    }
+
+    // a long delay so requests from different clients share batches, and a
+    // fifth client keeps sending wrong-shaped inputs into those batches
+    InferServer* server = infer_server_create(mlp, 8, 2000);
+    check(server != NULL, "server created");
+    std::atomic<int> failed(0), wrong(0), bad_accepted(0), stop(0);
+    std::thread saboteur([&] {
+        Matrix* bad_in = mat_create(dims[0] + 1, 1);
+        Matrix* bad_out = mat_create(dims[2], 1);
+        Matrix* bad_cols = mat_create(dims[2], 2);
+        mat_fill(bad_in, 0.5f);
+        while (!stop.load()) {
+            if (infer_server_forward(server, bad_in, bad_out) != -1) bad_accepted++;
+            if (infer_server_forward(server, inputs[0], bad_cols) != -1) bad_accepted++;
+        }
+        mat_free(bad_in);
+        mat_free(bad_out);
+        mat_free(bad_cols);
+    });
+    std::thread clients[threads];
+    for (int t = 0; t < threads; t++) {
+        clients[t] = std::thread([&, t] {
+            Matrix* outputs[per_thread];
+            std::future<int> pending[per_thread];
+            for (int i = 0; i < per_thread; i++) {
+                outputs[i] = mat_create(dims[2], 1);
+                pending[i] = infer_server_submit(server, inputs[t * per_thread + i], outputs[i]);
+            }
+            for (int i = 0; i < per_thread; i++) {
+                if (pending[i].get() != 0) failed++;
+                else if (rel_diff(expected[t * per_thread + i], outputs[i]) > 1e-5f) wrong++;
+                mat_free(outputs[i]);
+            }
+        });
+    }
+    for (int t = 0; t < threads; t++) clients[t].join();
+    stop = 1;
+    saboteur.join();
+
+    InferServerStats stats = infer_server_stats(server);
+    check(failed.load() == 0, "no valid request failed next to malformed ones");
+    check(wrong.load() == 0, "batched answers match mlp_forward");
+    check(bad_accepted.load() == 0, "malformed requests get -1");
+    check(stats.avg_batch > 1.0, "requests were batched");
+    printf("  %zu requests in %zu batches\n", stats.requests, stats.batches);
+
+    infer_server_destroy(server);
+    for (int i = 0; i < samples; i++) {
+        mat_free(inputs[i]);
+        mat_free(expected[i]);
+    }
+    mlp_free(mlp);
+}
+
+void test_model_pack() {
+    printf("\n=== Test: packed training vs separate mlp_train runs ===\n");
+
+    // 5 models pad to 8 lanes; different seeds and learning rates per model
+    const size_t K = 5, num_samples = 6;
+    size_t dims[] = {3, 7, 2};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    MLP* packed[K];
+    MLP* separate[K];
+    for (size_t k = 0; k < K; k++) {
+        packed[k] = create_mlp_seeded(dims, 3, activations, 0.05f + 0.02f * k, 67 + k);
+        separate[k] = mlp_clone(packed[k]);
+    }
+    Matrix* inputs[num_samples];
+    Matrix* targets[num_samples];
+    for (size_t i = 0; i < num_samples; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[2], 1);
+        rng_fill_uniform(rng_stream(71, 0), i * dims[0], inputs[i]->data, dims[0], -1.0f, 1.0f);
+        rng_fill_uniform(rng_stream(71, 1), i * dims[2], targets[i]->data, dims[2], 0.0f, 1.0f);
+    }
+
+    // two rounds of training with an unpack after each, as a caller checkpointing would
+    MLPPack* pack = mlp_pack_create(packed, K);
+    check(pack != NULL, "pack created");
+    mlp_pack_train(pack, inputs, targets, num_samples, 15, LOSS_MSE, 0.0f);
+    mlp_pack_unpack(pack, packed);
+    mlp_pack_train(pack, inputs, targets, num_samples, 15, LOSS_MSE, 0.0f);
+    mlp_pack_unpack(pack, packed);
+    for (size_t k = 0; k < K; k++) {
+        mlp_train(separate[k], inputs, targets, num_samples, 15, LOSS_MSE, 0.0f);
+        mlp_train(separate[k], inputs, targets, num_samples, 15, LOSS_MSE, 0.0f);
+    }
+
+    // sigmoid uses a float exp in the pack, so allow rounding drift
+    float worst = 0.0f;
+    int epochs_match = 1;
+    for (size_t k = 0; k < K; k++) {
+        for (size_t l = 0; l < packed[k]->num_layers; l++) {
+            float w = rel_diff(separate[k]->layers[l].weights, packed[k]->layers[l].weights);
+            float b = rel_diff(separate[k]->layers[l].bias, packed[k]->layers[l].bias);
+            if (w > worst) worst = w;
+            if (b > worst) worst = b;
+        }
+        epochs_match = epochs_match && packed[k]->epoch == 30 && separate[k]->epoch == 30;
+    }
+    printf("  worst parameter difference %.2e\n", worst);
+    check(worst < 1e-4f, "packed parameters match separate mlp_train");
+    check(epochs_match, "epoch counts are not double-counted across unpacks");
+
+    MLP* shuffled = mlp_clone(packed[0]);
+    shuffled->shuffle = 1;
+    check(mlp_pack_create(&shuffled, 1) == NULL, "shuffled models are refused");
+
+    mlp_pack_free(pack);
+    mlp_free(shuffled);
+    for (size_t k = 0; k < K; k++) {
+        mlp_free(packed[k]);
+        mlp_free(separate[k]);
+    }
+    for (size_t i = 0; i < num_samples; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+}
+
+// Every parameter of a snapshot published as version v equals v
+static int snapshot_consistent(const ModelSnapshot* snap) {
+    float v = (float)snap->version;
+    for (size_t l = 0; l < snap->mlp->num_layers; l++) {
+        const Layer* layer = &snap->mlp->layers[l];
+        for (size_t i = 0; i < layer->weights->rows; i++) {
+            for (size_t j = 0; j < layer->weights->cols; j++) {
+                if (mat_get(layer->weights, i, j) != v) return 0;
+            }
+            if (mat_get(layer->bias, i, 0) != v) return 0;
+        }
+    }
+    return 1;
+}
+
+void test_snapshot_readers() {
+    printf("\n=== Test: snapshot readers never see torn parameters ===\n");
+
+    size_t dims[] = {16, 32, 8};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    MLP* trainer = create_mlp_seeded(dims, 3, activations, 0.1f, 73);
+    for (size_t l = 0; l < trainer->num_layers; l++) {
+        mat_fill(trainer->layers[l].weights, 1.0f);
+        mat_fill(trainer->layers[l].bias, 1.0f);
+    }
+    SnapshotStore* store = snapshot_store_create(trainer);
+    check(store != NULL, "store created");
+
+    // 4 readers pin, check that every parameter belongs to one version, unpin;
+    // the writer keeps overwriting its MLP with the next version and publishing
+    const int readers = 4, publishes = 2000;
+    std::atomic<int> torn(0), backwards(0), done(0);
+    std::atomic<long> reads(0);
+    std::thread threads[readers];
+    for (int t = 0; t < readers; t++) {
+        threads[t] = std::thread([&] {
+            int slot = snapshot_reader_register(store);
+            uint64_t last = 0;
+            while (!done.load()) {
+                const ModelSnapshot* snap = snapshot_pin(store, slot);
+                if (!snapshot_consistent(snap)) torn++;
+                if (snap->version < last) backwards++;
+                last = snap->version;
+                snapshot_unpin(store, slot);
+                reads++;
+            }
+            snapshot_reader_unregister(store, slot);
+        });
+    }
+    int publish_failed = 0;
+    for (int p = 0; p < publishes; p++) {
+        float next = (float)(snapshot_stats(store).version + 1);
+        for (size_t l = 0; l < trainer->num_layers; l++) {
+            mat_fill(trainer->layers[l].weights, next);
+            mat_fill(trainer->layers[l].bias, next);
+        }
+        if (snapshot_publish(store, trainer) == 0) publish_failed++;
+    }
+    done = 1;
+    for (int t = 0; t < readers; t++) threads[t].join();
+
+    SnapshotStats stats = snapshot_stats(store);
+    printf("  %ld pinned reads over %zu publishes, %zu recycled\n", reads.load(), stats.published, stats.recycled);
+    check(publish_failed == 0 && stats.version == (uint64_t)publishes + 1, "every publish landed");
+    check(torn.load() == 0, "no reader saw a mix of versions");
+    check(backwards.load() == 0, "versions seen by a reader never go back");
+    check(snapshot_reclaim(store) == 0, "nothing stays pinned after the readers leave");
+
+    snapshot_store_free(store);
+    mlp_free(trainer);
+}
+
+static int mlp_params_equal(const MLP* a, const MLP* b) {
+    for (size_t l = 0; l < a->num_layers; l++) {
+        if (rel_diff(a->layers[l].weights, b->layers[l].weights) != 0.0f) return 0;
+        if (rel_diff(a->layers[l].bias, b->layers[l].bias) != 0.0f) return 0;
+    }
+    return 1;
+}
+
+// Writes `bytes` of buf to path, 0 on success
+static int write_bytes(const char* path, const char* buf, size_t bytes) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return -1;
+    size_t put = fwrite(buf, 1, bytes, file);
+    fclose(file);
+    return put == bytes ? 0 : -1;
+}
+
+void test_checkpoint_resume() {
+    printf("\n=== Test: resume from checkpoint vs uninterrupted run, corrupt files ===\n");
+
+    const char* path = "/tmp/nn_test_checkpoint.bin";
+    const char* broken = "/tmp/nn_test_checkpoint_broken.bin";
+    const size_t num_samples = 8, total_epochs = 10;
+    size_t dims[] = {4, 9, 3};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    Matrix* inputs[num_samples];
+    Matrix* targets[num_samples];
+    for (size_t i = 0; i < num_samples; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[2], 1);
+        rng_fill_uniform(rng_stream(79, 0), i * dims[0], inputs[i]->data, dims[0], -1.0f, 1.0f);
+        rng_fill_uniform(rng_stream(79, 1), i * dims[2], targets[i]->data, dims[2], 0.0f, 1.0f);
+    }
+
+    // shuffled, so the resumed run only matches if seed, epoch and shuffle all come back
+    MLP* uninterrupted = create_mlp_seeded(dims, 3, activations, 0.1f, 83);
+    uninterrupted->shuffle = 1;
+    MLP* interrupted = mlp_clone(uninterrupted);
+    mlp_train(uninterrupted, inputs, targets, num_samples, total_epochs, LOSS_MSE, 0.0f);
+
+    // checkpoint every 2 epochs, "crash" after 5; a write still in flight may
+    // skip a request, the resume just starts from whichever epoch was saved
+    remove(path);
+    Checkpointer* ckpt = checkpoint_create(path);
+    checkpoint_attach(ckpt, interrupted, 2);
+    mlp_train(interrupted, inputs, targets, num_samples, 5, LOSS_MSE, 0.0f);
+    checkpoint_free(ckpt);
+
+    MLP* resumed = create_mlp_seeded(dims, 3, activations, 0.5f, 89);
+    check(checkpoint_load(path, resumed) == 0, "checkpoint loads");
+    check(resumed->shuffle == 1 && resumed->seed == interrupted->seed && resumed->epoch > 0 && resumed->epoch <= 5,
+          "shuffle, seed and epoch restored");
+    mlp_train(resumed, inputs, targets, num_samples, total_epochs - resumed->epoch, LOSS_MSE, 0.0f);
+    check(resumed->epoch == total_epochs && mlp_params_equal(uninterrupted, resumed),
+          "resumed run is bit-identical to the uninterrupted one");
+
+    // truncated, extended and bit-flipped copies are all refused and leave the model alone
+    FILE* file = fopen(path, "rb");
+    size_t bytes = checkpoint_bytes_for(resumed);
+    char* buf = (char*)malloc(bytes + 1);
+    size_t got = file ? fread(buf, 1, bytes, file) : 0;
+    if (file) fclose(file);
+    check(got == bytes, "checkpoint has the expected size");
+
+    MLP* target = mlp_clone(uninterrupted);
+    int refused = 1;
+    refused &= write_bytes(broken, buf, bytes - 1) == 0 && checkpoint_load(broken, target) == -1;
+    buf[bytes] = 0;
+    refused &= write_bytes(broken, buf, bytes + 1) == 0 && checkpoint_load(broken, target) == -1;
+    size_t flips[] = {offsetof(CheckpointHeader, epoch), offsetof(CheckpointHeader, flags),
+                      sizeof(CheckpointHeader) + 1, bytes / 2, bytes - 1};
+    for (size_t f = 0; f < 5; f++) {
+        buf[flips[f]] ^= 0x10;
+        refused &= write_bytes(broken, buf, bytes) == 0 && checkpoint_load(broken, target) == -1;
+        buf[flips[f]] ^= 0x10;
+    }
+    check(refused, "truncated and corrupt checkpoints are rejected");
+    check(mlp_params_equal(target, uninterrupted) && target->epoch == total_epochs, "rejected loads leave the model untouched");
+    check(write_bytes(broken, buf, bytes) == 0 && checkpoint_load(broken, target) == 0, "the intact bytes still load");
+
+    free(buf);
+    remove(path);
+    remove(broken);
+    mlp_free(target);
+    mlp_free(resumed);
+    mlp_free(interrupted);
+    mlp_free(uninterrupted);
+    for (size_t i = 0; i < num_samples; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+}
+
+void test_parallel_init() {
+    printf("\n=== Test: weight init on 1 thread vs several ===\n");
+
+    // 601 x 513 weights: enough elements for 4 threads, split points fall mid-row
+    size_t dims[] = {513, 601, 3};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    size_t saved = mlp_init_threads;
+    mlp_init_threads = 1;
+    MLP* serial = create_mlp_seeded(dims, 3, activations, 0.1f, 97);
+    mlp_init_threads = 4;
+    MLP* parallel = create_mlp_seeded(dims, 3, activations, 0.1f, 97);
+    mlp_init_threads = saved;
+
+    check(mlp_params_equal(serial, parallel), "1 and 4 init threads give bit-identical weights");
+
+    mlp_free(serial);
+    mlp_free(parallel);
+}
+
+void test_prepacked_inference() {
+    printf("\n=== Test: prepacked GEMV inference vs mlp_forward ===\n");
+
+    // 37, 20 and 3 are not multiples of the 16-row panels, 19 inputs not of the SIMD width
+    size_t dims[] = {19, 37, 20, 3};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_TANH, ACTIVATION_SIGMOID};
+    MLP* mlp = create_mlp_seeded(dims, 4, activations, 0.1f, 101);
+    InferMLP* net = mlp_prepack(mlp);
+    check(net != NULL, "prepacked");
+
+    // inputs are column 2 of a wide matrix (stride != 1), outputs column 1 of another
+    const size_t samples = 16;
+    Matrix* wide_in = mat_create(dims[0], 3);
+    Matrix* wide_out = mat_create(dims[3], 2);
+    Matrix* dense_in = mat_create(dims[0], 1);
+    Matrix* expected = mat_create(dims[3], 1);
+    Matrix* got = mat_create(dims[3], 1);
+    Matrix* x = mat_view(wide_in, 0, 2, dims[0], 1);
+    Matrix* y = mat_view(wide_out, 0, 1, dims[3], 1);
+    float* scratch = (float*)malloc(sizeof(float) * infer_scratch_floats(net));
+    float worst_mat = 0.0f, worst_raw = 0.0f;
+    int errors = 0;
+    for (size_t i = 0; i < samples; i++) {
+        rng_fill_uniform(rng_stream(103, 0), i * dims[0], dense_in->data, dims[0], -2.0f, 2.0f);
+        for (size_t j = 0; j < dims[0]; j++) mat_set(wide_in, j, 2, dense_in->data[j]);
+        mlp_forward(mlp, dense_in, expected);
+
+        if (infer_forward_mat(net, x, y) != 0) errors++;
+        for (size_t j = 0; j < dims[3]; j++) got->data[j] = mat_get(wide_out, j, 1);
+        float d = rel_diff(expected, got);
+        if (d > worst_mat) worst_mat = d;
+
+        if (infer_forward(net, dense_in->data, got->data, scratch) != 0) errors++;
+        d = rel_diff(expected, got);
+        if (d > worst_raw) worst_raw = d;
+    }
+    printf("  worst difference: infer_forward_mat %.2e, infer_forward %.2e\n", worst_mat, worst_raw);
+    check(errors == 0, "every forward succeeded");
+    check(worst_mat < 1e-5f, "infer_forward_mat on strided views matches mlp_forward");
+    check(worst_raw < 1e-5f, "infer_forward matches mlp_forward");
+
+    // the neighbouring columns of the output view are left alone
+    int outside = 1;
+    for (size_t j = 0; j < dims[3]; j++) outside = outside && mat_get(wide_out, j, 0) == 0.0f;
+    check(outside, "nothing written outside the output view");
+    check(infer_forward_mat(net, expected, got) == -1, "wrong input shape refused");
+
+    free(scratch);
+    mat_free(x);
+    mat_free(y);
+    mat_free(wide_in);
+    mat_free(wide_out);
+    mat_free(dense_in);
+    mat_free(expected);
+    mat_free(got);
+    infer_free(net);
+    mlp_free(mlp);
+}
+
+void test_gemm_kernels() {
+    printf("\n=== Test: blocked GEMM kernels vs a triple-loop reference ===\n");
+
+    // shapes around the 4x8 register block: below it, remainders in M and N, exact multiples
+    const size_t shapes[][3] = {{1, 1, 1}, {3, 5, 7}, {4, 8, 16}, {13, 21, 35}, {37, 45, 29}, {64, 33, 17}};
+    MatGemmConfig configs[8];
+    for (int c = 0; c < 8; c++) configs[c] = mat_gemm_default_config;
+    configs[1].kernel = MAT_GEMM_KERNEL_ROWS;
+    configs[2].order = MAT_GEMM_ORDER_NKM;
+    configs[3].kernel = MAT_GEMM_KERNEL_ROWS;
+    configs[3].order = MAT_GEMM_ORDER_NKM;
+    configs[4].kc = 8;                      // K, N and M blocks
+    configs[4].nc = 8;
+    configs[4].mc = 4;
+    configs[5].kc = 5;                      // blocks that do not divide anything, nc/mc get rounded up
+    configs[5].nc = 11;
+    configs[5].mc = 6;
+    configs[5].order = MAT_GEMM_ORDER_NKM;
+    configs[6].kc = 7;
+    configs[6].threads = 3;
+    configs[7] = configs[5];
+    configs[7].kernel = MAT_GEMM_KERNEL_ROWS;
+    configs[7].threads = 2;
+
+    const MatLayout layouts[] = {MAT_LAYOUT_DENSE, MAT_LAYOUT_PADDED};
+    float worst = 0.0f;
+    int ok = 1, clean = 1;
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t M = shapes[s][0], K = shapes[s][1], N = shapes[s][2];
+        for (int l = 0; l < 2; l++) {
+            Matrix* a = mat_create_ex(M, K, layouts[l]);
+            Matrix* b = mat_create_ex(K, N, layouts[l]);
+            Matrix* c = mat_create_ex(M, N, layouts[l]);
+            Matrix* ref = mat_create(M, N);
+            fill_uniform(a, 113, s);
+            fill_uniform(b, 113, 100 + s);
+            naive_product(a, 0, b, 0, ref);
+            for (int k = 0; k < 8; k++) {
+                mat_fill(c, 7.0f);          // stale values must be overwritten, not accumulated
+                ok &= mat_mul_config(a, b, c, &configs[k]) == 0;
+                float d = rel_diff(ref, c);
+                if (d > worst) worst = d;
+                if (l == 1) clean &= padding_clean(c);
+            }
+            mat_fill(c, 7.0f);
+            ok &= mat_mul(a, b, c) == 0;
+            float d = rel_diff(ref, c);
+            if (d > worst) worst = d;
+            mat_free(a);
+            mat_free(b);
+            mat_free(c);
+            mat_free(ref);
+        }
+    }
+    printf("  worst difference %.2e\n", worst);
+    check(ok && worst < 1e-5f, "VEC4X8 and ROWS kernels, both orders, blocked and threaded, match the reference");
+    check(clean, "padded results keep zero padding");
+
+    Matrix* a = mat_create(3, 4);
+    Matrix* b = mat_create(5, 2);
+    Matrix* c = mat_create(3, 2);
+    check(mat_mul_config(a, b, c, &configs[0]) == -1, "inner dimension mismatch refused");
+    mat_free(a);
+    mat_free(b);
+    mat_free(c);
+}
+
+void test_gemm_threads() {
+    printf("\n=== Test: threaded GEMM on the worker pool vs one thread ===\n");
+
+    // M not a multiple of the 4-row groups, so the last range is short
+    Matrix* a = mat_create(37, 45);
+    Matrix* b = mat_create(45, 29);
+    Matrix* ref = mat_create(37, 29);
+    for (size_t i = 0; i < a->rows; i++) {
+        rng_fill_uniform(rng_stream(47, 0), i * a->cols, a->data + i * a->stride, a->cols, -1.0f, 1.0f);
+    }
+    for (size_t i = 0; i < b->rows; i++) {
+        rng_fill_uniform(rng_stream(47, 1), i * b->cols, b->data + i * b->stride, b->cols, -1.0f, 1.0f);
+    }
+    mat_mul_config(a, b, ref, &mat_gemm_default_config);
+
+    // repeated products with a growing and shrinking thread count reuse the same workers
+    MatGemmConfig config = mat_gemm_default_config;
+    config.kc = 16;
+    int same = 1;
+    for (size_t round = 0; round < 20; round++) {
+        config.threads = 2 + round % 4;
+        Matrix* c = mat_create(37, 29);
+        mat_mul_config(a, b, c, &config);
+        same = same && rel_diff(ref, c) == 0.0f;
+        mat_free(c);
+    }
+    check(same, "2 to 5 threads give the single-thread result");
+
+    // concurrent callers: one gets the pool, the others run alone
+    std::atomic<int> wrong(0);
+    std::thread callers[3];
+    for (int t = 0; t < 3; t++) {
+        callers[t] = std::thread([&] {
+            MatGemmConfig threaded = mat_gemm_default_config;
+            threaded.threads = 3;
+            Matrix* c = mat_create(37, 29);
+            for (int i = 0; i < 50; i++) {
+                mat_mul_config(a, b, c, &threaded);
+                if (rel_diff(ref, c) != 0.0f) wrong++;
+            }
+            mat_free(c);
+        });
+    }
+    for (int t = 0; t < 3; t++) callers[t].join();
+    check(wrong.load() == 0, "concurrent threaded products");
+
+    mat_free(a);
+    mat_free(b);
+    mat_free(ref);
+}
+
+void test_autotune_install() {
+    printf("\n=== Test: autotuner reports shapes the config table refused ===\n");
+
+    size_t dims[] = {8, 12, 4};
+    ActivationType activations[] = {ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    MLP* mlp = create_mlp_seeded(dims, 3, activations, 0.1f, 53);
+
+    // a full table: every set_config for a new shape fails
+    mat_gemm_clear_configs();
+    MatGemmConfig filler = mat_gemm_default_config;
+    for (size_t i = 0; i < MAT_GEMM_MAX_CONFIGS; i++) mat_gemm_set_config(1000 + i, 1, 1, &filler);
+    AutotuneReport* report = mlp_autotune(mlp, 8, NULL);
+    int refused = report != NULL;
+    for (size_t i = 0; report && i < report->num_shapes; i++) refused = refused && !report->shapes[i].installed;
+    check(refused && report->num_shapes == 2, "full table: every shape reported as not installed");
+    autotune_report_free(report);
+
+    mat_gemm_clear_configs();
+    report = mlp_autotune(mlp, 8, NULL);
+    int installed = report != NULL;
+    for (size_t i = 0; report && i < report->num_shapes; i++) {
+        const AutotuneShape* shape = &report->shapes[i];
+        const MatGemmConfig* config = mat_gemm_get_config(shape->M, shape->N, shape->K);
+        installed = installed && shape->installed && memcmp(config, &shape->config, sizeof(*config)) == 0;
+    }
+    check(installed, "empty table: every shape installed with the reported config");
+    autotune_report_free(report);
+
+    mat_gemm_clear_configs();
+    mlp_free(mlp);
+}
+
+void test_data_parallel_training() {
+    printf("\n=== Test: data-parallel training vs sequential mini-batch SGD ===\n");
+#ifdef __SANITIZE_THREAD__
+    // ThreadSanitizer cannot follow threads started in a forked child (make tsan)
+    printf("  skipped under ThreadSanitizer\n");
+    return;
+#endif
+
+    size_t dims[] = {6, 16, 12, 3};
+    ActivationType activations[] = {ACTIVATION_TANH, ACTIVATION_RELU, ACTIVATION_SIGMOID};
+    MLP* base = create_mlp_seeded(dims, 4, activations, 0.1f, 59);
+
+    // 22 samples over 3 ranks: shards of 7, 7 and 8, so the last step is uneven
+    const size_t n = 22, batch = 3, epochs = 2;
+    const int world = 3;
+    Matrix* inputs[n];
+    Matrix* targets[n];
+    for (size_t i = 0; i < n; i++) {
+        inputs[i] = mat_create(dims[0], 1);
+        targets[i] = mat_create(dims[3], 1);
+        rng_fill_uniform(rng_stream(61, 0), i * dims[0], inputs[i]->data, dims[0], -1.0f, 1.0f);
+        rng_fill_uniform(rng_stream(61, 1), i * dims[3], targets[i]->data, dims[3], 0.0f, 1.0f);
+    }
+
+    // every step sums each rank's next `batch` samples of its shard, then applies the mean
+    MLP* reference = mlp_clone(base);
+    mlp_zero_grads(reference);
+    size_t steps = ((n + world - 1) / world + batch - 1) / batch;
+    for (size_t e = 0; e < epochs; e++) {
+        for (size_t step = 0; step < steps; step++) {
+            size_t global = 0;
+            for (int r = 0; r < world; r++) {
+                size_t first = dp_shard_begin(n, r, world), shard = dp_shard_begin(n, r + 1, world) - first;
+                if (step * batch >= shard) continue;
+                size_t count = shard - step * batch < batch ? shard - step * batch : batch;
+                reference_accumulate_grads(reference, inputs, targets, first + step * batch, count);
+                global += count;
+            }
+            for (size_t l = 0; l < reference->num_layers; l++) {
+                layer_apply_grads(&reference->layers[l], reference->learning_rate / global);
+            }
+        }
+    }
+
+    // threaded configs for the workers' batched products, and a product first so
+    // the parent's GEMM pool has live workers when it forks
+    MatGemmConfig threaded = mat_gemm_default_config;
+    threaded.threads = 2;
+    for (size_t l = 0; l < 3; l++) {
+        for (size_t cols = 2; cols <= batch; cols++) mat_gemm_set_config(dims[l + 1], cols, dims[l], &threaded);
+    }
+    Matrix* x = mat_create(dims[0], batch);
+    Matrix* y = mat_create(dims[1], batch);
+    mat_mul(base->layers[0].weights, x, y);
+    mat_free(x);
+    mat_free(y);
+
+    MLP* net = mlp_clone(base);
+    float loss = mlp_train_data_parallel(net, inputs, targets, n, epochs, LOSS_MSE, 0.0f, world, batch);
+    mat_gemm_clear_configs();
+
+    float worst = 0.0f;
+    for (size_t l = 0; l < net->num_layers; l++) {
+        float w = rel_diff(reference->layers[l].weights, net->layers[l].weights);
+        float b = rel_diff(reference->layers[l].bias, net->layers[l].bias);
+        if (w > worst) worst = w;
+        if (b > worst) worst = b;
+    }
+    char what[128];
+    snprintf(what, sizeof(what), "%d workers with threaded GEMM match sequential training (worst %.2e)", world, worst);
+    check(loss >= 0.0f && worst <= 1e-5f, what);
+
+    for (size_t i = 0; i < n; i++) {
+        mat_free(inputs[i]);
+        mat_free(targets[i]);
+    }
+    mlp_free(net);
+    mlp_free(reference);
+    mlp_free(base);
+}
+
+int main(int argc, char** argv) {
     printf("=== Neural Network Backpropagation Test ===\n");
     
-    srand(time(NULL));
+    // fixed so a failure reproduces, pass a seed to try others
+    uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 42;
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    rng_set_global_seed(seed);
 
     test_training();
+    test_parallel_init();
+    test_allocator_accounting();
+    test_matrix_expressions();
+    test_view_ops();
+    test_padded_kernels();
+    test_activation_storage();
+    test_pipeline_training();
+    test_data_parallel_training();
+    test_tied_autoencoder();
+    test_lowrank_gradients();
+    test_prepacked_inference();
+    test_inference_cache();
+    test_snapshot_readers();
+    test_inference_server();
+    test_model_pack();
+    test_checkpoint_resume();
+    test_gemm_kernels();
+    test_gemm_threads();
+    test_autotune_install();
     
     printf("\n=== All Tests Complete ===\n");
     
-    return 0;
+    return failures ? 1 : 0;
 }
 